@@ -0,0 +1,327 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include <syslog.h>
+
+#include <iostream>
+#include <exception>
+
+#include "Poco/Thread.h"
+#include "Poco/Runnable.h"
+
+#include "HNEventReactor.h"
+
+// Helper class for running one reactor
+// thread as an independent thread
+class HNERRunner : public Poco::Runnable
+{
+    private:
+        Poco::Thread    m_thread;
+        HNEventReactor *m_reactor;
+
+    public:
+        HNERRunner( HNEventReactor *value )
+        {
+            m_reactor = value;
+        }
+
+        void startThread()
+        {
+            m_thread.start( *this );
+        }
+
+        void joinThread()
+        {
+            m_thread.join();
+        }
+
+        virtual void run()
+        {
+            m_reactor->run();
+        }
+};
+
+HNERStrand::HNERStrand( HNEventHandler *handler )
+{
+    m_handler = handler;
+    m_busy    = false;
+}
+
+HNERStrand::~HNERStrand()
+{
+
+}
+
+HNEventReactor::HNEventReactor()
+{
+    m_epollFD = -1;
+    m_stopFD  = -1;
+}
+
+HNEventReactor::~HNEventReactor()
+{
+    for( std::map< HNEventHandler*, HNERStrand* >::iterator it = m_strandMap.begin(); it != m_strandMap.end(); it++ )
+        delete it->second;
+
+    if( m_stopFD != -1 )
+        close( m_stopFD );
+
+    if( m_epollFD != -1 )
+        close( m_epollFD );
+}
+
+HNER_RESULT_T
+HNEventReactor::init()
+{
+    struct epoll_event event;
+
+    m_epollFD = epoll_create1( 0 );
+    if( m_epollFD == -1 )
+    {
+        syslog( LOG_ERR, "HNEventReactor - Failed to create epoll: %s", strerror(errno) );
+        return HNER_RESULT_FAILURE;
+    }
+
+    m_stopFD = eventfd( 0, EFD_NONBLOCK );
+    if( m_stopFD == -1 )
+    {
+        syslog( LOG_ERR, "HNEventReactor - Failed to create stop event: %s", strerror(errno) );
+        return HNER_RESULT_FAILURE;
+    }
+
+    // Level triggered, so every thread sees it
+    event.data.fd = m_stopFD;
+    event.events  = EPOLLIN;
+    if( epoll_ctl( m_epollFD, EPOLL_CTL_ADD, m_stopFD, &event ) == -1 )
+        return HNER_RESULT_FAILURE;
+
+    return HNER_RESULT_SUCCESS;
+}
+
+HNER_RESULT_T
+HNEventReactor::addFD( int fd, HNEventHandler *handler )
+{
+    struct epoll_event event;
+    int flags;
+
+    flags = fcntl( fd, F_GETFL, 0 );
+    if( flags == -1 )
+    {
+        syslog( LOG_ERR, "HNEventReactor - Failed to get socket flags: %s", strerror(errno) );
+        return HNER_RESULT_FAILURE;
+    }
+
+    if( fcntl( fd, F_SETFL, flags | O_NONBLOCK ) == -1 )
+    {
+        syslog( LOG_ERR, "HNEventReactor - Failed to set socket flags: %s", strerror(errno) );
+        return HNER_RESULT_FAILURE;
+    }
+
+    // Map the descriptor before it can report an event
+    {
+        std::lock_guard<std::mutex> guard( m_fdMutex );
+
+        std::map< HNEventHandler*, HNERStrand* >::iterator sit = m_strandMap.find( handler );
+
+        if( sit == m_strandMap.end() )
+            sit = m_strandMap.insert( std::pair< HNEventHandler*, HNERStrand* >( handler, new HNERStrand( handler ) ) ).first;
+
+        m_fdMap[ fd ] = sit->second;
+    }
+
+    event.data.fd = fd;
+    event.events  = EPOLLIN | EPOLLET;
+    if( epoll_ctl( m_epollFD, EPOLL_CTL_ADD, fd, &event ) == -1 )
+    {
+        std::lock_guard<std::mutex> guard( m_fdMutex );
+        m_fdMap.erase( fd );
+        return HNER_RESULT_FAILURE;
+    }
+
+    return HNER_RESULT_SUCCESS;
+}
+
+HNER_RESULT_T
+HNEventReactor::removeFD( int fd )
+{
+    HNER_RESULT_T result = HNER_RESULT_SUCCESS;
+
+    if( epoll_ctl( m_epollFD, EPOLL_CTL_DEL, fd, NULL ) == -1 )
+        result = HNER_RESULT_FAILURE;
+
+    // Events already taken for this descriptor are dropped
+    // when they find it unmapped.
+    std::lock_guard<std::mutex> guard( m_fdMutex );
+    m_fdMap.erase( fd );
+
+    return result;
+}
+
+void
+HNEventReactor::start( uint threadCnt )
+{
+    for( uint i = 0; i < threadCnt; i++ )
+    {
+        HNERRunner *runner = new HNERRunner( this );
+
+        m_threadList.push_back( runner );
+
+        runner->startThread();
+    }
+}
+
+void
+HNEventReactor::run()
+{
+    struct epoll_event events[ HNER_MAXEVENTS ];
+
+    while( true )
+    {
+        int n = epoll_wait( m_epollFD, events, HNER_MAXEVENTS, -1 );
+
+        if( n < 0 )
+        {
+            // If we've been interrupted by an incoming signal, continue
+            if( errno == EINTR )
+                continue;
+
+            syslog( LOG_ERR, "HNEventReactor - epoll failure: %s", strerror(errno) );
+            return;
+        }
+
+        for( int i = 0; i < n; i++ )
+        {
+            if( events[i].data.fd == m_stopFD )
+                return;
+
+            dispatch( events[i].data.fd, events[i].events );
+        }
+    }
+}
+
+void
+HNEventReactor::stop()
+{
+    uint64_t value = 1;
+
+    if( write( m_stopFD, &value, sizeof(value) ) != sizeof(value) )
+        syslog( LOG_ERR, "HNEventReactor - Failed to signal stop: %s", strerror(errno) );
+
+    for( std::vector< void* >::iterator it = m_threadList.begin(); it != m_threadList.end(); it++ )
+    {
+        ( (HNERRunner*) *it )->joinThread();
+        delete ( (HNERRunner*) *it );
+    }
+
+    m_threadList.clear();
+}
+
+void
+HNEventReactor::dispatch( int fd, uint32_t events )
+{
+    HNERStrand *strand = NULL;
+
+    {
+        std::lock_guard<std::mutex> guard( m_fdMutex );
+
+        std::map< int, HNERStrand* >::iterator it = m_fdMap.find( fd );
+
+        if( it == m_fdMap.end() )
+            return;
+
+        strand = it->second;
+    }
+
+    // Hand the event to the thread already in this handler
+    {
+        std::lock_guard<std::mutex> guard( strand->m_mutex );
+
+        if( strand->m_busy == true )
+        {
+            strand->m_pending.push_back( std::pair< int, uint32_t >( fd, events ) );
+            return;
+        }
+
+        strand->m_busy = true;
+    }
+
+    // Run this event, then any that were handed off meanwhile
+    while( true )
+    {
+        // An escaping exception would end this thread with the
+        // strand still marked busy, so stop it here.
+        try
+        {
+            strand->m_handler->handleReactorEvent( fd, events );
+        }
+        catch( std::exception &ex )
+        {
+            syslog( LOG_ERR, "HNEventReactor - Handler failed for fd %d: %s", fd, ex.what() );
+        }
+        catch( ... )
+        {
+            syslog( LOG_ERR, "HNEventReactor - Handler failed for fd %d", fd );
+        }
+
+        std::lock_guard<std::mutex> guard( strand->m_mutex );
+
+        if( strand->m_pending.empty() == true )
+        {
+            strand->m_busy = false;
+            return;
+        }
+
+        fd     = strand->m_pending.front().first;
+        events = strand->m_pending.front().second;
+        strand->m_pending.pop_front();
+    }
+}
+
+int
+HNEventReactor::createTimer()
+{
+    return timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK );
+}
+
+void
+HNEventReactor::armTimer( int timerFD, uint64_t delayMS )
+{
+    struct itimerspec spec;
+
+    memset( &spec, 0, sizeof(spec) );
+
+    // A zero value would disarm, so fire as soon as possible instead
+    if( delayMS == 0 )
+        spec.it_value.tv_nsec = 1;
+    else
+    {
+        spec.it_value.tv_sec  = delayMS / 1000;
+        spec.it_value.tv_nsec = (delayMS % 1000) * 1000000;
+    }
+
+    timerfd_settime( timerFD, 0, &spec, NULL );
+}
+
+void
+HNEventReactor::disarmTimer( int timerFD )
+{
+    struct itimerspec spec;
+
+    memset( &spec, 0, sizeof(spec) );
+
+    timerfd_settime( timerFD, 0, &spec, NULL );
+}
+
+void
+HNEventReactor::clearTimer( int timerFD )
+{
+    uint64_t expirations;
+
+    // Nothing to read if the timer was rearmed before this ran
+    if( read( timerFD, &expirations, sizeof(expirations) ) < 0 )
+        return;
+}
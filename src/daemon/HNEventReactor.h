@@ -0,0 +1,104 @@
+#ifndef __HN_EVENT_REACTOR_H__
+#define __HN_EVENT_REACTOR_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/epoll.h>
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+
+// Most events taken from epoll by one thread per wait
+#define HNER_MAXEVENTS  16
+
+typedef enum HNEventReactorResultEnum
+{
+    HNER_RESULT_SUCCESS,
+    HNER_RESULT_FAILURE
+}HNER_RESULT_T;
+
+// Implemented by the components hosted on the reactor.  Events
+// for one handler are never delivered on two threads at once, so
+// a handler's event loop state needs no locking of its own.
+class HNEventHandler
+{
+    public:
+        virtual ~HNEventHandler() {}
+
+        virtual void handleReactorEvent( int fd, uint32_t events ) = 0;
+};
+
+// Serializes delivery to one handler.  A thread that finds the
+// handler busy queues the event for the thread already running it
+// and goes back to epoll, rather than waiting.
+class HNERStrand
+{
+    public:
+        HNERStrand( HNEventHandler *handler );
+       ~HNERStrand();
+
+    private:
+        HNEventHandler *m_handler;
+
+        std::mutex m_mutex;
+        bool       m_busy;
+
+        std::deque< std::pair< int, uint32_t > > m_pending;
+
+    friend class HNEventReactor;
+};
+
+// A single epoll set shared by any number of threads.  Whichever
+// thread is idle takes the next ready descriptor, so one component
+// blocking on a device request doesn't hold up the others as long
+// as there is more than one thread.
+class HNEventReactor
+{
+    public:
+        HNEventReactor();
+       ~HNEventReactor();
+
+        HNER_RESULT_T init();
+
+        // Watch fd for input on behalf of handler, edge triggered
+        HNER_RESULT_T addFD( int fd, HNEventHandler *handler );
+        HNER_RESULT_T removeFD( int fd );
+
+        // Start threadCnt threads running the reactor
+        void start( uint threadCnt );
+
+        // Run the calling thread as one more reactor thread,
+        // returns once stop is called.
+        void run();
+
+        // End all reactor threads and wait for the started ones
+        void stop();
+
+        // Helpers for one shot timers delivered as fd events
+        static int  createTimer();
+        static void armTimer( int timerFD, uint64_t delayMS );
+        static void disarmTimer( int timerFD );
+        static void clearTimer( int timerFD );
+
+    private:
+        int m_epollFD;
+
+        // Never read, so it stays readable and wakes every thread
+        int m_stopFD;
+
+        // Descriptor to the strand of its handler
+        std::mutex m_fdMutex;
+        std::map< int, HNERStrand* > m_fdMap;
+
+        // One strand per handler, kept for the life of the reactor
+        std::map< HNEventHandler*, HNERStrand* > m_strandMap;
+
+        // The thread helpers
+        std::vector< void* > m_threadList;
+
+        void dispatch( int fd, uint32_t events );
+};
+
+#endif // __HN_EVENT_REACTOR_H__
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <strings.h>
+
+#include <iostream>
+
+#include "HNMDHealthHistory.h"
+#include "HNMDJson.h"
+#include "HNManagedDeviceArbiter.h"
+
+// Bucket width in seconds for each downsampled tier
+static const time_t g_tierPeriod[ HNMDHH_TIER_COUNT ] = { 0, (60*60), (24*60*60) };
+
+static const uint g_tierSlots[ HNMDHH_TIER_COUNT ] = { HNMDHH_RAW_SLOTS, HNMDHH_HOUR_SLOTS, HNMDHH_DAY_SLOTS };
+
+HNMDHHSample::HNMDHHSample()
+{
+    m_start = 0;
+    m_end   = 0;
+    m_last  = HNMDHH_STATUS_UNKNOWN;
+    m_worst = HNMDHH_STATUS_UNKNOWN;
+    m_transitions = 0;
+}
+
+HNMDHHSample::~HNMDHHSample()
+{
+
+}
+
+void
+HNMDHHSample::init( time_t timestamp, HNMDHH_STATUS_T status )
+{
+    m_start = timestamp;
+    m_end   = timestamp;
+    m_last  = status;
+    m_worst = status;
+    m_transitions = 1;
+}
+
+void
+HNMDHHSample::merge( const HNMDHHSample &older )
+{
+    // The newer sample keeps its last status, the span
+    // and counts grow to cover the older one.
+    if( older.m_start < m_start )
+        m_start = older.m_start;
+
+    if( older.m_end > m_end )
+        m_end = older.m_end;
+
+    if( older.m_worst > m_worst )
+        m_worst = older.m_worst;
+
+    m_transitions += older.m_transitions;
+}
+
+time_t
+HNMDHHSample::getStartTime() const
+{
+    return m_start;
+}
+
+time_t
+HNMDHHSample::getEndTime() const
+{
+    return m_end;
+}
+
+HNMDHH_STATUS_T
+HNMDHHSample::getLastStatus() const
+{
+    return (HNMDHH_STATUS_T) m_last;
+}
+
+HNMDHH_STATUS_T
+HNMDHHSample::getWorstStatus() const
+{
+    return (HNMDHH_STATUS_T) m_worst;
+}
+
+uint32_t
+HNMDHHSample::getTransitionCount() const
+{
+    return m_transitions;
+}
+
+HNMDHHRing::HNMDHHRing()
+{
+    m_capacity = 0;
+    m_head = 0;
+}
+
+HNMDHHRing::~HNMDHHRing()
+{
+
+}
+
+void
+HNMDHHRing::setCapacity( uint capacity )
+{
+    m_capacity = capacity;
+}
+
+bool
+HNMDHHRing::push( const HNMDHHSample &sample, HNMDHHSample &evicted )
+{
+    // Still filling
+    if( m_slots.size() < m_capacity )
+    {
+        m_slots.push_back( sample );
+        return false;
+    }
+
+    // Full, overwrite the oldest
+    evicted = m_slots[ m_head ];
+    m_slots[ m_head ] = sample;
+
+    m_head = (m_head + 1) % m_capacity;
+
+    return true;
+}
+
+uint
+HNMDHHRing::size() const
+{
+    return m_slots.size();
+}
+
+const HNMDHHSample&
+HNMDHHRing::at( uint index ) const
+{
+    return m_slots[ (m_head + index) % m_slots.size() ];
+}
+
+HNMDHHSample*
+HNMDHHRing::newest()
+{
+    if( m_slots.empty() == true )
+        return NULL;
+
+    return &m_slots[ (m_head + m_slots.size() - 1) % m_slots.size() ];
+}
+
+HNMDHHTrack::HNMDHHTrack()
+{
+    m_hasStatus = false;
+    m_current   = HNMDHH_STATUS_UNKNOWN;
+
+    for( uint i = 0; i < HNMDHH_TIER_COUNT; i++ )
+        m_tiers[i].setCapacity( g_tierSlots[i] );
+}
+
+HNMDHHTrack::~HNMDHHTrack()
+{
+
+}
+
+bool
+HNMDHHTrack::record( time_t timestamp, HNMDHH_STATUS_T status )
+{
+    // Only transitions are kept
+    if( (m_hasStatus == true) && (m_current == status) )
+        return false;
+
+    m_hasStatus = true;
+    m_current   = status;
+
+    HNMDHHSample sample;
+    sample.init( timestamp, status );
+
+    HNMDHHSample evicted;
+    if( m_tiers[ HNMDHH_TIER_RAW ].push( sample, evicted ) == true )
+        foldInto( HNMDHH_TIER_HOUR, evicted );
+
+    return true;
+}
+
+void
+HNMDHHTrack::foldInto( uint tier, const HNMDHHSample &sample )
+{
+    time_t period = g_tierPeriod[ tier ];
+
+    // Samples arrive oldest first, and are always newer than anything
+    // already in this tier.  Merge into the newest bucket if it covers
+    // the same period, otherwise start a new bucket.
+    HNMDHHSample *bucket = m_tiers[ tier ].newest();
+
+    if( (bucket != NULL) && ((bucket->getStartTime() / period) == (sample.getStartTime() / period)) )
+    {
+        HNMDHHSample merged = sample;
+        merged.merge( *bucket );
+        *bucket = merged;
+        return;
+    }
+
+    HNMDHHSample evicted;
+    if( m_tiers[ tier ].push( sample, evicted ) == false )
+        return;
+
+    // Past the last tier the history is dropped
+    if( (tier + 1) < HNMDHH_TIER_COUNT )
+        foldInto( tier + 1, evicted );
+}
+
+HNMDHH_STATUS_T
+HNMDHHTrack::getCurrentStatus()
+{
+    return m_current;
+}
+
+void
+HNMDHHTrack::writeRangeAsJSON( std::ostream &os, time_t start, time_t end )
+{
+    bool first = true;
+
+    os << "[";
+
+    // Oldest tier first so the output is in time order
+    for( int tier = (HNMDHH_TIER_COUNT - 1); tier >= 0; tier-- )
+    {
+        const HNMDHHRing &ring = m_tiers[ tier ];
+
+        for( uint i = 0; i < ring.size(); i++ )
+        {
+            const HNMDHHSample &sample = ring.at( i );
+
+            if( (sample.getEndTime() < start) || (sample.getStartTime() > end) )
+                continue;
+
+            if( first == false )
+                os << ",";
+            first = false;
+
+            os << "{\"tier\":\"" << HNMDHealthHistory::tierToStr( (HNMDHH_TIER_T) tier ) << "\"";
+            os << ",\"start\":" << (long) sample.getStartTime();
+            os << ",\"end\":" << (long) sample.getEndTime();
+            os << ",\"status\":\"" << HNMDHealthHistory::statusToStr( sample.getLastStatus() ) << "\"";
+            os << ",\"worst\":\"" << HNMDHealthHistory::statusToStr( sample.getWorstStatus() ) << "\"";
+            os << ",\"transitions\":" << sample.getTransitionCount() << "}";
+        }
+    }
+
+    os << "]";
+}
+
+HNMDHealthHistory::HNMDHealthHistory()
+{
+
+}
+
+HNMDHealthHistory::~HNMDHealthHistory()
+{
+
+}
+
+HNMDHH_STATUS_T
+HNMDHealthHistory::statusFromStr( const std::string &value )
+{
+    if( strcasecmp( value.c_str(), "OK" ) == 0 )
+        return HNMDHH_STATUS_OK;
+    else if( strcasecmp( value.c_str(), "DEGRADED" ) == 0 )
+        return HNMDHH_STATUS_DEGRADED;
+    else if( strcasecmp( value.c_str(), "FAILED" ) == 0 )
+        return HNMDHH_STATUS_FAILED;
+
+    return HNMDHH_STATUS_UNKNOWN;
+}
+
+const char*
+HNMDHealthHistory::statusToStr( HNMDHH_STATUS_T value )
+{
+    switch( value )
+    {
+        case HNMDHH_STATUS_OK:
+            return "OK";
+        case HNMDHH_STATUS_DEGRADED:
+            return "DEGRADED";
+        case HNMDHH_STATUS_FAILED:
+            return "FAILED";
+        case HNMDHH_STATUS_UNKNOWN:
+        default:
+        break;
+    }
+
+    return "UNKNOWN";
+}
+
+const char*
+HNMDHealthHistory::tierToStr( HNMDHH_TIER_T value )
+{
+    switch( value )
+    {
+        case HNMDHH_TIER_RAW:
+            return "raw";
+        case HNMDHH_TIER_HOUR:
+            return "hour";
+        case HNMDHH_TIER_DAY:
+            return "day";
+        default:
+        break;
+    }
+
+    return "unknown";
+}
+
+void
+HNMDHealthHistory::recordComponentStatus( uint32_t crc32ID, const std::string &compID, const std::string &statusStr, time_t timestamp )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_historyMutex );
+
+    if( m_deviceMap[ crc32ID ][ compID ].record( timestamp, statusFromStr( statusStr ) ) == true )
+        std::cout << "Health History - " << HNManagedDeviceArbiter::formatCRC32IDStr( crc32ID ) << "/" << compID << " -> " << statusStr << std::endl;
+}
+
+void
+HNMDHealthHistory::removeDevice( uint32_t crc32ID )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_historyMutex );
+
+    m_deviceMap.erase( crc32ID );
+}
+
+void
+HNMDHealthHistory::writeHistoryAsJSON( std::ostream &os, uint32_t crc32ID, std::string compID, time_t start, time_t end )
+{
+    bool firstDev = true;
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_historyMutex );
+
+    os << "{\"start\":" << (long) start << ",\"end\":" << (long) end << ",\"devices\":[";
+
+    for( std::unordered_map< uint32_t, std::map< std::string, HNMDHHTrack > >::iterator dit = m_deviceMap.begin(); dit != m_deviceMap.end(); dit++ )
+    {
+        if( (crc32ID != 0) && (dit->first != crc32ID) )
+            continue;
+
+        if( firstDev == false )
+            os << ",";
+        firstDev = false;
+
+        os << "{\"crc32ID\":\"" << HNManagedDeviceArbiter::formatCRC32IDStr( dit->first ) << "\",\"components\":[";
+
+        bool firstComp = true;
+        for( std::map< std::string, HNMDHHTrack >::iterator cit = dit->second.begin(); cit != dit->second.end(); cit++ )
+        {
+            if( (compID.empty() == false) && (cit->first != compID) )
+                continue;
+
+            if( firstComp == false )
+                os << ",";
+            firstComp = false;
+
+            os << "{\"id\":";
+            HNMDJsonWriter::writeEscaped( os, cit->first );
+            os << ",\"status\":\"" << statusToStr( cit->second.getCurrentStatus() ) << "\",\"history\":";
+
+            cit->second.writeRangeAsJSON( os, start, end );
+
+            os << "}";
+        }
+
+        os << "]}";
+    }
+
+    os << "]}";
+}
@@ -0,0 +1,147 @@
+#ifndef __HN_MD_HEALTH_HISTORY_H__
+#define __HN_MD_HEALTH_HISTORY_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <ostream>
+
+// Recent status transitions kept per component, as recorded
+#define HNMDHH_RAW_SLOTS   64
+
+// Older transitions are folded into hourly buckets, a week's worth
+#define HNMDHH_HOUR_SLOTS  168
+
+// Then into daily buckets, about a year's worth
+#define HNMDHH_DAY_SLOTS   365
+
+typedef enum HNMDHealthHistoryTierEnum
+{
+    HNMDHH_TIER_RAW,
+    HNMDHH_TIER_HOUR,
+    HNMDHH_TIER_DAY,
+    HNMDHH_TIER_COUNT
+}HNMDHH_TIER_T;
+
+// Ordered by severity, so the worst of two is the larger.
+typedef enum HNMDHealthHistoryStatusEnum
+{
+    HNMDHH_STATUS_OK,
+    HNMDHH_STATUS_UNKNOWN,
+    HNMDHH_STATUS_DEGRADED,
+    HNMDHH_STATUS_FAILED,
+    HNMDHH_STATUS_COUNT
+}HNMDHH_STATUS_T;
+
+// A status transition, or a bucket of them once downsampled.
+class HNMDHHSample
+{
+    public:
+        HNMDHHSample();
+       ~HNMDHHSample();
+
+        void init( time_t timestamp, HNMDHH_STATUS_T status );
+        void merge( const HNMDHHSample &older );
+
+        time_t getStartTime() const;
+        time_t getEndTime() const;
+
+        HNMDHH_STATUS_T getLastStatus() const;
+        HNMDHH_STATUS_T getWorstStatus() const;
+
+        uint32_t getTransitionCount() const;
+
+    private:
+        time_t   m_start;
+        time_t   m_end;
+
+        uint8_t  m_last;
+        uint8_t  m_worst;
+
+        uint32_t m_transitions;
+};
+
+// Fixed capacity ring of samples, oldest overwritten first.
+// Storage grows with use up to the capacity.
+class HNMDHHRing
+{
+    public:
+        HNMDHHRing();
+       ~HNMDHHRing();
+
+        void setCapacity( uint capacity );
+
+        // Returns true if a sample had to be evicted to make room.
+        bool push( const HNMDHHSample &sample, HNMDHHSample &evicted );
+
+        uint size() const;
+
+        // Index 0 is the oldest sample
+        const HNMDHHSample& at( uint index ) const;
+
+        HNMDHHSample* newest();
+
+    private:
+        std::vector< HNMDHHSample > m_slots;
+
+        uint m_capacity;
+        uint m_head;
+};
+
+// Status history for a single device component.
+class HNMDHHTrack
+{
+    public:
+        HNMDHHTrack();
+       ~HNMDHHTrack();
+
+        // Returns true if the status was a transition and was recorded.
+        bool record( time_t timestamp, HNMDHH_STATUS_T status );
+
+        HNMDHH_STATUS_T getCurrentStatus();
+
+        void writeRangeAsJSON( std::ostream &os, time_t start, time_t end );
+
+    private:
+        bool            m_hasStatus;
+        HNMDHH_STATUS_T m_current;
+
+        HNMDHHRing m_tiers[ HNMDHH_TIER_COUNT ];
+
+        void foldInto( uint tier, const HNMDHHSample &sample );
+};
+
+class HNMDHealthHistory
+{
+    public:
+        HNMDHealthHistory();
+       ~HNMDHealthHistory();
+
+        void recordComponentStatus( uint32_t crc32ID, const std::string &compID, const std::string &statusStr, time_t timestamp );
+
+        void removeDevice( uint32_t crc32ID );
+
+        // Write matching history straight to the stream.  A crc32ID of 0
+        // or an empty compID matches everything.
+        void writeHistoryAsJSON( std::ostream &os, uint32_t crc32ID, std::string compID, time_t start, time_t end );
+
+        static HNMDHH_STATUS_T statusFromStr( const std::string &value );
+        static const char* statusToStr( HNMDHH_STATUS_T value );
+        static const char* tierToStr( HNMDHH_TIER_T value );
+
+    private:
+        // Guards m_deviceMap, taken with no other locks held
+        // or as the innermost lock.
+        std::mutex m_historyMutex;
+
+        // Device CRC32ID to the tracks for its components
+        std::unordered_map< uint32_t, std::map< std::string, HNMDHHTrack > > m_deviceMap;
+};
+
+#endif // __HN_MD_HEALTH_HISTORY_H__
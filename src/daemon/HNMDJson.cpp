@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "HNMDJson.h"
+
+HNMDJsonWriter::HNMDJsonWriter( std::string &buffer )
+: m_buffer( buffer )
+{
+    m_afterKey = false;
+}
+
+HNMDJsonWriter::~HNMDJsonWriter()
+{
+
+}
+
+void
+HNMDJsonWriter::appendEscaped( std::string &buffer, const char *value, size_t length )
+{
+    const char *runStart = value;
+    const char *end = value + length;
+
+    buffer += '"';
+
+    // Copy runs of plain characters in one go
+    for( const char *cp = value; cp < end; cp++ )
+    {
+        unsigned char c = (unsigned char) *cp;
+
+        if( (c >= 0x20) && (c != '"') && (c != '\\') )
+            continue;
+
+        buffer.append( runStart, cp - runStart );
+        runStart = cp + 1;
+
+        switch( c )
+        {
+            case '"':  buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\b': buffer += "\\b";  break;
+            case '\f': buffer += "\\f";  break;
+            case '\n': buffer += "\\n";  break;
+            case '\r': buffer += "\\r";  break;
+            case '\t': buffer += "\\t";  break;
+            default:
+            {
+                char tmpBuf[8];
+                snprintf( tmpBuf, sizeof(tmpBuf), "\\u%04x", c );
+                buffer += tmpBuf;
+            }
+            break;
+        }
+    }
+
+    buffer.append( runStart, end - runStart );
+
+    buffer += '"';
+}
+
+// Stream form of appendEscaped, for output built on an ostream
+void
+HNMDJsonWriter::writeEscaped( std::ostream &os, const std::string &value )
+{
+    std::string tmpStr;
+
+    appendEscaped( tmpStr, value.data(), value.size() );
+
+    os << tmpStr;
+}
+
+void
+HNMDJsonWriter::startElement()
+{
+    // A value following its key needs no separator
+    if( m_afterKey == true )
+    {
+        m_afterKey = false;
+        return;
+    }
+
+    if( m_firstStack.empty() == true )
+        return;
+
+    if( m_firstStack.back() == false )
+        m_buffer += ',';
+
+    m_firstStack.back() = false;
+}
+
+void
+HNMDJsonWriter::beginObject()
+{
+    startElement();
+    m_buffer += '{';
+    m_firstStack.push_back( true );
+}
+
+void
+HNMDJsonWriter::endObject()
+{
+    m_buffer += '}';
+    m_firstStack.pop_back();
+}
+
+void
+HNMDJsonWriter::beginArray()
+{
+    startElement();
+    m_buffer += '[';
+    m_firstStack.push_back( true );
+}
+
+void
+HNMDJsonWriter::endArray()
+{
+    m_buffer += ']';
+    m_firstStack.pop_back();
+}
+
+void
+HNMDJsonWriter::key( const char *name )
+{
+    startElement();
+    appendEscaped( m_buffer, name, strlen( name ) );
+    m_buffer += ':';
+    m_afterKey = true;
+}
+
+void
+HNMDJsonWriter::key( const std::string &name )
+{
+    startElement();
+    appendEscaped( m_buffer, name.data(), name.size() );
+    m_buffer += ':';
+    m_afterKey = true;
+}
+
+void
+HNMDJsonWriter::value( const std::string &value )
+{
+    startElement();
+    appendEscaped( m_buffer, value.data(), value.size() );
+}
+
+void
+HNMDJsonWriter::value( const char *value )
+{
+    startElement();
+    appendEscaped( m_buffer, value, strlen( value ) );
+}
+
+void
+HNMDJsonWriter::value( bool value )
+{
+    startElement();
+    m_buffer += (value == true) ? "true" : "false";
+}
+
+void
+HNMDJsonWriter::value( int value )
+{
+    char tmpBuf[24];
+
+    startElement();
+    m_buffer.append( tmpBuf, snprintf( tmpBuf, sizeof(tmpBuf), "%d", value ) );
+}
+
+void
+HNMDJsonWriter::value( uint value )
+{
+    char tmpBuf[24];
+
+    startElement();
+    m_buffer.append( tmpBuf, snprintf( tmpBuf, sizeof(tmpBuf), "%u", value ) );
+}
+
+void
+HNMDJsonWriter::value( long value )
+{
+    char tmpBuf[24];
+
+    startElement();
+    m_buffer.append( tmpBuf, snprintf( tmpBuf, sizeof(tmpBuf), "%ld", value ) );
+}
+
+void
+HNMDJsonWriter::value( unsigned long value )
+{
+    char tmpBuf[24];
+
+    startElement();
+    m_buffer.append( tmpBuf, snprintf( tmpBuf, sizeof(tmpBuf), "%lu", value ) );
+}
+
+HNMDJsonReader::HNMDJsonReader()
+{
+    m_cur   = NULL;
+    m_start = NULL;
+    m_end   = NULL;
+    m_handler = NULL;
+}
+
+HNMDJsonReader::~HNMDJsonReader()
+{
+
+}
+
+size_t
+HNMDJsonReader::getErrorOffset()
+{
+    return m_cur - m_start;
+}
+
+std::string
+HNMDJsonReader::getErrorStr()
+{
+    return m_errorStr;
+}
+
+bool
+HNMDJsonReader::fail( const char *reason )
+{
+    if( m_errorStr.empty() == true )
+        m_errorStr = reason;
+
+    return false;
+}
+
+void
+HNMDJsonReader::skipWhitespace()
+{
+    while( (m_cur < m_end) && ((*m_cur == ' ') || (*m_cur == '\t') || (*m_cur == '\n') || (*m_cur == '\r')) )
+        m_cur++;
+}
+
+bool
+HNMDJsonReader::parse( const std::string &document, HNMDJsonHandler &handler )
+{
+    m_start = document.data();
+    m_cur   = m_start;
+    m_end   = m_start + document.size();
+
+    m_handler = &handler;
+    m_errorStr.clear();
+
+    m_key.clear();
+
+    if( parseValue( 0, m_key ) == false )
+        return false;
+
+    // Only whitespace may follow the root value
+    skipWhitespace();
+
+    if( m_cur != m_end )
+        return fail( "trailing characters" );
+
+    return true;
+}
+
+bool
+HNMDJsonReader::parseValue( uint depth, const std::string &key )
+{
+    skipWhitespace();
+
+    if( m_cur >= m_end )
+        return fail( "unexpected end of document" );
+
+    switch( *m_cur )
+    {
+        case '{':
+            return parseObject( depth, key );
+
+        case '[':
+            return parseArray( depth, key );
+
+        case '"':
+            if( parseString( m_strValue ) == false )
+                return false;
+
+            if( m_handler->stringValue( depth, key, m_strValue ) == false )
+                return fail( "rejected by handler" );
+        return true;
+
+        case 't':
+            if( parseLiteral( "true" ) == false )
+                return false;
+
+            if( m_handler->boolValue( depth, key, true ) == false )
+                return fail( "rejected by handler" );
+        return true;
+
+        case 'f':
+            if( parseLiteral( "false" ) == false )
+                return false;
+
+            if( m_handler->boolValue( depth, key, false ) == false )
+                return fail( "rejected by handler" );
+        return true;
+
+        case 'n':
+            if( parseLiteral( "null" ) == false )
+                return false;
+
+            if( m_handler->nullValue( depth, key ) == false )
+                return fail( "rejected by handler" );
+        return true;
+
+        default:
+            if( parseNumber( m_strValue ) == false )
+                return false;
+
+            if( m_handler->numberValue( depth, key, m_strValue ) == false )
+                return fail( "rejected by handler" );
+        return true;
+    }
+}
+
+bool
+HNMDJsonReader::parseObject( uint depth, const std::string &key )
+{
+    if( depth >= HNMDJSON_MAX_DEPTH )
+        return fail( "nesting too deep" );
+
+    if( m_handler->objectStart( depth, key ) == false )
+        return fail( "rejected by handler" );
+
+    // Skip the '{'
+    m_cur++;
+
+    skipWhitespace();
+
+    if( (m_cur < m_end) && (*m_cur == '}') )
+    {
+        m_cur++;
+        return m_handler->objectEnd( depth ) ? true : fail( "rejected by handler" );
+    }
+
+    while( true )
+    {
+        skipWhitespace();
+
+        if( (m_cur >= m_end) || (*m_cur != '"') )
+            return fail( "expected member name" );
+
+        // The key is only needed until the member's value
+        // has been started, so a single buffer is shared.
+        if( parseString( m_key ) == false )
+            return false;
+
+        skipWhitespace();
+
+        if( (m_cur >= m_end) || (*m_cur != ':') )
+            return fail( "expected ':'" );
+
+        m_cur++;
+
+        if( parseValue( depth + 1, m_key ) == false )
+            return false;
+
+        skipWhitespace();
+
+        if( m_cur >= m_end )
+            return fail( "unexpected end of document" );
+
+        if( *m_cur == ',' )
+        {
+            m_cur++;
+            continue;
+        }
+
+        if( *m_cur == '}' )
+        {
+            m_cur++;
+            break;
+        }
+
+        return fail( "expected ',' or '}'" );
+    }
+
+    if( m_handler->objectEnd( depth ) == false )
+        return fail( "rejected by handler" );
+
+    return true;
+}
+
+bool
+HNMDJsonReader::parseArray( uint depth, const std::string &key )
+{
+    static const std::string noKey;
+
+    if( depth >= HNMDJSON_MAX_DEPTH )
+        return fail( "nesting too deep" );
+
+    if( m_handler->arrayStart( depth, key ) == false )
+        return fail( "rejected by handler" );
+
+    // Skip the '['
+    m_cur++;
+
+    skipWhitespace();
+
+    if( (m_cur < m_end) && (*m_cur == ']') )
+    {
+        m_cur++;
+        return m_handler->arrayEnd( depth ) ? true : fail( "rejected by handler" );
+    }
+
+    while( true )
+    {
+        if( parseValue( depth + 1, noKey ) == false )
+            return false;
+
+        skipWhitespace();
+
+        if( m_cur >= m_end )
+            return fail( "unexpected end of document" );
+
+        if( *m_cur == ',' )
+        {
+            m_cur++;
+            continue;
+        }
+
+        if( *m_cur == ']' )
+        {
+            m_cur++;
+            break;
+        }
+
+        return fail( "expected ',' or ']'" );
+    }
+
+    if( m_handler->arrayEnd( depth ) == false )
+        return fail( "rejected by handler" );
+
+    return true;
+}
+
+static int
+hexValue( char c )
+{
+    if( (c >= '0') && (c <= '9') )
+        return c - '0';
+    if( (c >= 'a') && (c <= 'f') )
+        return c - 'a' + 10;
+    if( (c >= 'A') && (c <= 'F') )
+        return c - 'A' + 10;
+    return -1;
+}
+
+static void
+appendUTF8( std::string &value, uint32_t cp )
+{
+    if( cp < 0x80 )
+    {
+        value += (char) cp;
+    }
+    else if( cp < 0x800 )
+    {
+        value += (char) (0xC0 | (cp >> 6));
+        value += (char) (0x80 | (cp & 0x3F));
+    }
+    else if( cp < 0x10000 )
+    {
+        value += (char) (0xE0 | (cp >> 12));
+        value += (char) (0x80 | ((cp >> 6) & 0x3F));
+        value += (char) (0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        value += (char) (0xF0 | (cp >> 18));
+        value += (char) (0x80 | ((cp >> 12) & 0x3F));
+        value += (char) (0x80 | ((cp >> 6) & 0x3F));
+        value += (char) (0x80 | (cp & 0x3F));
+    }
+}
+
+bool
+HNMDJsonReader::parseString( std::string &value )
+{
+    value.clear();
+
+    // Skip the opening quote
+    m_cur++;
+
+    const char *runStart = m_cur;
+
+    while( m_cur < m_end )
+    {
+        unsigned char c = (unsigned char) *m_cur;
+
+        if( c == '"' )
+        {
+            value.append( runStart, m_cur - runStart );
+            m_cur++;
+            return true;
+        }
+
+        if( c < 0x20 )
+            return fail( "control character in string" );
+
+        if( c != '\\' )
+        {
+            m_cur++;
+            continue;
+        }
+
+        // Flush the plain run before the escape
+        value.append( runStart, m_cur - runStart );
+        m_cur++;
+
+        if( m_cur >= m_end )
+            break;
+
+        switch( *m_cur )
+        {
+            case '"':  value += '"';  break;
+            case '\\': value += '\\'; break;
+            case '/':  value += '/';  break;
+            case 'b':  value += '\b'; break;
+            case 'f':  value += '\f'; break;
+            case 'n':  value += '\n'; break;
+            case 'r':  value += '\r'; break;
+            case 't':  value += '\t'; break;
+
+            case 'u':
+            {
+                uint32_t cp = 0;
+
+                if( (m_end - m_cur) < 5 )
+                    return fail( "truncated escape" );
+
+                for( uint i = 1; i <= 4; i++ )
+                {
+                    int nibble = hexValue( m_cur[i] );
+                    if( nibble < 0 )
+                        return fail( "bad escape" );
+                    cp = (cp << 4) | nibble;
+                }
+
+                m_cur += 4;
+
+                // Combine a surrogate pair
+                if( (cp >= 0xD800) && (cp <= 0xDBFF) && ((m_end - m_cur) >= 7) && (m_cur[1] == '\\') && (m_cur[2] == 'u') )
+                {
+                    uint32_t low = 0;
+                    bool valid = true;
+
+                    for( uint i = 3; i <= 6; i++ )
+                    {
+                        int nibble = hexValue( m_cur[i] );
+                        if( nibble < 0 )
+                            valid = false;
+                        low = (low << 4) | (nibble & 0xF);
+                    }
+
+                    if( (valid == true) && (low >= 0xDC00) && (low <= 0xDFFF) )
+                    {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        m_cur += 6;
+                    }
+                }
+
+                appendUTF8( value, cp );
+            }
+            break;
+
+            default:
+                return fail( "bad escape" );
+        }
+
+        m_cur++;
+        runStart = m_cur;
+    }
+
+    return fail( "unterminated string" );
+}
+
+bool
+HNMDJsonReader::parseNumber( std::string &value )
+{
+    const char *numStart = m_cur;
+
+    if( (m_cur < m_end) && (*m_cur == '-') )
+        m_cur++;
+
+    if( (m_cur >= m_end) || (*m_cur < '0') || (*m_cur > '9') )
+        return fail( "unexpected character" );
+
+    while( (m_cur < m_end) && (*m_cur >= '0') && (*m_cur <= '9') )
+        m_cur++;
+
+    if( (m_cur < m_end) && (*m_cur == '.') )
+    {
+        m_cur++;
+
+        if( (m_cur >= m_end) || (*m_cur < '0') || (*m_cur > '9') )
+            return fail( "bad number" );
+
+        while( (m_cur < m_end) && (*m_cur >= '0') && (*m_cur <= '9') )
+            m_cur++;
+    }
+
+    if( (m_cur < m_end) && ((*m_cur == 'e') || (*m_cur == 'E')) )
+    {
+        m_cur++;
+
+        if( (m_cur < m_end) && ((*m_cur == '+') || (*m_cur == '-')) )
+            m_cur++;
+
+        if( (m_cur >= m_end) || (*m_cur < '0') || (*m_cur > '9') )
+            return fail( "bad number" );
+
+        while( (m_cur < m_end) && (*m_cur >= '0') && (*m_cur <= '9') )
+            m_cur++;
+    }
+
+    value.assign( numStart, m_cur - numStart );
+
+    return true;
+}
+
+bool
+HNMDJsonReader::parseLiteral( const char *literal )
+{
+    size_t length = strlen( literal );
+
+    if( ((size_t)(m_end - m_cur) < length) || (memcmp( m_cur, literal, length ) != 0) )
+        return fail( "unexpected character" );
+
+    m_cur += length;
+
+    return true;
+}
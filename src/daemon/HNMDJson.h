@@ -0,0 +1,127 @@
+#ifndef __HN_MD_JSON_H__
+#define __HN_MD_JSON_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Deepest nesting HNMDJsonReader will follow
+#define HNMDJSON_MAX_DEPTH  32
+
+// Writes JSON text straight onto the end of a caller owned
+// buffer, with no intermediate document.  The caller is
+// responsible for balancing begin/end calls.
+class HNMDJsonWriter
+{
+    public:
+        HNMDJsonWriter( std::string &buffer );
+       ~HNMDJsonWriter();
+
+        void beginObject();
+        void endObject();
+
+        void beginArray();
+        void endArray();
+
+        // Start a member of the enclosing object, followed
+        // by a value, object or array.
+        void key( const char *name );
+        void key( const std::string &name );
+
+        void value( const std::string &value );
+        void value( const char *value );
+        void value( bool value );
+        void value( int value );
+        void value( uint value );
+        void value( long value );
+        void value( unsigned long value );
+
+        template< typename T > void field( const char *name, T fieldValue )
+        {
+            key( name );
+            value( fieldValue );
+        }
+
+        static void appendEscaped( std::string &buffer, const char *value, size_t length );
+        static void writeEscaped( std::ostream &os, const std::string &value );
+
+    private:
+        std::string &m_buffer;
+
+        // One entry per open container, true until its
+        // first element has been written.
+        std::vector< bool > m_firstStack;
+
+        bool m_afterKey;
+
+        void startElement();
+};
+
+// Callbacks from HNMDJsonReader.  Depth is the nesting level of
+// the value, the root being 0.  Key is the member name when the
+// value is inside an object and empty inside an array.  Return
+// false from any callback to stop the parse with an error.
+class HNMDJsonHandler
+{
+    public:
+        virtual ~HNMDJsonHandler() {}
+
+        virtual bool objectStart( uint depth, const std::string &key ) { return true; }
+        virtual bool objectEnd( uint depth ) { return true; }
+
+        virtual bool arrayStart( uint depth, const std::string &key ) { return true; }
+        virtual bool arrayEnd( uint depth ) { return true; }
+
+        virtual bool stringValue( uint depth, const std::string &key, const std::string &value ) { return true; }
+
+        // Number text as it appeared in the document
+        virtual bool numberValue( uint depth, const std::string &key, const std::string &value ) { return true; }
+
+        virtual bool boolValue( uint depth, const std::string &key, bool value ) { return true; }
+        virtual bool nullValue( uint depth, const std::string &key ) { return true; }
+};
+
+// Event driven JSON parser, values are handed to the handler
+// as they are read and no document is kept.
+class HNMDJsonReader
+{
+    public:
+        HNMDJsonReader();
+       ~HNMDJsonReader();
+
+        // Returns true if the whole document was parsed
+        bool parse( const std::string &document, HNMDJsonHandler &handler );
+
+        // Offset of the failure, and why
+        size_t getErrorOffset();
+        std::string getErrorStr();
+
+    private:
+        const char *m_cur;
+        const char *m_start;
+        const char *m_end;
+
+        HNMDJsonHandler *m_handler;
+
+        // Reused for each member name and string value
+        std::string m_key;
+        std::string m_strValue;
+
+        std::string m_errorStr;
+
+        bool fail( const char *reason );
+
+        void skipWhitespace();
+
+        bool parseValue( uint depth, const std::string &key );
+        bool parseObject( uint depth, const std::string &key );
+        bool parseArray( uint depth, const std::string &key );
+        bool parseString( std::string &value );
+        bool parseNumber( std::string &value );
+        bool parseLiteral( const char *literal );
+};
+
+#endif // __HN_MD_JSON_H__
@@ -1,7 +1,20 @@
 #include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <limits.h>
+#include <syslog.h>
 
 #include <iostream>
+#include <sstream>
 #include <regex>
+#include <algorithm>
+#include <atomic>
 
 #include <Poco/Thread.h>
 #include <Poco/Runnable.h>
@@ -19,6 +32,7 @@
 #include <Poco/Net/HTTPResponse.h>
 #include <Poco/URI.h>
 
+#include "HNMDJson.h"
 #include "HNManagedDeviceArbiter.h"
 
 namespace pjs = Poco::JSON;
@@ -108,44 +122,83 @@ HNMDMgmtCmd::getFieldMask()
     return m_fieldMask;
 }
 
+// Picks the command fields out of a management command request
+class HNMDMgmtCmdJsonHandler : public HNMDJsonHandler
+{
+    public:
+        HNMDMgmtCmdJsonHandler()
+        {
+            m_hasCommand = false;
+            m_hasName = false;
+        }
+
+        virtual bool arrayStart( uint depth, const std::string &key )
+        {
+            // Root must be an object
+            return (depth != 0);
+        }
+
+        virtual bool stringValue( uint depth, const std::string &key, const std::string &value )
+        {
+            if( depth != 1 )
+                return (depth != 0);
+
+            if( key == "command" )
+            {
+                m_hasCommand = true;
+                m_command = value;
+            }
+            else if( key == "name" )
+            {
+                m_hasName = true;
+                m_name = value;
+            }
+
+            return true;
+        }
+
+        bool        m_hasCommand;
+        std::string m_command;
+
+        bool        m_hasName;
+        std::string m_name;
+};
+
 HNMDL_RESULT_T
 HNMDMgmtCmd::setFromJSON( std::istream *bodyStream )
 {
+    std::string body;
+    HNMDJsonReader reader;
+    HNMDMgmtCmdJsonHandler handler;
+
     // Clear things to start
     clear();
 
     // Parse the json body of the request
-    try
-    {
-        // Attempt to parse the json    
-        pjs::Parser parser;
-        pdy::Var varRoot = parser.parse( *bodyStream );
-
-        // Get a pointer to the root object
-        pjs::Object::Ptr jsRoot = varRoot.extract< pjs::Object::Ptr >();
+    Poco::StreamCopier::copyToString( *bodyStream, body );
 
-        // All requests must include a command field
-        if( jsRoot->has( "command" ) == false )
-            return HNMDL_RESULT_FAILURE;
+    if( reader.parse( body, handler ) == false )
+    {
+        std::cout << "HNMDMgmtCmd::setFromJSON parse error: " << reader.getErrorStr() << " at " << reader.getErrorOffset() << std::endl;
+        // Request body was not understood
+        return HNMDL_RESULT_FAILURE;
+    }
 
-        // Set the command type
-        if( setTypeFromStr( jsRoot->getValue<std::string>( "command" ) ) == true )
-        {
-            return HNMDL_RESULT_FAILURE;
-        }
+    // All requests must include a command field
+    if( handler.m_hasCommand == false )
+        return HNMDL_RESULT_FAILURE;
 
-        if( jsRoot->has( "name" ) )
-        {
-            setName( jsRoot->getValue<std::string>( "name" ) );
-        }
-    }
-    catch( Poco::Exception ex )
+    // Set the command type
+    if( setTypeFromStr( handler.m_command ) == true )
     {
-        std::cout << "HNMDMgmtCmd::setFromJSON exception: " << ex.displayText() << std::endl;
-        // Request body was not understood
         return HNMDL_RESULT_FAILURE;
     }
 
+    if( handler.m_hasName == true )
+    {
+        setName( handler.m_name );
+    }
+
     // Done
     return HNMDL_RESULT_SUCCESS;
 }
@@ -174,6 +227,12 @@ HNMDMgmtCmd::getUpdateFieldsJSON( std::ostream &os )
 HNMDARAddress::HNMDARAddress()
 {
     m_type = HMDAR_ADDRTYPE_NOTSET;
+    m_port = 0;
+
+    m_connectable  = false;
+    m_rttMS        = 0;
+    m_failCnt      = 0;
+    m_lastFailTime = 0;
 }
 
 HNMDARAddress::~HNMDARAddress()
@@ -184,10 +243,20 @@ HNMDARAddress::~HNMDARAddress()
 void 
 HNMDARAddress::setAddressInfo( std::string dnsName, std::string address, uint16_t port )
 {
+    // Classification parses the address, skip it when nothing changed
+    if( (m_type != HMDAR_ADDRTYPE_NOTSET) && (m_address == address) )
+    {
+        m_dnsName = dnsName;
+        m_port = port;
+        return;
+    }
+
     m_dnsName = dnsName;
     m_address = address;
     m_port = port;
 
+    m_connectable = false;
+
     // Use Poco to do IPAddress validation, etc.
     try 
     {
@@ -199,6 +268,7 @@ HNMDARAddress::setAddressInfo( std::string dnsName, std::string address, uint16_
                 if( trialAddr.isLoopback() )
                 {
                     m_type = HNDAR_ADDRTYPE_LOOPBACK_IPV4;
+                    m_connectable = true;
                     return;
                 }
                 else if( trialAddr.isMulticast() || trialAddr.isBroadcast() )
@@ -209,11 +279,13 @@ HNMDARAddress::setAddressInfo( std::string dnsName, std::string address, uint16_
                 else if( trialAddr.isLinkLocal() || trialAddr.isSiteLocal() )
                 {
                     m_type = HMDAR_ADDRTYPE_IPV4;
+                    m_connectable = true;
                     return;
                 }
                 else
                 {
                     m_type = HNDAR_ADDRTYPE_INET_IPV4;
+                    m_connectable = true;
                     return;
                 }
             break;
@@ -222,6 +294,7 @@ HNMDARAddress::setAddressInfo( std::string dnsName, std::string address, uint16_
                 if( trialAddr.isLoopback() )
                 {
                     m_type = HNDAR_ADDRTYPE_LOOPBACK_IPV6;
+                    m_connectable = true;
                     return;
                 }
                 else if( trialAddr.isMulticast() || trialAddr.isBroadcast() )
@@ -231,12 +304,15 @@ HNMDARAddress::setAddressInfo( std::string dnsName, std::string address, uint16_
                 }
                 else if( trialAddr.isLinkLocal() || trialAddr.isSiteLocal() )
                 {
+                    // Link local needs the interface to connect through
                     m_type = HMDAR_ADDRTYPE_IPV6;
+                    m_connectable = ( trialAddr.isLinkLocal() == false ) || ( address.find( '%' ) != std::string::npos );
                     return;
                 }
                 else
                 {
                     m_type = HNDAR_ADDRTYPE_INET_IPV6;
+                    m_connectable = true;
                     return;
                 }
             break;
@@ -257,6 +333,73 @@ HNMDARAddress::getType()
     return m_type;
 }
 
+bool
+HNMDARAddress::isConnectable()
+{
+    return m_connectable;
+}
+
+bool
+HNMDARAddress::isIPv6()
+{
+    return ( (m_type == HMDAR_ADDRTYPE_IPV6) || (m_type == HNDAR_ADDRTYPE_LOOPBACK_IPV6)
+             || (m_type == HNDAR_ADDRTYPE_CAST_IPV6) || (m_type == HNDAR_ADDRTYPE_INET_IPV6) );
+}
+
+void
+HNMDARAddress::recordSuccess( uint rttMS )
+{
+    // Exponentially weighted, 1/8 per sample
+    if( m_rttMS == 0 )
+        m_rttMS = (rttMS > 0) ? rttMS : 1;
+    else
+        m_rttMS = ( (m_rttMS * 7) + rttMS + 7 ) / 8;
+
+    m_failCnt = 0;
+}
+
+void
+HNMDARAddress::recordFailure( time_t now )
+{
+    m_failCnt += 1;
+    m_lastFailTime = now;
+}
+
+uint
+HNMDARAddress::getRTT()
+{
+    return m_rttMS;
+}
+
+uint
+HNMDARAddress::getFailCount()
+{
+    return m_failCnt;
+}
+
+uint
+HNMDARAddress::getScore( time_t now )
+{
+    if( m_connectable == false )
+        return UINT_MAX;
+
+    uint score = (m_rttMS != 0) ? m_rttMS : HNMDAR_ADDR_DEFAULT_RTT_MS;
+
+    // Hold failing addresses off for a while, longer the more
+    // they fail, then let them compete on round trip again.
+    if( m_failCnt > 0 )
+    {
+        uint holdoff = m_failCnt * HNMDAR_ADDR_FAIL_HOLDOFF_SECS;
+        if( holdoff > HNMDAR_ADDR_FAIL_HOLDOFF_MAX )
+            holdoff = HNMDAR_ADDR_FAIL_HOLDOFF_MAX;
+
+        if( (now - m_lastFailTime) < (time_t) holdoff )
+            score += m_failCnt * HNMDAR_ADDR_FAIL_PENALTY_MS;
+    }
+
+    return score;
+}
+
 const char* gHNMDARAddressTypeStrings[] =
 {
    "not-set",       // HMDAR_ADDRTYPE_NOTSET,
@@ -311,14 +454,55 @@ HNMDARAddress::debugPrint( uint offset )
 }
 
 
+std::mutex HNMDSymbolTable::s_tableMutex;
+std::unordered_set< std::string > HNMDSymbolTable::s_table;
+
+HNMDSymbol
+HNMDSymbolTable::intern( const std::string &value )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( s_tableMutex );
+
+    // Elements of an unordered_set are never relocated,
+    // so the address is stable for the life of the table.
+    return &( *s_table.insert( value ).first );
+}
+
+HNMDSymbol
+HNMDSymbolTable::lookup( const std::string &value )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( s_tableMutex );
+
+    std::unordered_set< std::string >::iterator it = s_table.find( value );
+
+    if( it == s_table.end() )
+        return NULL;
+
+    return &( *it );
+}
+
+const std::string&
+HNMDSymbolTable::str( HNMDSymbol symbol )
+{
+    static const std::string emptyStr;
+
+    if( symbol == NULL )
+        return emptyStr;
+
+    return *symbol;
+}
+
 HNMDServiceEndpoint::HNMDServiceEndpoint()
 {
+    m_type    = NULL;
+    m_version = NULL;
     m_visited = false;
 }
 
 HNMDServiceEndpoint::~HNMDServiceEndpoint()
 {
-   std::cout << "ServiceEndpoint destruction - type: " << m_type << "  uri: " << m_rootURI << std::endl;
+   std::cout << "ServiceEndpoint destruction - type: " << HNMDSymbolTable::str( m_type ) << "  uri: " << m_rootURI << std::endl;
 }
 
 void
@@ -330,11 +514,17 @@ HNMDServiceEndpoint::clear()
 void
 HNMDServiceEndpoint::setType( std::string type )
 {
-    m_type = type;
+    m_type = HNMDSymbolTable::intern( type );
 }
 
 std::string
 HNMDServiceEndpoint::getType()
+{
+    return HNMDSymbolTable::str( m_type );
+}
+
+HNMDSymbol
+HNMDServiceEndpoint::getTypeSymbol()
 {
     return m_type;
 }
@@ -342,13 +532,13 @@ HNMDServiceEndpoint::getType()
 void
 HNMDServiceEndpoint::setVersion( std::string version )
 {
-    m_version = version;
+    m_version = HNMDSymbolTable::intern( version );
 }
 
 std::string
 HNMDServiceEndpoint::getVersion()
 {
-    return m_version;
+    return HNMDSymbolTable::str( m_version );
 }
 
 void
@@ -379,7 +569,62 @@ HNMDServiceEndpoint::getVisited()
 void 
 HNMDServiceEndpoint::debugPrint( uint offset )
 {
-    printf( "%*.*sService: %s  %s\n", offset, offset, " ", m_type.c_str(), m_rootURI.c_str() );
+    printf( "%*.*sService: %s  %s\n", offset, offset, " ", HNMDSymbolTable::str( m_type ).c_str(), m_rootURI.c_str() );
+}
+
+HNMDARPollState::HNMDARPollState()
+{
+    m_hashValid = false;
+    m_bodyHash  = 0;
+}
+
+HNMDARPollState::~HNMDARPollState()
+{
+
+}
+
+void
+HNMDARPollState::clear()
+{
+    m_etag.clear();
+    m_lastModified.clear();
+
+    m_hashValid = false;
+    m_bodyHash  = 0;
+}
+
+void
+HNMDARPollState::setValidators( std::string etag, std::string lastModified, uint64_t bodyHash )
+{
+    m_etag         = etag;
+    m_lastModified = lastModified;
+
+    m_hashValid = true;
+    m_bodyHash  = bodyHash;
+}
+
+std::string
+HNMDARPollState::getETag()
+{
+    return m_etag;
+}
+
+std::string
+HNMDARPollState::getLastModified()
+{
+    return m_lastModified;
+}
+
+bool
+HNMDARPollState::hasBodyHash()
+{
+    return m_hashValid;
+}
+
+uint64_t
+HNMDARPollState::getBodyHash()
+{
+    return m_bodyHash;
 }
 
 // Helper class for running HNManagedDeviceArbiter 
@@ -414,12 +659,33 @@ class HNMDARunner : public Poco::Runnable
 
 };
 
+// Source of record revisions, unique across all records
+static std::atomic< uint64_t > s_nextRecordRevision( 1 );
+
 HNMDARecord::HNMDARecord()
 {
     m_mgmtState = HNMDR_MGMT_STATE_NOTSET;
     m_ownerState = HNMDR_OWNER_STATE_NOTSET;
 
-    m_deviceMutex = NULL;
+    m_devType    = NULL;
+    m_devVersion = NULL;
+
+    m_lastHealthPush = 0;
+    m_lastHealthPoll = 0;
+
+    m_healthPollInterval = HNMD_HEALTH_POLL_MIN_SECS;
+
+    m_disappearTime = 0;
+
+    m_preferredAddrIdx  = -1;
+    m_preferredAddrTime = 0;
+
+    m_modified = false;
+    m_revision = s_nextRecordRevision++;
+
+    // Allocate the mutex up front, the record may be
+    // locked from more than one thread.
+    m_deviceMutex = new std::mutex();
 }
 
 HNMDARecord::HNMDARecord( const HNMDARecord &srcObj )
@@ -436,14 +702,32 @@ HNMDARecord::HNMDARecord( const HNMDARecord &srcObj )
 
     m_addrList   = srcObj.m_addrList;
 
+    m_ownerHNodeID = srcObj.m_ownerHNodeID;
+
     m_mgmtCmd    = srcObj.m_mgmtCmd;
 
     m_srvMapProvided = srcObj.m_srvMapProvided;
     m_srvMapDesired = srcObj.m_srvMapDesired;
+
+    for( uint i = 0; i < HNMDAR_POLL_EP_COUNT; i++ )
+        m_pollState[ i ] = srcObj.m_pollState[ i ];
+
+    m_lastHealthPush = srcObj.m_lastHealthPush;
+    m_lastHealthPoll = srcObj.m_lastHealthPoll;
+
+    m_healthPollInterval = srcObj.m_healthPollInterval;
+
+    m_disappearTime = srcObj.m_disappearTime;
+
+    m_preferredAddrIdx  = srcObj.m_preferredAddrIdx;
+    m_preferredAddrTime = srcObj.m_preferredAddrTime;
  
+    m_modified = false;
+    m_revision = srcObj.m_revision;
+
     // Do not copy over a mutex as they are unique
     // to each object.
-    m_deviceMutex = NULL;
+    m_deviceMutex = new std::mutex();
 }
 
 HNMDARecord::~HNMDARecord()
@@ -458,9 +742,6 @@ HNMDARecord::~HNMDARecord()
 void
 HNMDARecord::lockForUpdate()
 {
-    if( m_deviceMutex == NULL )
-        m_deviceMutex = new std::mutex();
-
     m_deviceMutex->lock();
 }
 
@@ -474,12 +755,18 @@ HNMDARecord::unlockForUpdate()
 void 
 HNMDARecord::setManagementState( HNMDR_MGMT_STATE_T value )
 {
+    if( (m_mgmtState != value) && (isHealthCycleStep( m_mgmtState, value ) == false) )
+        m_modified = true;
+
     m_mgmtState = value;
 }
 
 void 
 HNMDARecord::setOwnershipState( HNMDR_OWNER_STATE_T value )
 {
+    if( m_ownerState != value )
+        m_modified = true;
+
     m_ownerState = value;
 }
 
@@ -560,40 +847,62 @@ HNMDARecord::getOwnershipStateStr()
 void 
 HNMDARecord::setDiscoveryID( std::string value )
 {
+    if( m_discID != value )
+        m_modified = true;
+
     m_discID = value;
 }
 
 void 
 HNMDARecord::setDeviceType( std::string value )
 {
-    m_devType = value;
+    HNMDSymbol symbol = HNMDSymbolTable::intern( value );
+
+    if( m_devType != symbol )
+        m_modified = true;
+
+    m_devType = symbol;
 }
 
 void 
 HNMDARecord::setDeviceVersion( std::string value )
 {
-    m_devVersion = value;
+    HNMDSymbol symbol = HNMDSymbolTable::intern( value );
+
+    if( m_devVersion != symbol )
+        m_modified = true;
+
+    m_devVersion = symbol;
 }
 
 void 
 HNMDARecord::setHNodeIDFromStr( std::string value )
 {
+    if( getHNodeIDStr() != value )
+        m_modified = true;
+
     m_hnodeID.setFromStr( value );
 }
 
 void 
 HNMDARecord::setInstance( std::string value )
 {
+    if( m_instance != value )
+        m_modified = true;
+
     m_instance = value;
 }
 
 void 
 HNMDARecord::setName( std::string value )
 {
+    if( m_name != value )
+        m_modified = true;
+
     m_name = value;
 }
 
-void 
+bool 
 HNMDARecord::addAddressInfo( std::string dnsName, std::string address, uint16_t port )
 {
     for( std::vector< HNMDARAddress >::iterator it = m_addrList.begin(); it != m_addrList.end(); it++ )
@@ -601,14 +910,122 @@ HNMDARecord::addAddressInfo( std::string dnsName, std::string address, uint16_t
         // Check if we are updating and address we already know about.
         if( it->getAddress() == address )
         {
+            // Nothing to do if the info is the same
+            if( (it->getDNSName() == dnsName) && (it->getPort() == port) )
+                return false;
+
             it->setAddressInfo( dnsName, address, port );
-            return;
+            m_modified = true;
+            return true;
         }
     }
 
     HNMDARAddress newAddr;
     newAddr.setAddressInfo( dnsName, address, port );
     m_addrList.push_back( newAddr );
+
+    // Give the new address a chance to compete
+    m_preferredAddrIdx = -1;
+
+    m_modified = true;
+    return true;
+}
+
+void
+HNMDARecord::clearAddressList()
+{
+    if( m_addrList.empty() == true )
+        return;
+
+    m_addrList.clear();
+    m_preferredAddrIdx = -1;
+    m_modified = true;
+}
+
+bool
+HNMDARecord::checkAndClearModified()
+{
+    bool rtnVal = m_modified;
+
+    if( m_modified == true )
+        m_revision = s_nextRecordRevision++;
+
+    m_modified = false;
+    return rtnVal;
+}
+
+uint64_t
+HNMDARecord::getRevision()
+{
+    return m_revision;
+}
+
+bool
+HNMDARecord::isHealthCycleStep( HNMDR_MGMT_STATE_T fromState, HNMDR_MGMT_STATE_T toState )
+{
+    return ( ((fromState == HNMDR_MGMT_STATE_UPDATE_HEALTH) || (fromState == HNMDR_MGMT_STATE_UPDATE_STRREF))
+          && ((toState == HNMDR_MGMT_STATE_UPDATE_HEALTH) || (toState == HNMDR_MGMT_STATE_UPDATE_STRREF)) );
+}
+
+HNMDARPollState&
+HNMDARecord::getPollStateRef( HNMDAR_POLL_EP_T endpoint )
+{
+    return m_pollState[ endpoint ];
+}
+
+void
+HNMDARecord::clearPollStates()
+{
+    for( uint i = 0; i < HNMDAR_POLL_EP_COUNT; i++ )
+        m_pollState[ i ].clear();
+}
+
+void
+HNMDARecord::setLastHealthPush( time_t value )
+{
+    m_lastHealthPush = value;
+}
+
+time_t
+HNMDARecord::getLastHealthPush()
+{
+    return m_lastHealthPush;
+}
+
+void
+HNMDARecord::setLastHealthPoll( time_t value )
+{
+    m_lastHealthPoll = value;
+}
+
+time_t
+HNMDARecord::getLastHealthPoll()
+{
+    return m_lastHealthPoll;
+}
+
+void
+HNMDARecord::setHealthPollInterval( uint value )
+{
+    m_healthPollInterval = value;
+}
+
+uint
+HNMDARecord::getHealthPollInterval()
+{
+    return m_healthPollInterval;
+}
+
+void
+HNMDARecord::setDisappearTime( time_t value )
+{
+    m_disappearTime = value;
+}
+
+time_t
+HNMDARecord::getDisappearTime()
+{
+    return m_disappearTime;
 }
 
 void
@@ -634,6 +1051,12 @@ HNMDARecord::getAddressList( std::vector< HNMDARAddress > &addrList )
     }
 }
 
+std::vector< HNMDARAddress >&
+HNMDARecord::getAddressListRef()
+{
+    return m_addrList;
+}
+
 std::string 
 HNMDARecord::getDiscoveryID()
 {
@@ -643,11 +1066,23 @@ HNMDARecord::getDiscoveryID()
 std::string 
 HNMDARecord::getDeviceType()
 {
-    return m_devType;
+    return HNMDSymbolTable::str( m_devType );
 }
 
 std::string 
 HNMDARecord::getDeviceVersion()
+{
+    return HNMDSymbolTable::str( m_devVersion );
+}
+
+HNMDSymbol
+HNMDARecord::getDeviceTypeSymbol()
+{
+    return m_devType;
+}
+
+HNMDSymbol
+HNMDARecord::getDeviceVersionSymbol()
 {
     return m_devVersion;
 }
@@ -684,27 +1119,76 @@ HNMDARecord::getCRC32IDStr()
     return m_hnodeID.getCRC32AsHexStr();
 }
 
-HNMDL_RESULT_T 
-HNMDARecord::findPreferredConnection( HMDAR_ADDRTYPE_T preferredType, HNMDARAddress &connInfo )
+void
+HNMDARecord::selectPreferredAddress( time_t now )
 {
-    for( std::vector< HNMDARAddress >::iterator it = m_addrList.begin(); it != m_addrList.end(); it++ )
+    uint bestScore = UINT_MAX;
+
+    m_preferredAddrIdx  = -1;
+    m_preferredAddrTime = now;
+
+    // Lowest score wins, ties go to the address announced first
+    for( uint i = 0; i < m_addrList.size(); i++ )
     {
-        if( it->getType() == preferredType )
-        {
-            connInfo.setAddressInfo( it->getDNSName(), it->getAddress(), it->getPort() );
+        uint score = m_addrList[i].getScore( now );
 
-            return HNMDL_RESULT_SUCCESS;
+        if( score < bestScore )
+        {
+            bestScore = score;
+            m_preferredAddrIdx = i;
         }
     }
-
-    return HNMDL_RESULT_FAILURE;
 }
 
 HNMDL_RESULT_T 
-HNMDARecord::updateRecord( HNMDARecord &newRecord )
-{   
+HNMDARecord::findPreferredConnection( HNMDARAddress &connInfo )
+{
+    time_t now = time(NULL);
 
-    std::cout << "updateRecord - discID: " << newRecord.getDiscoveryID() << std::endl;
+    if( (m_preferredAddrIdx < 0) || ((now - m_preferredAddrTime) >= HNMDAR_ADDR_RESCORE_SECS) )
+        selectPreferredAddress( now );
+
+    if( m_preferredAddrIdx < 0 )
+        return HNMDL_RESULT_FAILURE;
+
+    // A copy, so the caller can use it without the record lock
+    connInfo = m_addrList[ m_preferredAddrIdx ];
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+void
+HNMDARecord::recordConnectionResult( const std::string &address, bool success, uint rttMS )
+{
+    time_t now = time(NULL);
+
+    for( uint i = 0; i < m_addrList.size(); i++ )
+    {
+        if( m_addrList[i].getAddress() != address )
+            continue;
+
+        if( success == true )
+        {
+            m_addrList[i].recordSuccess( rttMS );
+        }
+        else
+        {
+            m_addrList[i].recordFailure( now );
+
+            // Move off a failing address straight away
+            if( (int) i == m_preferredAddrIdx )
+                selectPreferredAddress( now );
+        }
+
+        return;
+    }
+}
+
+HNMDL_RESULT_T 
+HNMDARecord::updateRecord( HNMDARecord &newRecord )
+{   
+
+    std::cout << "updateRecord - discID: " << newRecord.getDiscoveryID() << std::endl;
 
     setDiscoveryID( newRecord.getDiscoveryID() );
     setDeviceType( newRecord.getDeviceType() );
@@ -712,8 +1196,7 @@ HNMDARecord::updateRecord( HNMDARecord &newRecord )
     setHNodeIDFromStr( newRecord.getHNodeIDStr() );
     setName( newRecord.getName() );
  
-    std::vector< HNMDARAddress > newAddrList;
-    newRecord.getAddressList( newAddrList );
+    std::vector< HNMDARAddress > &newAddrList = newRecord.getAddressListRef();
     for( std::vector< HNMDARAddress >::iterator it = newAddrList.begin(); it != newAddrList.end(); it++ )
     {
         addAddressInfo( it->getDNSName(), it->getAddress(), it->getPort() );
@@ -740,7 +1223,7 @@ HNMDARecord::startSrvProviderUpdates()
     std::cout << "startSrvProviderUpdates: " << m_srvMapProvided.size() << std::endl;
 
     // Go through each service provider and mark as not visited
-    std::map< std::string, HNMDServiceEndpoint >::iterator it;
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it;
     for( it = m_srvMapProvided.begin(); it != m_srvMapProvided.end(); it++ )
     {
         it->second.setVisited( false );
@@ -754,8 +1237,11 @@ HNMDARecord::updateSrvProvider( std::string srvType, bool &added )
 
     added = false;
 
+    // Service types are interned, so lookups are by pointer.
+    HNMDSymbol srvSymbol = HNMDSymbolTable::intern( srvType );
+
     // Check if the record already exists.
-    std::map< std::string, HNMDServiceEndpoint>::iterator it = m_srvMapProvided.find( srvType );
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it = m_srvMapProvided.find( srvSymbol );
 
     // If it does exist, return the existing record
     if( it != m_srvMapProvided.end() )
@@ -770,6 +1256,7 @@ HNMDARecord::updateSrvProvider( std::string srvType, bool &added )
     }
 
     added = true;
+    m_modified = true;
 
     // The record didn't exist before so create a new one.
     HNMDServiceEndpoint tmpEP;
@@ -777,8 +1264,8 @@ HNMDARecord::updateSrvProvider( std::string srvType, bool &added )
     tmpEP.setType( srvType );
     tmpEP.setVisited(true);
 
-    std::pair< std::map<std::string, HNMDServiceEndpoint>::iterator, bool > rstPair = 
-        m_srvMapProvided.insert( std::pair< std::string, HNMDServiceEndpoint >( srvType, tmpEP ) );
+    std::pair< std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator, bool > rstPair = 
+        m_srvMapProvided.insert( std::pair< HNMDSymbol, HNMDServiceEndpoint >( srvSymbol, tmpEP ) );
 
     return rstPair.first->second;
 }
@@ -790,22 +1277,24 @@ HNMDARecord::abandonSrvProviderUpdates()
 }
 
 bool
-HNMDARecord::completeSrvProviderUpdates()
+HNMDARecord::completeSrvProviderUpdates( std::vector< HNMDSymbol > &removedList )
 {
     bool changed = false;
 
     std::cout << "completeSrvProviderUpdates: " << m_srvMapProvided.size() << std::endl;
 
     // Go through each service provider, if it wasn't visited then get rid of it.
-    std::map< std::string, HNMDServiceEndpoint >::iterator it;
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it;
     for( it = m_srvMapProvided.begin(); it != m_srvMapProvided.end(); )
     {
-        std::cout << "completeSrvProviderUpdates - type: " << it->first << "  visited: " << it->second.getVisited() << std::endl;
+        std::cout << "completeSrvProviderUpdates - type: " << *(it->first) << "  visited: " << it->second.getVisited() << std::endl;
 
         if( it->second.getVisited() == false )
         {
             std::cout << "completeSrvProviderUpdates - erasing" << std::endl;
             changed = true;
+            m_modified = true;
+            removedList.push_back( it->first );
             m_srvMapProvided.erase( it++ );
         }
         else
@@ -822,18 +1311,28 @@ HNMDARecord::getSrvProviderTSList( std::vector< std::string > &srvTypesList )
 
     std::cout << "getSrvProviderTSList - size: " << m_srvMapProvided.size() << std::endl;
     
-    std::map< std::string, HNMDServiceEndpoint >::iterator it;
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it;
     for( it = m_srvMapProvided.begin(); it != m_srvMapProvided.end(); it++ )
         srvTypesList.push_back( it->second.getType() );
 }
 
+void
+HNMDARecord::getSrvProviderSymbolList( std::vector< HNMDSymbol > &srvSymbolList )
+{
+    srvSymbolList.clear();
+
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it;
+    for( it = m_srvMapProvided.begin(); it != m_srvMapProvided.end(); it++ )
+        srvSymbolList.push_back( it->first );
+}
+
 void
 HNMDARecord::startSrvMappingUpdates()
 {
     std::cout << "startSrvMappingUpdates: " << m_srvMapDesired.size() << std::endl;
 
     // Go through each service mapping and mark as not visited
-    std::map< std::string, HNMDServiceEndpoint >::iterator it;
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it;
     for( it = m_srvMapDesired.begin(); it != m_srvMapDesired.end(); it++ )
     {
         it->second.setVisited( false );
@@ -847,8 +1346,11 @@ HNMDARecord::updateSrvMapping( std::string srvType, bool &added )
 
     added = false;
 
+    // Service types are interned, so lookups are by pointer.
+    HNMDSymbol srvSymbol = HNMDSymbolTable::intern( srvType );
+
     // Check if the record already exists.
-    std::map< std::string, HNMDServiceEndpoint>::iterator it = m_srvMapDesired.find( srvType );
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it = m_srvMapDesired.find( srvSymbol );
 
     // If it does exist, return the existing record
     if( it != m_srvMapDesired.end() )
@@ -863,6 +1365,7 @@ HNMDARecord::updateSrvMapping( std::string srvType, bool &added )
     }
 
     added = true;
+    m_modified = true;
 
     // The record didn't exist before so create a new one.
     HNMDServiceEndpoint tmpEP;
@@ -870,8 +1373,8 @@ HNMDARecord::updateSrvMapping( std::string srvType, bool &added )
     tmpEP.setType( srvType );
     tmpEP.setVisited(true);
 
-    std::pair< std::map<std::string, HNMDServiceEndpoint>::iterator, bool > rstPair = 
-        m_srvMapDesired.insert( std::pair< std::string, HNMDServiceEndpoint >( srvType, tmpEP ) );
+    std::pair< std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator, bool > rstPair = 
+        m_srvMapDesired.insert( std::pair< HNMDSymbol, HNMDServiceEndpoint >( srvSymbol, tmpEP ) );
 
     return rstPair.first->second;
 }
@@ -883,21 +1386,23 @@ HNMDARecord::abandonSrvMappingUpdates()
 }
 
 bool
-HNMDARecord::completeSrvMappingUpdates()
+HNMDARecord::completeSrvMappingUpdates( std::vector< HNMDSymbol > &removedList )
 {
     bool changed = false;
 
     std::cout << "completeSrvMappingUpdates: " << m_srvMapDesired.size() << std::endl;
 
     // Go through each service mapping, if it wasn't visited then get rid of it.
-    std::map< std::string, HNMDServiceEndpoint >::iterator it;
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it;
     for( it = m_srvMapDesired.begin(); it != m_srvMapDesired.end(); )
     {
-        std::cout << "completeSrvMappingUpdates - type: " << it->first << "  visited: " << it->second.getVisited() << std::endl;
+        std::cout << "completeSrvMappingUpdates - type: " << *(it->first) << "  visited: " << it->second.getVisited() << std::endl;
 
         if( it->second.getVisited() == false )
         {
             changed = true;
+            m_modified = true;
+            removedList.push_back( it->first );
             m_srvMapDesired.erase( it++ );
         }
         else
@@ -914,7 +1419,7 @@ HNMDARecord::getSrvMappingTSList( std::vector< std::string > &srvTypesList )
 
     std::cout << "getSrvMappingTSList - size: " << m_srvMapDesired.size() << std::endl;
     
-    std::map< std::string, HNMDServiceEndpoint >::iterator it;
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it;
     for( it = m_srvMapDesired.begin(); it != m_srvMapDesired.end(); it++ )
         srvTypesList.push_back( it->second.getType() );
 }
@@ -926,12 +1431,17 @@ HNMDARecord::getServiceProviderURI( std::string srvType )
 
     std::cout << "getServiceProviderURI - lookup: " << srvType << "  list-size: " << m_srvMapProvided.size() << std::endl;
     
-    for( std::map< std::string, HNMDServiceEndpoint >::iterator dit = m_srvMapProvided.begin(); dit != m_srvMapProvided.end(); dit++ )
+    for( std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator dit = m_srvMapProvided.begin(); dit != m_srvMapProvided.end(); dit++ )
     {
         std::cout << "srvProviderDebug - type: " << dit->second.getType() << "   uri: " << dit->second.getRootURIAsStr() << std::endl;
     }
 
-    std::map< std::string, HNMDServiceEndpoint >::iterator it = m_srvMapProvided.find( srvType );
+    // A type that was never interned can't be in the map
+    HNMDSymbol srvSymbol = HNMDSymbolTable::lookup( srvType );
+    if( srvSymbol == NULL )
+        return rtnStr;
+
+    std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator it = m_srvMapProvided.find( srvSymbol );
 
     if( it == m_srvMapProvided.end() )
         return rtnStr;
@@ -1224,13 +1734,57 @@ HNMDARecord::debugPrint( uint offset )
         it->debugPrint(offset);
     }
 
-    for( std::map< std::string, HNMDServiceEndpoint >::iterator pit = m_srvMapProvided.begin(); pit != m_srvMapProvided.end(); pit++ )
+    for( std::unordered_map< HNMDSymbol, HNMDServiceEndpoint >::iterator pit = m_srvMapProvided.begin(); pit != m_srvMapProvided.end(); pit++ )
     {
         pit->second.debugPrint(offset);
     }
 
 }
 
+HNMDInventorySnapshot::HNMDInventorySnapshot( uint64_t version, uint deviceCnt )
+{
+    m_version = version;
+
+    // Size the list up front so building the
+    // snapshot doesn't re-copy records.
+    m_deviceList.reserve( deviceCnt );
+}
+
+HNMDInventorySnapshot::~HNMDInventorySnapshot()
+{
+
+}
+
+uint64_t
+HNMDInventorySnapshot::getVersion()
+{
+    return m_version;
+}
+
+void
+HNMDInventorySnapshot::addDevice( HNMDARecordPtr device )
+{
+    m_crc32Index.insert( std::pair< uint32_t, uint >( device->getCRC32ID(), m_deviceList.size() ) );
+    m_deviceList.push_back( device );
+}
+
+std::vector< HNMDARecordPtr >&
+HNMDInventorySnapshot::getDeviceListRef()
+{
+    return m_deviceList;
+}
+
+HNMDARecord*
+HNMDInventorySnapshot::findDevice( uint32_t crc32ID )
+{
+    std::unordered_map< uint32_t, uint >::iterator it = m_crc32Index.find( crc32ID );
+
+    if( it == m_crc32Index.end() )
+        return NULL;
+
+    return m_deviceList[ it->second ].get();
+}
+
 HNMDSrvRef::HNMDSrvRef()
 {
 
@@ -1402,442 +1956,1969 @@ HNMDServiceAssoc::getDesirerCRC32ID()
     return m_desirerCRC32ID;
 }
 
-HNManagedDeviceArbiter::HNManagedDeviceArbiter()
+HNMDRollupCounts::HNMDRollupCounts()
 {
-    runMonitor = false;
-    thelp = NULL;
+    for( uint i = 0; i < HNMDHH_STATUS_COUNT; i++ )
+        m_counts[i] = 0;
+}
 
-    m_mgmtDevice = NULL;
+HNMDRollupCounts::~HNMDRollupCounts()
+{
 
-    m_healthCache.setFormatStringCache( &m_formatStrCache );
 }
 
-HNManagedDeviceArbiter::~HNManagedDeviceArbiter()
+void
+HNMDRollupCounts::add( HNMDHH_STATUS_T status )
 {
+    m_counts[ status ] += 1;
+}
 
+void
+HNMDRollupCounts::remove( HNMDHH_STATUS_T status )
+{
+    if( m_counts[ status ] > 0 )
+        m_counts[ status ] -= 1;
 }
 
-void 
-HNManagedDeviceArbiter::setSelfInfo( HNodeDevice *mgmtDevice )
+uint
+HNMDRollupCounts::getCount( HNMDHH_STATUS_T status )
 {
-    m_mgmtDevice = mgmtDevice;
+    return m_counts[ status ];
+}
+
+uint
+HNMDRollupCounts::getTotal()
+{
+    uint total = 0;
+
+    for( uint i = 0; i < HNMDHH_STATUS_COUNT; i++ )
+        total += m_counts[i];
+
+    return total;
 }
 
 void
-HNManagedDeviceArbiter::addMgmtDeviceProvidedSrv( HNMDARecord &record, std::string srvType, std::string version, std::string pathExt )
+HNMDRollupCounts::writeAsJSON( std::ostream &os )
 {
-    bool added = false;            
-    Poco::URI uri;
-    uri.setScheme( "http" );
-    uri.setHost( m_mgmtDevice->getRestAddress() );
-    uri.setPort( m_mgmtDevice->getRestPort() );
-    std::string path = m_mgmtDevice->getRestRootPath();
-    path = path + "/" + pathExt;
-    uri.setPath( path );
+    os << "{\"total\":" << getTotal();
 
-    HNMDServiceEndpoint &srvRef = record.updateSrvProvider( srvType, added );
+    for( uint i = 0; i < HNMDHH_STATUS_COUNT; i++ )
+        os << ",\"" << HNMDHealthHistory::statusToStr( (HNMDHH_STATUS_T) i ) << "\":" << m_counts[i];
+
+    os << "}";
+}
+
+HNMDRollupMember::HNMDRollupMember()
+{
+    // Counted as unknown until a health report arrives
+    m_status  = HNMDHH_STATUS_UNKNOWN;
+    m_devType = NULL;
+}
+
+HNMDRollupMember::~HNMDRollupMember()
+{
+
+}
+
+HNMDHealthRollup::HNMDHealthRollup()
+{
+    m_generation = 1;
+}
+
+HNMDHealthRollup::~HNMDHealthRollup()
+{
 
-    srvRef.setType( srvType );        
-    srvRef.setVersion( version );
-    srvRef.setRootURIFromStr( uri.toString() );
 }
 
 void
-HNManagedDeviceArbiter::initMgmtDevice( HNMDARecord &record )
+HNMDHealthRollup::setDeviceType( uint32_t crc32ID, HNMDSymbol devType )
 {
-    // The health and logging sinks are both built into the management
-    // node itself.
-    record.startSrvProviderUpdates();
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_rollupMutex );
 
-    // Get a record object reference for this service type.
-    addMgmtDeviceProvidedSrv( record, "hnsrv-health-sink", "1.0.0", "mgmt/health-sink" );
+    std::unordered_map< uint32_t, HNMDRollupMember >::iterator it = m_memberMap.find( crc32ID );
 
-    addMgmtDeviceProvidedSrv( record, "hnsrv-log-sink", "1.0.0", "mgmt/log-sink" );
+    if( it == m_memberMap.end() )
+    {
+        it = m_memberMap.insert( std::pair< uint32_t, HNMDRollupMember >( crc32ID, HNMDRollupMember() ) ).first;
+        m_total.add( it->second.m_status );
+    }
+    else if( it->second.m_devType == devType )
+        return;
+    else if( it->second.m_devType != NULL )
+        m_typeCounts[ it->second.m_devType ].remove( it->second.m_status );
 
-    // Done with updates to services provided list
-    record.completeSrvProviderUpdates();
+    it->second.m_devType = devType;
+
+    if( devType != NULL )
+        m_typeCounts[ devType ].add( it->second.m_status );
 
+    m_generation += 1;
 }
 
-HNMDL_RESULT_T 
-HNManagedDeviceArbiter::notifyDiscoverAdd( HNMDARecord &record )
+void
+HNMDHealthRollup::setDeviceStatus( uint32_t crc32ID, HNMDHH_STATUS_T status )
 {
     // Scope lock
-    std::lock_guard<std::mutex> guard( m_mapMutex );
+    std::lock_guard<std::mutex> guard( m_rollupMutex );
 
-    // Check if the record is existing, or if this is a new discovery.
-    std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.find( record.getCRC32IDStr() );
+    std::unordered_map< uint32_t, HNMDRollupMember >::iterator it = m_memberMap.find( crc32ID );
 
-    if( it == m_deviceMap.end() )
+    if( it == m_memberMap.end() )
     {
-        // This is a new record
-        if( record.getCRC32IDStr() == getSelfCRC32IDStr() )
-        {
-            std::cout << "Management Node Device adding inbuilt services - crc32id: " << record.getCRC32IDStr() << std::endl;
+        it = m_memberMap.insert( std::pair< uint32_t, HNMDRollupMember >( crc32ID, HNMDRollupMember() ) ).first;
+        m_total.add( it->second.m_status );
+    }
 
-            initMgmtDevice( record );
+    HNMDRollupMember &member = it->second;
 
-            record.setManagementState( HNMDR_MGMT_STATE_SELF );
-         }
-        else
-            record.setManagementState( HNMDR_MGMT_STATE_DISCOVERED );
+    if( member.m_status == status )
+        return;
 
-        m_deviceMap.insert( std::pair< std::string, HNMDARecord >( record.getCRC32IDStr(), record ) );
+    // Move the device between status counts in each of its groups
+    m_total.remove( member.m_status );
+    m_total.add( status );
 
-        std::cout << "================================" << std::endl;
-        std::map< std::string, HNMDARecord >::iterator dit;
-        for( dit = m_deviceMap.begin(); dit != m_deviceMap.end(); dit++ )
-        {
-            dit->second.debugPrint( 2 );
-        }
-        std::cout << "================================" << std::endl;
+    if( member.m_devType != NULL )
+    {
+        HNMDRollupCounts &typeCounts = m_typeCounts[ member.m_devType ];
+        typeCounts.remove( member.m_status );
+        typeCounts.add( status );
     }
-    else
+
+    for( std::unordered_set< HNMDSymbol >::iterator sit = member.m_services.begin(); sit != member.m_services.end(); sit++ )
     {
-        // Update the existing record with most recent information
-        it->second.updateRecord( record );
+        HNMDRollupCounts &srvCounts = m_serviceCounts[ *sit ];
+        srvCounts.remove( member.m_status );
+        srvCounts.add( status );
     }
 
-    return HNMDL_RESULT_SUCCESS;
+    member.m_status = status;
+
+    m_generation += 1;
 }
 
-HNMDL_RESULT_T 
-HNManagedDeviceArbiter::notifyDiscoverRemove( HNMDARecord &record )
+void
+HNMDHealthRollup::updateDeviceServices( uint32_t crc32ID, std::vector< HNMDSymbol > &addedList, std::vector< HNMDSymbol > &removedList )
 {
     // Scope lock
-    std::lock_guard<std::mutex> guard( m_mapMutex );
+    std::lock_guard<std::mutex> guard( m_rollupMutex );
 
-    // Check if the record is existing, or if this is a new discovery.
-    std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.find( record.getCRC32IDStr() );
+    std::unordered_map< uint32_t, HNMDRollupMember >::iterator it = m_memberMap.find( crc32ID );
 
-    if( it != m_deviceMap.end() )
+    if( it == m_memberMap.end() )
     {
-        // This is a new record
-        it->second.setManagementState( HNMDR_MGMT_STATE_DISAPPEARING );
+        it = m_memberMap.insert( std::pair< uint32_t, HNMDRollupMember >( crc32ID, HNMDRollupMember() ) ).first;
+        m_total.add( it->second.m_status );
     }
 
-    return HNMDL_RESULT_SUCCESS;
-}
+    HNMDRollupMember &member = it->second;
 
-std::string 
-HNManagedDeviceArbiter::getSelfHNodeIDStr()
-{
-    std::string rtnStr;
+    for( std::vector< HNMDSymbol >::iterator sit = addedList.begin(); sit != addedList.end(); sit++ )
+    {
+        if( member.m_services.insert( *sit ).second == true )
+            m_serviceCounts[ *sit ].add( member.m_status );
+    }
 
-    if( m_mgmtDevice != NULL )
-        rtnStr = m_mgmtDevice->getHNodeIDStr();
+    for( std::vector< HNMDSymbol >::iterator sit = removedList.begin(); sit != removedList.end(); sit++ )
+    {
+        if( member.m_services.erase( *sit ) == 0 )
+            continue;
 
-    return rtnStr;
-}
+        std::unordered_map< HNMDSymbol, HNMDRollupCounts >::iterator cit = m_serviceCounts.find( *sit );
+        if( cit == m_serviceCounts.end() )
+            continue;
 
-std::string 
-HNManagedDeviceArbiter::getSelfCRC32IDStr()
-{
-    std::string rtnStr;
+        cit->second.remove( member.m_status );
 
-    if( m_mgmtDevice != NULL )
-        rtnStr = m_mgmtDevice->getHNodeIDCRC32Str();
+        if( cit->second.getTotal() == 0 )
+            m_serviceCounts.erase( cit );
+    }
 
-    return rtnStr;
+    m_generation += 1;
 }
 
-uint32_t
-HNManagedDeviceArbiter::getSelfCRC32ID()
+void
+HNMDHealthRollup::removeDevice( uint32_t crc32ID )
 {
-    uint rtnVal = 0;
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_rollupMutex );
 
-    if( m_mgmtDevice != NULL )
-        rtnVal = m_mgmtDevice->getHNodeIDCRC32();
+    std::unordered_map< uint32_t, HNMDRollupMember >::iterator it = m_memberMap.find( crc32ID );
 
-    return rtnVal;
-}
+    if( it == m_memberMap.end() )
+        return;
 
-HNMDL_RESULT_T
-HNManagedDeviceArbiter::getDeviceCopy( std::string crc32ID, HNMDARecord &device )
-{
-    // Scope lock
-    std::lock_guard<std::mutex> guard( m_mapMutex );
+    HNMDRollupMember &member = it->second;
 
-    std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
+    m_total.remove( member.m_status );
 
-    if( it == m_deviceMap.end() )
-        return HNMDL_RESULT_FAILURE;
+    if( member.m_devType != NULL )
+        m_typeCounts[ member.m_devType ].remove( member.m_status );
 
-    device = it->second;
+    for( std::unordered_set< HNMDSymbol >::iterator sit = member.m_services.begin(); sit != member.m_services.end(); sit++ )
+        m_serviceCounts[ *sit ].remove( member.m_status );
 
-    return HNMDL_RESULT_SUCCESS;
+    m_memberMap.erase( it );
+
+    m_generation += 1;
 }
 
 void
-HNManagedDeviceArbiter::getDeviceListCopy( std::vector< HNMDARecord > &deviceList )
+HNMDHealthRollup::writeSummaryAsJSON( std::ostream &os, uint64_t &generation )
 {
     // Scope lock
-    std::lock_guard<std::mutex> guard( m_mapMutex );
+    std::lock_guard<std::mutex> guard( m_rollupMutex );
+
+    generation = m_generation;
+
+    os << "{\"generation\":" << m_generation << ",\"devices\":";
+    m_total.writeAsJSON( os );
 
-    for( std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
-    {    
-        deviceList.push_back( it->second );
+    os << ",\"deviceTypes\":{";
+    bool first = true;
+    for( std::unordered_map< HNMDSymbol, HNMDRollupCounts >::iterator it = m_typeCounts.begin(); it != m_typeCounts.end(); it++ )
+    {
+        if( it->second.getTotal() == 0 )
+            continue;
+
+        if( first == false )
+            os << ",";
+        first = false;
+
+        HNMDJsonWriter::writeEscaped( os, HNMDSymbolTable::str( it->first ) );
+        os << ":";
+        it->second.writeAsJSON( os );
     }
-}
 
-HNMDL_RESULT_T 
-HNManagedDeviceArbiter::lookupConnectionInfo( std::string crc32ID, HMDAR_ADDRTYPE_T preferredType, HNMDARAddress &connInfo )
-{
-    // Scope lock
-    std::lock_guard<std::mutex> guard( m_mapMutex );
+    os << "},\"services\":{";
+    first = true;
+    for( std::unordered_map< HNMDSymbol, HNMDRollupCounts >::iterator it = m_serviceCounts.begin(); it != m_serviceCounts.end(); it++ )
+    {
+        if( it->second.getTotal() == 0 )
+            continue;
 
-    // See if we have a record for the device
-    std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
+        if( first == false )
+            os << ",";
+        first = false;
 
-    if( it == m_deviceMap.end() )
-        return HNMDL_RESULT_FAILURE;
+        HNMDJsonWriter::writeEscaped( os, HNMDSymbolTable::str( it->first ) );
+        os << ":";
+        it->second.writeAsJSON( os );
+    }
 
-    return it->second.findPreferredConnection( preferredType, connInfo );
+    os << "}}";
 }
 
-void 
-HNManagedDeviceArbiter::debugPrint()
+HNMDTokenBucket::HNMDTokenBucket()
 {
-    printf( "=== Managed Device Arbiter ===\n" );
+    m_rate     = 0;
+    m_capacity = 0;
+    m_tokens   = 0;
 
-    for( std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
-    {
-        it->second.debugPrint( 2 );
-    }
+    clock_gettime( CLOCK_MONOTONIC, &m_lastRefill );
 }
 
+HNMDTokenBucket::~HNMDTokenBucket()
+{
 
+}
 
 void
-HNManagedDeviceArbiter::start()
+HNMDTokenBucket::setRate( uint perSecond, uint burst )
 {
-    int error;
+    m_rate     = perSecond;
+    m_capacity = burst;
+    m_tokens   = burst;
 
-    std::cout << "HNManagedDeviceArbiter::start()" << std::endl;
+    clock_gettime( CLOCK_MONOTONIC, &m_lastRefill );
+}
 
-    // Allocate the thread helper
-    thelp = new HNMDARunner( this );
-    if( !thelp )
-    {
-        //cleanup();
-        return;
-    }
+bool
+HNMDTokenBucket::tryTake()
+{
+    struct timespec now;
 
-    runMonitor = true;
+    // No limit configured
+    if( m_rate == 0 )
+        return true;
 
-    // Start up the event loop
-    ( (HNMDARunner*) thelp )->startThread();
-}
+    clock_gettime( CLOCK_MONOTONIC, &now );
 
-void
-HNManagedDeviceArbiter::setNextMonitorState( HNMDARecord &device, HNMDR_MGMT_STATE_T nextState, uint minValue )
-{
-    device.lockForUpdate();
+    double elapsed = (now.tv_sec - m_lastRefill.tv_sec) + ((now.tv_nsec - m_lastRefill.tv_nsec) / 1e9);
+    m_lastRefill = now;
 
-    device.setManagementState( nextState );
+    m_tokens += elapsed * m_rate;
+    if( m_tokens > m_capacity )
+        m_tokens = m_capacity;
 
-    if( minValue < m_monitorWaitTime )
-        m_monitorWaitTime = minValue;
+    if( m_tokens < 1.0 )
+        return false;
 
-    device.unlockForUpdate();
+    m_tokens -= 1.0;
+    return true;
 }
 
-void 
-HNManagedDeviceArbiter::runMonitoringLoop()
+HNMDFirmwareStrings::HNMDFirmwareStrings()
 {
-    std::cout << "HNManagedDeviceArbiter::runMonitoringLoop()" << std::endl;
 
-    // FIXME -- Temporarily setup some default mappings
-    HNMDSrvRef tmpRef;
+}
 
-    tmpRef.setSrvType( "hnsrv-health-sink" );
+HNMDFirmwareStrings::~HNMDFirmwareStrings()
+{
+
+}
+
+bool
+HNMDFirmwareStrings::addDefinitions( std::vector< std::string > &fmtCodeList, const std::string &body )
+{
+    uint index = m_bodyList.size();
+    bool added = false;
+
+    for( std::vector< std::string >::iterator it = fmtCodeList.begin(); it != fmtCodeList.end(); it++ )
+    {
+        if( m_codeMap.find( *it ) != m_codeMap.end() )
+            continue;
+
+        m_codeMap[ *it ] = index;
+        added = true;
+    }
+
+    if( added == true )
+        m_bodyList.push_back( body );
+
+    return added;
+}
+
+void
+HNMDFirmwareStrings::planFetch( std::vector< std::string > &fmtCodeList, std::vector< std::string > &replayList, std::vector< std::string > &missingList )
+{
+    std::set< uint > bodySet;
+
+    for( std::vector< std::string >::iterator it = fmtCodeList.begin(); it != fmtCodeList.end(); it++ )
+    {
+        std::unordered_map< std::string, uint >::iterator cit = m_codeMap.find( *it );
+
+        if( cit == m_codeMap.end() )
+            missingList.push_back( *it );
+        else
+            bodySet.insert( cit->second );
+    }
+
+    for( std::set< uint >::iterator bit = bodySet.begin(); bit != bodySet.end(); bit++ )
+        replayList.push_back( m_bodyList[ *bit ] );
+}
+
+uint
+HNMDFirmwareStrings::getBodyCount()
+{
+    return m_bodyList.size();
+}
+
+const std::string&
+HNMDFirmwareStrings::getBody( uint index )
+{
+    return m_bodyList[ index ];
+}
+
+void
+HNMDFirmwareStrings::getBodyCodes( uint index, std::vector< std::string > &fmtCodeList )
+{
+    for( std::unordered_map< std::string, uint >::iterator it = m_codeMap.begin(); it != m_codeMap.end(); it++ )
+    {
+        if( it->second == index )
+            fmtCodeList.push_back( it->first );
+    }
+}
+
+// Appends fields to a cache file image.  Values are
+// written in host byte order, the file is not portable.
+class HNMDCacheWriter
+{
+    public:
+        void putU32( uint32_t value )
+        {
+            m_buf.append( (const char *) &value, sizeof(value) );
+        }
+
+        void putStr( const std::string &value )
+        {
+            putU32( value.size() );
+            m_buf.append( value );
+        }
+
+        const std::string& getBuffer()
+        {
+            return m_buf;
+        }
+
+    private:
+        std::string m_buf;
+};
+
+// Bounds checked walk over a mapped cache file image.
+class HNMDCacheReader
+{
+    public:
+        HNMDCacheReader( const char *start, size_t length )
+        {
+            m_ptr = start;
+            m_end = start + length;
+        }
+
+        bool getU32( uint32_t &value )
+        {
+            if( (size_t)(m_end - m_ptr) < sizeof(value) )
+                return false;
+
+            memcpy( &value, m_ptr, sizeof(value) );
+            m_ptr += sizeof(value);
+            return true;
+        }
+
+        bool getStr( std::string &value )
+        {
+            uint32_t length;
+
+            if( getU32( length ) == false )
+                return false;
+
+            if( (size_t)(m_end - m_ptr) < length )
+                return false;
+
+            value.assign( m_ptr, length );
+            m_ptr += length;
+            return true;
+        }
+
+    private:
+        const char *m_ptr;
+        const char *m_end;
+};
+
+HNMDChangeEvent::HNMDChangeEvent( HNMD_CHGEVT_TYPE_T type )
+{
+    m_type = type;
+
+    m_devCRC32ID = 0;
+    m_generation = 0;
+}
+
+HNMDChangeEvent::~HNMDChangeEvent()
+{
+
+}
+
+HNMD_CHGEVT_TYPE_T
+HNMDChangeEvent::getType()
+{
+    return m_type;
+}
+
+std::string
+HNMDChangeEvent::getTypeStr()
+{
+    switch( m_type )
+    {
+        case HNMD_CHGEVT_TYPE_DEVICE_ADDED:
+            return "device-added";
+        case HNMD_CHGEVT_TYPE_DEVICE_REMOVED:
+            return "device-removed";
+        case HNMD_CHGEVT_TYPE_MGMT_STATE:
+            return "mgmt-state";
+        case HNMD_CHGEVT_TYPE_OWNERSHIP:
+            return "ownership";
+        case HNMD_CHGEVT_TYPE_HEALTH:
+            return "health";
+        case HNMD_CHGEVT_TYPE_NOTSET:
+        default:
+        break;
+    }
+
+    return "unknown";
+}
+
+void
+HNMDChangeEvent::setDevCRC32ID( uint32_t value )
+{
+    m_devCRC32ID = value;
+}
+
+uint32_t
+HNMDChangeEvent::getDevCRC32ID()
+{
+    return m_devCRC32ID;
+}
+
+void
+HNMDChangeEvent::setGeneration( uint64_t value )
+{
+    m_generation = value;
+}
+
+uint64_t
+HNMDChangeEvent::getGeneration()
+{
+    return m_generation;
+}
+
+void
+HNMDChangeEvent::setDetail( std::string value )
+{
+    m_detail = value;
+}
+
+std::string
+HNMDChangeEvent::getDetail()
+{
+    return m_detail;
+}
+
+HNManagedDeviceArbiter::HNManagedDeviceArbiter()
+{
+    runMonitor = false;
+    thelp = NULL;
+
+    m_reactor = NULL;
+    m_monitorTimerFD = -1;
+    m_monitorWaitTime = 10;
+    m_monitorDue = false;
+
+    m_mgmtDevice = NULL;
+
+    m_inventoryVersion = 1;
+
+    m_healthGeneration = 1;
+    m_healthResetGeneration = 0;
+    m_healthEpoch = time(NULL);
+    m_healthReportGeneration = 0;
+
+    m_changeQueue = NULL;
+
+    m_cacheDirty = false;
+    m_cacheSaveTime = 0;
+    m_cacheLoadTime = 0;
+
+    m_monitorPassCnt = 0;
+
+    setHealthPollLimits( HNMD_HEALTH_POLL_DEF_MAX_SECS, HNMD_HEALTH_POLL_DEF_BUDGET );
+
+    m_healthCache.setFormatStringCache( &m_formatStrCache );
+}
+
+HNManagedDeviceArbiter::~HNManagedDeviceArbiter()
+{
+
+}
+
+void 
+HNManagedDeviceArbiter::setSelfInfo( HNodeDevice *mgmtDevice )
+{
+    m_mgmtDevice = mgmtDevice;
+}
+
+void
+HNManagedDeviceArbiter::setChangeNotifyQueue( HNSigSyncQueue *changeQueue )
+{
+    m_changeQueue = changeQueue;
+}
+
+void
+HNManagedDeviceArbiter::setCacheFilePath( std::string path )
+{
+    // Nothing else creates the cache directory, so make
+    // each missing component of it here.
+    size_t pos = 0;
+
+    while( (pos = path.find( '/', pos + 1 )) != std::string::npos )
+    {
+        std::string dir = path.substr( 0, pos );
+
+        if( (mkdir( dir.c_str(), 0755 ) < 0) && (errno != EEXIST) )
+        {
+            // Run without the cache rather than failing every save
+            syslog( LOG_ERR, "HNManagedDeviceArbiter - Cache disabled, could not create %s: %s", dir.c_str(), strerror(errno) );
+            m_cacheFilePath.clear();
+            return;
+        }
+    }
+
+    m_cacheFilePath = path;
+}
+
+void
+HNManagedDeviceArbiter::setHealthPollLimits( uint maxSecs, uint budgetPerSec )
+{
+    if( maxSecs < HNMD_HEALTH_POLL_MIN_SECS )
+        maxSecs = HNMD_HEALTH_POLL_MIN_SECS;
+
+    m_healthPollMaxSecs = maxSecs;
+
+    // Allow a monitor period's worth of budget to be used in one pass
+    m_healthPollBudget.setRate( budgetPerSec, budgetPerSec * HNMD_HEALTH_POLL_MIN_SECS );
+}
+
+// Cache file layout:
+//   u32 magic, u32 version
+//   u32 firmware count, per firmware:
+//     str deviceType, str deviceVersion, u32 response count, per response:
+//       str body, u32 code count, str fmtCode...
+//   u32 device count, per device:
+//     u32 crc32ID, str deviceType, str deviceVersion, str health body
+HNMDL_RESULT_T
+HNManagedDeviceArbiter::loadCacheFile()
+{
+    struct stat st;
+
+    if( m_cacheFilePath.empty() == true )
+        return HNMDL_RESULT_SUCCESS;
+
+    int fd = open( m_cacheFilePath.c_str(), O_RDONLY );
+    if( fd < 0 )
+    {
+        std::cout << "loadCacheFile - no cache file: " << m_cacheFilePath << std::endl;
+        return HNMDL_RESULT_SUCCESS;
+    }
+
+    if( (fstat( fd, &st ) < 0) || (st.st_size == 0) )
+    {
+        close( fd );
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    void *image = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+
+    if( image == MAP_FAILED )
+        return HNMDL_RESULT_FAILURE;
+
+    HNMDCacheReader rd( (const char *) image, st.st_size );
+
+    uint32_t magic   = 0;
+    uint32_t version = 0;
+    uint32_t fwCount = 0;
+    uint32_t devCount = 0;
+    bool     valid   = false;
+
+    std::map< HNMDFirmwareKey, HNMDFirmwareStrings > fwMap;
+    std::vector< std::pair< uint32_t, HNMDFirmwareKey > > devList;
+    std::vector< std::string > healthList;
+
+    if( rd.getU32( magic ) && rd.getU32( version ) && (magic == HNMD_CACHE_FILE_MAGIC) && (version == HNMD_CACHE_FILE_VERSION) && rd.getU32( fwCount ) )
+    {
+        valid = true;
+
+        for( uint32_t i = 0; (i < fwCount) && (valid == true); i++ )
+        {
+            std::string devType;
+            std::string devVersion;
+            uint32_t    bodyCount = 0;
+
+            if( !rd.getStr( devType ) || !rd.getStr( devVersion ) || !rd.getU32( bodyCount ) )
+            {
+                valid = false;
+                break;
+            }
+
+            HNMDFirmwareStrings &fwStrs = fwMap[ HNMDFirmwareKey( HNMDSymbolTable::intern( devType ), HNMDSymbolTable::intern( devVersion ) ) ];
+
+            for( uint32_t b = 0; b < bodyCount; b++ )
+            {
+                std::string body;
+                uint32_t    codeCount = 0;
+                std::vector< std::string > codeList;
+
+                if( !rd.getStr( body ) || !rd.getU32( codeCount ) )
+                {
+                    valid = false;
+                    break;
+                }
+
+                for( uint32_t c = 0; c < codeCount; c++ )
+                {
+                    std::string code;
+
+                    if( !rd.getStr( code ) )
+                    {
+                        valid = false;
+                        break;
+                    }
+
+                    codeList.push_back( code );
+                }
+
+                if( valid == false )
+                    break;
+
+                fwStrs.addDefinitions( codeList, body );
+            }
+        }
+
+        if( (valid == true) && rd.getU32( devCount ) )
+        {
+            for( uint32_t i = 0; i < devCount; i++ )
+            {
+                uint32_t    crc32ID = 0;
+                std::string devType;
+                std::string devVersion;
+                std::string body;
+
+                if( !rd.getU32( crc32ID ) || !rd.getStr( devType ) || !rd.getStr( devVersion ) || !rd.getStr( body ) )
+                {
+                    valid = false;
+                    break;
+                }
+
+                HNMDFirmwareKey fwKey( NULL, NULL );
+                if( (devType.empty() == false) && (devVersion.empty() == false) )
+                    fwKey = HNMDFirmwareKey( HNMDSymbolTable::intern( devType ), HNMDSymbolTable::intern( devVersion ) );
+
+                devList.push_back( std::pair< uint32_t, HNMDFirmwareKey >( crc32ID, fwKey ) );
+                healthList.push_back( body );
+            }
+        }
+        else
+            valid = false;
+    }
+
+    munmap( image, st.st_size );
+
+    if( valid == false )
+    {
+        std::cout << "loadCacheFile - ignoring unreadable cache file: " << m_cacheFilePath << std::endl;
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    // Scope lock
+    std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+    m_firmwareStrMap = fwMap;
+
+    // Everything replayed shares one generation, so clients
+    // see the loaded picture as a single change.
+    uint64_t generation = m_healthGeneration + 1;
+    uint     loadCnt = 0;
+
+    m_cacheLoadTime = time(NULL);
+
+    // Health first, so the string definitions
+    // have references to attach to.
+    for( uint i = 0; i < devList.size(); i++ )
+    {
+        bool     changed = false;
+        uint32_t crc32ID = devList[i].first;
+
+        if( replayDeviceHealthBody( crc32ID, healthList[i], generation ) == false )
+            continue;
+
+        loadCnt += 1;
+
+        if( devList[i].second.first == NULL )
+            continue;
+
+        m_deviceFirmware[ crc32ID ] = devList[i].second;
+
+        std::map< HNMDFirmwareKey, HNMDFirmwareStrings >::iterator fit = m_firmwareStrMap.find( devList[i].second );
+        if( fit == m_firmwareStrMap.end() )
+            continue;
+
+        std::string crc32Str = formatCRC32IDStr( crc32ID );
+
+        for( uint b = 0; b < fit->second.getBodyCount(); b++ )
+        {
+            try
+            {
+                std::istringstream rs( fit->second.getBody( b ) );
+                m_formatStrCache.updateStringDefinitions( crc32Str, rs, changed );
+            }
+            catch( Poco::Exception &ex )
+            {
+                std::cout << "loadCacheFile - string replay error: " << ex.displayText() << std::endl;
+            }
+        }
+    }
+
+    if( loadCnt != 0 )
+        m_healthGeneration = generation;
+
+    // Just loaded, nothing new to write
+    m_cacheDirty = false;
+    m_cacheSaveTime = time(NULL);
+
+    std::cout << "loadCacheFile - loaded firmware: " << m_firmwareStrMap.size() << "  devices: " << loadCnt << std::endl;
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+HNMDL_RESULT_T
+HNManagedDeviceArbiter::saveCacheFile()
+{
+    HNMDCacheWriter wr;
+
+    if( m_cacheFilePath.empty() == true )
+        return HNMDL_RESULT_SUCCESS;
+
+    // Build the image under the lock, write it out after.
+    {
+        std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+        wr.putU32( HNMD_CACHE_FILE_MAGIC );
+        wr.putU32( HNMD_CACHE_FILE_VERSION );
+
+        wr.putU32( m_firmwareStrMap.size() );
+        for( std::map< HNMDFirmwareKey, HNMDFirmwareStrings >::iterator fit = m_firmwareStrMap.begin(); fit != m_firmwareStrMap.end(); fit++ )
+        {
+            wr.putStr( HNMDSymbolTable::str( fit->first.first ) );
+            wr.putStr( HNMDSymbolTable::str( fit->first.second ) );
+
+            wr.putU32( fit->second.getBodyCount() );
+            for( uint b = 0; b < fit->second.getBodyCount(); b++ )
+            {
+                std::vector< std::string > codeList;
+                fit->second.getBodyCodes( b, codeList );
+
+                wr.putStr( fit->second.getBody( b ) );
+                wr.putU32( codeList.size() );
+                for( std::vector< std::string >::iterator cit = codeList.begin(); cit != codeList.end(); cit++ )
+                    wr.putStr( *cit );
+            }
+        }
+
+        wr.putU32( m_deviceHealthBody.size() );
+        for( std::unordered_map< uint32_t, std::string >::iterator dit = m_deviceHealthBody.begin(); dit != m_deviceHealthBody.end(); dit++ )
+        {
+            HNMDFirmwareKey fwKey( NULL, NULL );
+
+            std::unordered_map< uint32_t, HNMDFirmwareKey >::iterator kit = m_deviceFirmware.find( dit->first );
+            if( kit != m_deviceFirmware.end() )
+                fwKey = kit->second;
+
+            wr.putU32( dit->first );
+            wr.putStr( HNMDSymbolTable::str( fwKey.first ) );
+            wr.putStr( HNMDSymbolTable::str( fwKey.second ) );
+            wr.putStr( dit->second );
+        }
+
+        m_cacheDirty = false;
+        m_cacheSaveTime = time(NULL);
+    }
+
+    // Write to a temporary and rename so a crash
+    // never leaves a partial cache file behind.
+    std::string tmpPath = m_cacheFilePath + ".tmp";
+
+    int fd = open( tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 )
+    {
+        std::cout << "saveCacheFile - could not open: " << tmpPath << "  error: " << strerror(errno) << std::endl;
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    const std::string &image = wr.getBuffer();
+    size_t written = 0;
+
+    while( written < image.size() )
+    {
+        ssize_t result = write( fd, image.data() + written, image.size() - written );
+
+        if( result < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+
+            close( fd );
+            unlink( tmpPath.c_str() );
+            return HNMDL_RESULT_FAILURE;
+        }
+
+        written += result;
+    }
+
+    fsync( fd );
+    close( fd );
+
+    if( rename( tmpPath.c_str(), m_cacheFilePath.c_str() ) < 0 )
+    {
+        unlink( tmpPath.c_str() );
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+void
+HNManagedDeviceArbiter::checkCacheSave()
+{
+    bool due = false;
+
+    {
+        std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+        if( m_cacheDirty == true )
+        {
+            time_t age = time(NULL) - m_cacheSaveTime;
+
+            // Come back when the save is due
+            if( age >= HNMD_CACHE_SAVE_SECS )
+                due = true;
+            else if( (uint)(HNMD_CACHE_SAVE_SECS - age) < m_monitorWaitTime )
+                m_monitorWaitTime = HNMD_CACHE_SAVE_SECS - age;
+        }
+    }
+
+    if( due == true )
+        saveCacheFile();
+}
+
+void
+HNManagedDeviceArbiter::postChangeEvent( HNMDChangeEvent *event )
+{
+    // Nobody listening, so drop it.
+    if( m_changeQueue == NULL )
+    {
+        delete event;
+        return;
+    }
+
+    m_changeQueue->postRecord( event );
+}
+
+void
+HNManagedDeviceArbiter::postDeviceChangeEvent( HNMD_CHGEVT_TYPE_T type, uint32_t crc32ID, std::string detail )
+{
+    HNMDChangeEvent *event = new HNMDChangeEvent( type );
+
+    event->setDevCRC32ID( crc32ID );
+    event->setDetail( detail );
+
+    postChangeEvent( event );
+}
+
+void
+HNManagedDeviceArbiter::postDeviceTransitions( HNMDARecord &device, HNMDR_MGMT_STATE_T prevState, HNMDR_OWNER_STATE_T prevOwner )
+{
+    HNMDR_MGMT_STATE_T curState = device.getManagementState();
+
+    // The steady state alternates between the health and string
+    // reference polls, don't report that as a transition.
+    if( (curState != prevState) && (HNMDARecord::isHealthCycleStep( prevState, curState ) == false) )
+        postDeviceChangeEvent( HNMD_CHGEVT_TYPE_MGMT_STATE, device.getCRC32ID(), device.getManagementStateStr() );
+
+    if( device.getOwnershipState() != prevOwner )
+        postDeviceChangeEvent( HNMD_CHGEVT_TYPE_OWNERSHIP, device.getCRC32ID(), device.getOwnershipStateStr() );
+}
+
+void
+HNManagedDeviceArbiter::addMgmtDeviceProvidedSrv( HNMDARecord &record, std::string srvType, std::string version, std::string pathExt )
+{
+    bool added = false;            
+    Poco::URI uri;
+    uri.setScheme( "http" );
+    uri.setHost( m_mgmtDevice->getRestAddress() );
+    uri.setPort( m_mgmtDevice->getRestPort() );
+    std::string path = m_mgmtDevice->getRestRootPath();
+    path = path + "/" + pathExt;
+    uri.setPath( path );
+
+    HNMDServiceEndpoint &srvRef = record.updateSrvProvider( srvType, added );
+
+    srvRef.setType( srvType );        
+    srvRef.setVersion( version );
+    srvRef.setRootURIFromStr( uri.toString() );
+}
+
+void
+HNManagedDeviceArbiter::initMgmtDevice( HNMDARecord &record )
+{
+    // The health and logging sinks are both built into the management
+    // node itself.
+    record.startSrvProviderUpdates();
+
+    // Get a record object reference for this service type.
+    addMgmtDeviceProvidedSrv( record, "hnsrv-health-sink", "1.0.0", "mgmt/health-sink" );
+
+    addMgmtDeviceProvidedSrv( record, "hnsrv-log-sink", "1.0.0", "mgmt/log-sink" );
+
+    // Done with updates to services provided list
+    std::vector< HNMDSymbol > removedList;
+    record.completeSrvProviderUpdates( removedList );
+
+}
+
+HNMDL_RESULT_T 
+HNManagedDeviceArbiter::notifyDiscoverAdd( HNMDARecord &record )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    if( applyDiscoverAdd( record ) == true )
+        debugPrintDeviceMap();
+
+    requestMonitorPass( 0 );
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+HNMDL_RESULT_T 
+HNManagedDeviceArbiter::notifyDiscoverBatch( std::vector< HNMDARecord > &recordList, std::vector< std::string > &removedList )
+{
+    bool added = false;
+
+    // Scope lock, held once for the whole batch
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    for( std::vector< HNMDARecord >::iterator it = recordList.begin(); it != recordList.end(); it++ )
+    {
+        if( applyDiscoverAdd( *it ) == true )
+            added = true;
+    }
+
+    // Remove events only carry the discovery id, so index the
+    // map by it once for the whole batch.  Discovery ids are only
+    // written under m_mapMutex.
+    if( removedList.empty() == false )
+    {
+        std::unordered_map< std::string, HNMDARecord* > discMap;
+
+        for( std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
+            discMap[ it->second.getDiscoveryID() ] = &(it->second);
+
+        for( std::vector< std::string >::iterator rit = removedList.begin(); rit != removedList.end(); rit++ )
+        {
+            std::unordered_map< std::string, HNMDARecord* >::iterator dit = discMap.find( *rit );
+
+            if( dit == discMap.end() )
+            {
+                std::cout << "Discovery remove - unknown discID: " << *rit << std::endl;
+                continue;
+            }
+
+            applyDiscoverRemove( *(dit->second) );
+        }
+    }
+
+    std::cout << "Discovery batch applied - records: " << recordList.size() << "  removed: " << removedList.size() << std::endl;
+
+    if( added == true )
+        debugPrintDeviceMap();
+
+    // New devices need walking, and removed ones an eviction deadline
+    requestMonitorPass( 0 );
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+// Requires m_mapMutex.  Returns true if the record was new.
+bool
+HNManagedDeviceArbiter::applyDiscoverAdd( HNMDARecord &record )
+{
+    // Check if the record is existing, or if this is a new discovery.
+    std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( record.getCRC32ID() );
+
+    if( it == m_deviceMap.end() )
+    {
+        // This is a new record
+        if( record.getCRC32ID() == getSelfCRC32ID() )
+        {
+            std::cout << "Management Node Device adding inbuilt services - crc32id: " << record.getCRC32IDStr() << std::endl;
+
+            initMgmtDevice( record );
+
+            record.setManagementState( HNMDR_MGMT_STATE_SELF );
+         }
+        else
+            record.setManagementState( HNMDR_MGMT_STATE_DISCOVERED );
+
+        m_deviceMap.insert( std::pair< uint32_t, HNMDARecord >( record.getCRC32ID(), record ) );
+
+        // Index any services the record arrived with (the inbuilt
+        // services of the management node itself).
+        std::vector< HNMDSymbol > addedList;
+        std::vector< HNMDSymbol > removedList;
+        record.getSrvProviderSymbolList( addedList );
+        applySrvIndexUpdates( m_providerMap, record.getCRC32ID(), addedList, removedList );
+
+        m_healthRollup.setDeviceType( record.getCRC32ID(), record.getDeviceTypeSymbol() );
+
+        markInventoryChanged();
+
+        postDeviceChangeEvent( HNMD_CHGEVT_TYPE_DEVICE_ADDED, record.getCRC32ID(), record.getDeviceType() );
+
+        return true;
+    }
+
+    // Update the existing record with most recent information
+    it->second.lockForUpdate();
+
+    // A device that reappears within its grace period starts over
+    // from discovery, with only the addresses it is announcing now.
+    bool reappeared = ( it->second.getManagementState() == HNMDR_MGMT_STATE_DISAPPEARING );
+
+    if( reappeared == true )
+    {
+        it->second.clearAddressList();
+        it->second.setDisappearTime( 0 );
+        it->second.setManagementState( HNMDR_MGMT_STATE_DISCOVERED );
+    }
+
+    it->second.updateRecord( record );
+
+    bool modified = it->second.checkAndClearModified();
+
+    it->second.unlockForUpdate();
+
+    if( (modified == true) || (reappeared == true) )
+        markInventoryChanged();
+
+    if( reappeared == true )
+    {
+        std::cout << "Discovery - device reappeared: " << it->second.getCRC32IDStr() << std::endl;
+
+        postDeviceChangeEvent( HNMD_CHGEVT_TYPE_MGMT_STATE, it->second.getCRC32ID(), it->second.getManagementStateStr() );
+    }
+
+    return false;
+}
+
+// Requires m_mapMutex
+void
+HNManagedDeviceArbiter::applyDiscoverRemove( HNMDARecord &device )
+{
+    device.lockForUpdate();
+
+    // The management node's own record is never removed, and a
+    // device already on its way out keeps its original timer.
+    if( (device.getManagementState() == HNMDR_MGMT_STATE_SELF) || (device.getManagementState() == HNMDR_MGMT_STATE_DISAPPEARING) )
+    {
+        device.unlockForUpdate();
+        return;
+    }
+
+    device.setManagementState( HNMDR_MGMT_STATE_DISAPPEARING );
+    device.setDisappearTime( time(NULL) );
+
+    device.checkAndClearModified();
+
+    device.unlockForUpdate();
+
+    std::cout << "Discovery - device disappearing: " << device.getCRC32IDStr() << std::endl;
+
+    markInventoryChanged();
+
+    postDeviceChangeEvent( HNMD_CHGEVT_TYPE_MGMT_STATE, device.getCRC32ID(), device.getManagementStateStr() );
+}
+
+void
+HNManagedDeviceArbiter::evictDisappearedDevices( time_t now )
+{
+    std::vector< uint32_t > evictList;
+
+    {
+        // Scope lock
+        std::lock_guard<std::mutex> guard( m_mapMutex );
+
+        for( std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
+        {
+            HNMDARecord &device = it->second;
+
+            device.lockForUpdate();
+
+            if( device.getManagementState() == HNMDR_MGMT_STATE_DISAPPEARING )
+            {
+                time_t held = now - device.getDisappearTime();
+
+                // Come back when the grace period ends
+                if( held >= HNMD_DISAPPEAR_GRACE_SECS )
+                    evictList.push_back( it->first );
+                else if( (uint)(HNMD_DISAPPEAR_GRACE_SECS - held) < m_monitorWaitTime )
+                    m_monitorWaitTime = HNMD_DISAPPEAR_GRACE_SECS - held;
+            }
+
+            device.unlockForUpdate();
+        }
+
+        if( evictList.empty() == true )
+            return;
+
+        for( std::vector< uint32_t >::iterator eit = evictList.begin(); eit != evictList.end(); eit++ )
+        {
+            std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( *eit );
+
+            std::cout << "Evicting disappeared device - crc32: " << it->second.getCRC32IDStr() << std::endl;
+
+            std::string devType = it->second.getDeviceType();
+
+            removeFromSrvIndex( m_providerMap, *eit );
+            removeFromSrvIndex( m_servicesMap, *eit );
+
+            m_healthRollup.removeDevice( *eit );
+            m_healthHistory.removeDevice( *eit );
+
+            m_deviceMap.erase( it );
+
+            postDeviceChangeEvent( HNMD_CHGEVT_TYPE_DEVICE_REMOVED, *eit, devType );
+        }
+
+        markInventoryChanged();
+
+        debugPrintDeviceMap();
+    }
+
+    // Drop the per device health state, so it is neither kept
+    // in memory nor saved to the cache file.
+    std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+    for( std::vector< uint32_t >::iterator eit = evictList.begin(); eit != evictList.end(); eit++ )
+        dropDeviceHealthState( *eit );
+
+    postHealthRemovedEvents( evictList, noteDeviceHealthRemoved() );
+}
+
+// Cache file entries for devices that were never rediscovered
+// are dropped once the disappear grace period has passed.
+void
+HNManagedDeviceArbiter::dropUnclaimedCacheDevices( time_t now )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+    std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+    if( m_cacheReplaySet.empty() == true )
+        return;
+
+    time_t held = now - m_cacheLoadTime;
+
+    // Come back when the grace period ends
+    if( held < HNMD_DISAPPEAR_GRACE_SECS )
+    {
+        if( (uint)(HNMD_DISAPPEAR_GRACE_SECS - held) < m_monitorWaitTime )
+            m_monitorWaitTime = HNMD_DISAPPEAR_GRACE_SECS - held;
+        return;
+    }
+
+    std::vector< uint32_t > dropList;
+
+    // Devices in the map are claimed, they keep their replayed
+    // health until the first live report or their eviction.
+    for( std::unordered_set< uint32_t >::iterator it = m_cacheReplaySet.begin(); it != m_cacheReplaySet.end(); it++ )
+    {
+        if( m_deviceMap.find( *it ) == m_deviceMap.end() )
+            dropList.push_back( *it );
+    }
+
+    if( dropList.empty() == true )
+        return;
+
+    for( std::vector< uint32_t >::iterator dit = dropList.begin(); dit != dropList.end(); dit++ )
+    {
+        std::cout << "Dropping unclaimed cached device - crc32: " << formatCRC32IDStr( *dit ) << std::endl;
+
+        dropDeviceHealthState( *dit );
+    }
+
+    postHealthRemovedEvents( dropList, noteDeviceHealthRemoved() );
+}
+
+void
+HNManagedDeviceArbiter::dropDeviceHealthState( uint32_t crc32ID )
+{
+    // Caller must hold m_healthMutex
+    m_deviceHealthHash.erase( crc32ID );
+    m_deviceHealthGeneration.erase( crc32ID );
+    m_deviceHealthBody.erase( crc32ID );
+    m_deviceFirmware.erase( crc32ID );
+    m_strRefCheckSet.erase( crc32ID );
+    m_cacheReplaySet.erase( crc32ID );
+}
+
+uint64_t
+HNManagedDeviceArbiter::noteDeviceHealthRemoved()
+{
+    // Caller must hold m_healthMutex
+    m_healthGeneration += 1;
+
+    // Deltas can't describe a device that is gone, so
+    // clients from before now start over with a reset.
+    m_healthResetGeneration = m_healthGeneration;
+
+    m_cacheDirty = true;
+
+    return m_healthGeneration;
+}
+
+// Wakes health change long-polls and event
+// streams for devices dropped from the health cache.
+void
+HNManagedDeviceArbiter::postHealthRemovedEvents( std::vector< uint32_t > &removedList, uint64_t generation )
+{
+    for( std::vector< uint32_t >::iterator it = removedList.begin(); it != removedList.end(); it++ )
+    {
+        HNMDChangeEvent *event = new HNMDChangeEvent( HNMD_CHGEVT_TYPE_HEALTH );
+        event->setDevCRC32ID( *it );
+        event->setGeneration( generation );
+        postChangeEvent( event );
+    }
+}
+
+// Requires m_mapMutex
+void
+HNManagedDeviceArbiter::debugPrintDeviceMap()
+{
+    std::cout << "================================" << std::endl;
+    std::unordered_map< uint32_t, HNMDARecord >::iterator dit;
+    for( dit = m_deviceMap.begin(); dit != m_deviceMap.end(); dit++ )
+    {
+        dit->second.debugPrint( 2 );
+    }
+    std::cout << "================================" << std::endl;
+}
+
+HNMDL_RESULT_T 
+HNManagedDeviceArbiter::notifyDiscoverRemove( HNMDARecord &record )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( record.getCRC32ID() );
+
+    if( it != m_deviceMap.end() )
+        applyDiscoverRemove( it->second );
+
+    requestMonitorPass( 0 );
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+std::string 
+HNManagedDeviceArbiter::getSelfHNodeIDStr()
+{
+    std::string rtnStr;
+
+    if( m_mgmtDevice != NULL )
+        rtnStr = m_mgmtDevice->getHNodeIDStr();
+
+    return rtnStr;
+}
+
+std::string 
+HNManagedDeviceArbiter::getSelfCRC32IDStr()
+{
+    std::string rtnStr;
+
+    if( m_mgmtDevice != NULL )
+        rtnStr = m_mgmtDevice->getHNodeIDCRC32Str();
+
+    return rtnStr;
+}
+
+uint32_t
+HNManagedDeviceArbiter::getSelfCRC32ID()
+{
+    uint rtnVal = 0;
+
+    if( m_mgmtDevice != NULL )
+        rtnVal = m_mgmtDevice->getHNodeIDCRC32();
+
+    return rtnVal;
+}
+
+uint64_t
+HNManagedDeviceArbiter::computeBodyHash( const std::string &body )
+{
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+
+    for( std::string::const_iterator it = body.begin(); it != body.end(); it++ )
+    {
+        hash ^= (uint8_t) *it;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+HNMDL_RESULT_T
+HNManagedDeviceArbiter::parseCRC32IDStr( std::string value, uint32_t &crc32ID )
+{
+    char *endPtr = NULL;
+
+    crc32ID = 0;
+
+    // CRC32IDs are rendered as up to 8 hex digits
+    if( value.empty() || (value.size() > 8) )
+        return HNMDL_RESULT_FAILURE;
+
+    // strtoul would also take whitespace and a sign, "-1"
+    // comes back as 0xffffffff.  Only bare digits are IDs.
+    for( std::string::iterator it = value.begin(); it != value.end(); it++ )
+    {
+        if( isxdigit( (unsigned char) *it ) == 0 )
+            return HNMDL_RESULT_FAILURE;
+    }
+
+    unsigned long tmpID = strtoul( value.c_str(), &endPtr, 16 );
+
+    if( *endPtr != '\0' )
+        return HNMDL_RESULT_FAILURE;
+
+    crc32ID = (uint32_t) tmpID;
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+// The same rendering as HNodeID::getCRC32AsHexStr, so strings built
+// from a bare ID match the keys live code gets from getCRC32IDStr.
+std::string
+HNManagedDeviceArbiter::formatCRC32IDStr( uint32_t crc32ID )
+{
+    char crc32Str[16];
+
+    sprintf( crc32Str, "%x", crc32ID );
+
+    return crc32Str;
+}
+
+void
+HNManagedDeviceArbiter::markInventoryChanged()
+{
+    std::lock_guard<std::mutex> guard( m_snapshotMutex );
+
+    m_inventoryVersion += 1;
+}
+
+uint64_t
+HNManagedDeviceArbiter::getInventoryVersion()
+{
+    std::lock_guard<std::mutex> guard( m_snapshotMutex );
+
+    return m_inventoryVersion;
+}
+
+HNMDInventorySnapshotPtr
+HNManagedDeviceArbiter::getInventorySnapshot()
+{
+    uint64_t curVersion;
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    // If nothing has changed since the last snapshot was
+    // built, then hand out another reference to it.
+    {
+        std::lock_guard<std::mutex> snapGuard( m_snapshotMutex );
+
+        curVersion = m_inventoryVersion;
+
+        if( (m_inventorySnapshot != NULL) && (m_inventorySnapshot->getVersion() == curVersion) )
+            return m_inventorySnapshot;
+    }
+
+    // Build a new snapshot.  Any change made while copying bumps
+    // the version again, so the next request will rebuild.  Only
+    // records that changed since the last build are copied.
+    HNMDInventorySnapshotPtr newSnapshot( new HNMDInventorySnapshot( curVersion, m_deviceMap.size() ) );
+    std::unordered_map< uint32_t, HNMDARecordPtr > recordMap;
+
+    for( std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
+    {
+        HNMDARecordPtr copy;
+
+        it->second.lockForUpdate();
+
+        std::unordered_map< uint32_t, HNMDARecordPtr >::iterator cit = m_snapshotRecordMap.find( it->first );
+
+        if( (cit != m_snapshotRecordMap.end()) && (cit->second->getRevision() == it->second.getRevision()) )
+            copy = cit->second;
+        else
+            copy = HNMDARecordPtr( new HNMDARecord( it->second ) );
+
+        it->second.unlockForUpdate();
+
+        newSnapshot->addDevice( copy );
+        recordMap.insert( std::pair< uint32_t, HNMDARecordPtr >( it->first, copy ) );
+    }
+
+    // Evicted devices drop out here
+    m_snapshotRecordMap.swap( recordMap );
+
+    // Publish the new snapshot
+    {
+        std::lock_guard<std::mutex> snapGuard( m_snapshotMutex );
+        m_inventorySnapshot = newSnapshot;
+    }
+
+    return newSnapshot;
+}
+
+HNMDL_RESULT_T 
+HNManagedDeviceArbiter::lookupConnectionInfo( uint32_t crc32ID, HNMDARAddress &connInfo )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    // See if we have a record for the device
+    std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
+
+    if( it == m_deviceMap.end() )
+        return HNMDL_RESULT_FAILURE;
+
+    it->second.lockForUpdate();
+
+    HNMDL_RESULT_T result = it->second.findPreferredConnection( connInfo );
+
+    it->second.unlockForUpdate();
+
+    return result;
+}
+
+void
+HNManagedDeviceArbiter::reportConnectionResult( uint32_t crc32ID, const std::string &address, bool success, uint rttMS )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
+
+    if( it == m_deviceMap.end() )
+        return;
+
+    it->second.lockForUpdate();
+
+    it->second.recordConnectionResult( address, success, rttMS );
+
+    it->second.unlockForUpdate();
+}
+
+void 
+HNManagedDeviceArbiter::debugPrint()
+{
+    printf( "=== Managed Device Arbiter ===\n" );
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    for( std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
+    {
+        it->second.debugPrint( 2 );
+    }
+}
+
+
+
+void
+HNManagedDeviceArbiter::start()
+{
+    int error;
+
+    std::cout << "HNManagedDeviceArbiter::start()" << std::endl;
+
+    // Start with the health picture from the last run
+    loadCacheFile();
+
+    // Allocate the thread helper
+    thelp = new HNMDARunner( this );
+    if( !thelp )
+    {
+        //cleanup();
+        return;
+    }
+
+    runMonitor = true;
+
+    // Start up the event loop
+    ( (HNMDARunner*) thelp )->startThread();
+}
+
+void
+HNManagedDeviceArbiter::startOnReactor( HNEventReactor *reactor )
+{
+    std::cout << "HNManagedDeviceArbiter::startOnReactor()" << std::endl;
+
+    // Start with the health picture from the last run
+    loadCacheFile();
+
+    m_reactor = reactor;
+
+    // Passes are run when the timer fires, it is
+    // armed whenever a pass is requested.
+    m_monitorTimerFD = HNEventReactor::createTimer();
+    m_reactor->addFD( m_monitorTimerFD, this );
+
+    initMonitor();
+}
+
+void
+HNManagedDeviceArbiter::handleReactorEvent( int fd, uint32_t events )
+{
+    if( fd != m_monitorTimerFD )
+        return;
+
+    HNEventReactor::clearTimer( m_monitorTimerFD );
+
+    runMonitorPass();
+}
+
+void
+HNManagedDeviceArbiter::setNextMonitorState( HNMDARecord &device, HNMDR_MGMT_STATE_T nextState, uint minValue )
+{
+    // Only the monitor pass uses m_monitorWaitTime, other
+    // threads use applyMonitorState and requestMonitorPass.
+    if( minValue < m_monitorWaitTime )
+        m_monitorWaitTime = minValue;
+
+    if( applyMonitorState( device, nextState ) == true )
+        markInventoryChanged();
+}
+
+// Returns true if the record changed since it was last checked
+bool
+HNManagedDeviceArbiter::applyMonitorState( HNMDARecord &device, HNMDR_MGMT_STATE_T nextState )
+{
+    device.lockForUpdate();
+
+    // A remove that arrived while a step was talking to the
+    // device wins over where that step wanted to go next.
+    if( device.getManagementState() != HNMDR_MGMT_STATE_DISAPPEARING )
+        device.setManagementState( nextState );
+
+    // Pick up this change and any made by the
+    // preceding update step.
+    bool modified = device.checkAndClearModified();
+
+    device.unlockForUpdate();
+
+    return modified;
+}
+
+void 
+HNManagedDeviceArbiter::runMonitoringLoop()
+{
+    std::cout << "HNManagedDeviceArbiter::runMonitoringLoop()" << std::endl;
+
+    initMonitor();
+
+    // Run the main loop
+    while( waitForMonitorPass() == true )
+    {
+        runMonitorPass();
+    }
+
+    std::cout << "HNManagedDeviceArbiter::monitor exit" << std::endl;
+}
+
+void
+HNManagedDeviceArbiter::initMonitor()
+{
+    // FIXME -- Temporarily setup some default mappings
+    HNMDSrvRef tmpRef;
+
+    tmpRef.setSrvType( "hnsrv-health-sink" );
     tmpRef.setDevCRC32ID( getSelfCRC32IDStr() );
 
-    m_defaultMappings.insert( std::pair< std::string, HNMDSrvRef >( "hnsrv-health-sink", tmpRef ) );
-    // End FIXME
+    {
+        // Scope lock, read from the request workers
+        std::lock_guard<std::mutex> guard( m_mapMutex );
+
+        m_defaultMappings.insert( std::pair< std::string, HNMDSrvRef >( "hnsrv-health-sink", tmpRef ) );
+    }
+    // End FIXME
+
+    requestMonitorPass( 10 );
+}
+
+// Bring the next monitor pass forward to within delaySecs
+void
+HNManagedDeviceArbiter::requestMonitorPass( uint delaySecs )
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds( delaySecs );
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_monitorMutex );
+
+    if( (m_monitorDue == true) && (m_monitorDeadline <= deadline) )
+        return;
+
+    m_monitorDue      = true;
+    m_monitorDeadline = deadline;
+
+    if( m_reactor != NULL )
+        HNEventReactor::armTimer( m_monitorTimerFD, (uint64_t) delaySecs * 1000 );
+    else
+        m_monitorCV.notify_one();
+}
+
+// Blocks until a pass is due, returns false once
+// the monitor has been told to stop.
+bool
+HNManagedDeviceArbiter::waitForMonitorPass()
+{
+    std::unique_lock<std::mutex> lock( m_monitorMutex );
+
+    while( runMonitor == true )
+    {
+        if( m_monitorDue == false )
+            m_monitorCV.wait( lock );
+        else if( std::chrono::steady_clock::now() >= m_monitorDeadline )
+            return true;
+        else
+            m_monitorCV.wait_until( lock, m_monitorDeadline );
+    }
 
-    m_monitorWaitTime = 10;
+    return false;
+}
 
-    // Run the main loop
-    while( runMonitor == true )
+// One walk of the device list.  Schedules the next pass for
+// the soonest thing that needs one, if anything does.
+void
+HNManagedDeviceArbiter::runMonitorPass()
+{
+    // Requests from here on are for another pass
     {
-        sleep( m_monitorWaitTime );
-        m_monitorWaitTime = 10;
+        std::lock_guard<std::mutex> guard( m_monitorMutex );
+        m_monitorDue = false;
+    }
 
-        std::cout << "HNManagedDeviceArbiter::monitor wakeup" << std::endl;
+    m_monitorWaitTime = HNMD_MONITOR_WAIT_NONE;
 
-        // Walk through known devices and take any pending actions
-        for( std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
-        {
-            std::cout << "  Device - crc32: " << it->second.getCRC32IDStr() << "  type: " << it->second.getDeviceType() << "   state: " <<  it->second.getManagementStateStr() << "  ostate: " << it->second.getOwnershipStateStr() << std::endl;
+    // Records are only erased here, while no pointers
+    // from a previous pass are held.
+    evictDisappearedDevices( time(NULL) );
+    dropUnclaimedCacheDevices( time(NULL) );
 
-            switch( it->second.getManagementState() )
-            {
-                // This record represents myself, the management node, just halt in this state
-                case HNMDR_MGMT_STATE_SELF:
-                    it->second.setOwnershipState( HNMDR_OWNER_STATE_MINE );
-                    setNextMonitorState( it->second, HNMDR_MGMT_STATE_SELF, 10 );
-                break;
+    // Grab the current set of records.  The walk below makes
+    // blocking REST calls, so don't hold the map lock across it.
+    std::vector< HNMDARecord* > devList;
+    {
+        std::lock_guard<std::mutex> guard( m_mapMutex );
 
-                // Added via Avahi Discovery
-                case HNMDR_MGMT_STATE_DISCOVERED:
-                    it->second.setOwnershipState( HNMDR_OWNER_STATE_UNKNOWN );
-                    setNextMonitorState( it->second, HNMDR_MGMT_STATE_OPT_INFO, 0 );
-                break;
+        devList.reserve( m_deviceMap.size() );
+        for( std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
+            devList.push_back( &(it->second) );
+    }
 
-                // Added from local record of owned devices (from prior association )
-                case HNMDR_MGMT_STATE_RECOVERED:
-                    it->second.setOwnershipState( HNMDR_OWNER_STATE_MINE );
-                    setNextMonitorState( it->second, HNMDR_MGMT_STATE_OPT_INFO, 0 );
-                break;
+    // Start each pass at a different device so the ones at the
+    // front don't always get the health poll budget.
+    m_monitorPassCnt += 1;
+    if( devList.empty() == false )
+        std::rotate( devList.begin(), devList.begin() + (m_monitorPassCnt % devList.size()), devList.end() );
 
-                // REST read to aquire basic operating info
-                case HNMDR_MGMT_STATE_OPT_INFO:
-                    if( updateDeviceOperationalInfo( it->second ) != HNMDL_RESULT_SUCCESS )
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_OFFLINE, 10 );
-                    else
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_OWNER_INFO, 0 );
-                break;
+    // Walk through known devices and take any pending actions
+    for( std::vector< HNMDARecord* >::iterator dit = devList.begin(); dit != devList.end(); dit++ )
+    {
+        HNMDARecord &device = **dit;
 
-                // REST read for current ownership
-                case HNMDR_MGMT_STATE_OWNER_INFO:
-                    if( updateDeviceOwnerInfo( it->second ) != HNMDL_RESULT_SUCCESS )
-                    {
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_OFFLINE, 10 );
-                        break;
-                    }
-                    
-                    switch( it->second.getOwnershipState() )
-                    {
-                        case HNMDR_OWNER_STATE_MINE:
-                            setNextMonitorState( it->second, HNMDR_MGMT_STATE_SRV_PROVIDE_INFO, 0 );
-                        break;
+        std::cout << "  Device - crc32: " << device.getCRC32IDStr() << "  type: " << device.getDeviceType() << "   state: " <<  device.getManagementStateStr() << "  ostate: " << device.getOwnershipStateStr() << std::endl;
 
-                        case HNMDR_OWNER_STATE_OTHER:
-                            setNextMonitorState( it->second, HNMDR_MGMT_STATE_OTHER_MGR, 0 );
-                        break;
+        // Remember where the device started so transitions can be reported
+        HNMDR_MGMT_STATE_T  prevState = device.getManagementState();
+        HNMDR_OWNER_STATE_T prevOwner = device.getOwnershipState();
 
-                        case HNMDR_OWNER_STATE_AVAILABLE:
-                            setNextMonitorState( it->second, HNMDR_MGMT_STATE_UNCLAIMED, 0 );
-                        break;
+        switch( device.getManagementState() )
+        {
+            // This record represents myself, the management node, just halt in this state
+            case HNMDR_MGMT_STATE_SELF:
+                device.setOwnershipState( HNMDR_OWNER_STATE_MINE );
+                setNextMonitorState( device, HNMDR_MGMT_STATE_SELF, HNMD_MONITOR_WAIT_NONE );
+            break;
 
-                        case HNMDR_OWNER_STATE_UNAVAILABLE:
-                            setNextMonitorState( it->second, HNMDR_MGMT_STATE_NOT_AVAILABLE, 0 );
-                        break;
+            // Added via Avahi Discovery
+            case HNMDR_MGMT_STATE_DISCOVERED:
+                device.lockForUpdate();
+                device.clearPollStates();
+                device.unlockForUpdate();
+                device.setOwnershipState( HNMDR_OWNER_STATE_UNKNOWN );
+                setNextMonitorState( device, HNMDR_MGMT_STATE_OPT_INFO, 0 );
+            break;
 
-                        case HNMDR_OWNER_STATE_NOTSET:
-                        case HNMDR_OWNER_STATE_UNKNOWN:
-                            setNextMonitorState( it->second, HNMDR_MGMT_STATE_OFFLINE, 10 );
-                        break;
-                    }
-                break;
+            // Added from local record of owned devices (from prior association )
+            case HNMDR_MGMT_STATE_RECOVERED:
+                device.lockForUpdate();
+                device.clearPollStates();
+                device.unlockForUpdate();
+                device.setOwnershipState( HNMDR_OWNER_STATE_MINE );
+                setNextMonitorState( device, HNMDR_MGMT_STATE_OPT_INFO, 0 );
+            break;
 
-                // REST read for services provided
-                case HNMDR_MGMT_STATE_SRV_PROVIDE_INFO:
-                    if( updateDeviceServicesProvideInfo( it->second ) != HNMDL_RESULT_SUCCESS )
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_OFFLINE, 10 );
-                    else
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_SRV_MAPPING_INFO, 0 );
-                break;
+            // REST read to aquire basic operating info
+            case HNMDR_MGMT_STATE_OPT_INFO:
+                if( updateDeviceOperationalInfo( device ) != HNMDL_RESULT_SUCCESS )
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_OFFLINE, 10 );
+                else
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_OWNER_INFO, 0 );
+            break;
 
-                // REST read for desired services and current mappings
-                case HNMDR_MGMT_STATE_SRV_MAPPING_INFO:
-                    if( updateDeviceServicesMappingInfo( it->second ) != HNMDL_RESULT_SUCCESS )
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_ACTIVE, 10 );
-                    else
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_SRV_MAP_UPDATE, 0 );
-                break;
+            // REST read for current ownership
+            case HNMDR_MGMT_STATE_OWNER_INFO:
+                if( updateDeviceOwnerInfo( device ) != HNMDL_RESULT_SUCCESS )
+                {
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_OFFLINE, 10 );
+                    break;
+                }
                 
-                // REST put to update desired service mappings
-                case HNMDR_MGMT_STATE_SRV_MAP_UPDATE:
-                    if( executeDeviceServicesUpdateMapping( it->second ) != HNMDL_RESULT_SUCCESS )
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_OFFLINE, 10 );
+                switch( device.getOwnershipState() )
+                {
+                    case HNMDR_OWNER_STATE_MINE:
+                        setNextMonitorState( device, HNMDR_MGMT_STATE_SRV_PROVIDE_INFO, 0 );
+                    break;
+
+                    case HNMDR_OWNER_STATE_OTHER:
+                        setNextMonitorState( device, HNMDR_MGMT_STATE_OTHER_MGR, 0 );
+                    break;
+
+                    case HNMDR_OWNER_STATE_AVAILABLE:
+                        setNextMonitorState( device, HNMDR_MGMT_STATE_UNCLAIMED, 0 );
+                    break;
+
+                    case HNMDR_OWNER_STATE_UNAVAILABLE:
+                        setNextMonitorState( device, HNMDR_MGMT_STATE_NOT_AVAILABLE, 0 );
+                    break;
+
+                    case HNMDR_OWNER_STATE_NOTSET:
+                    case HNMDR_OWNER_STATE_UNKNOWN:
+                        setNextMonitorState( device, HNMDR_MGMT_STATE_OFFLINE, 10 );
+                    break;
+                }
+            break;
+
+            // REST read for services provided
+            case HNMDR_MGMT_STATE_SRV_PROVIDE_INFO:
+                if( updateDeviceServicesProvideInfo( device ) != HNMDL_RESULT_SUCCESS )
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_OFFLINE, 10 );
+                else
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_SRV_MAPPING_INFO, 0 );
+            break;
+
+            // REST read for desired services and current mappings
+            case HNMDR_MGMT_STATE_SRV_MAPPING_INFO:
+                if( updateDeviceServicesMappingInfo( device ) != HNMDL_RESULT_SUCCESS )
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_ACTIVE, 10 );
+                else
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_SRV_MAP_UPDATE, 0 );
+            break;
+            
+            // REST put to update desired service mappings
+            case HNMDR_MGMT_STATE_SRV_MAP_UPDATE:
+                if( executeDeviceServicesUpdateMapping( device ) != HNMDL_RESULT_SUCCESS )
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_OFFLINE, 10 );
+                else
+                {
+                    if( doesDeviceProvideService( device.getCRC32ID(), "hnsrv-health-source" ) == true )
+                        setNextMonitorState( device, HNMDR_MGMT_STATE_UPDATE_HEALTH, 0 );
                     else
-                    {
-                        if( doesDeviceProvideService( it->second.getCRC32IDStr(), "hnsrv-health-source" ) == true )
-                            setNextMonitorState( it->second, HNMDR_MGMT_STATE_UPDATE_HEALTH, 0 );
-                        else
-                            setNextMonitorState( it->second, HNMDR_MGMT_STATE_ACTIVE, 10 );
-                    }
-                break;
+                        setNextMonitorState( device, HNMDR_MGMT_STATE_ACTIVE, 10 );
+                }
+            break;
 
-                // Device is waiting to be claimed 
-                case HNMDR_MGMT_STATE_UNCLAIMED:
-                break;
+            // Device is waiting to be claimed 
+            case HNMDR_MGMT_STATE_UNCLAIMED:
+            break;
 
-                // Device is not currently owned, but is not available for claiming
-                case HNMDR_MGMT_STATE_NOT_AVAILABLE:
-                break;
+            // Device is not currently owned, but is not available for claiming
+            case HNMDR_MGMT_STATE_NOT_AVAILABLE:
+            break;
 
-                // Device is currently owner by other manager
-                case HNMDR_MGMT_STATE_OTHER_MGR:
-                break;
+            // Device is currently owner by other manager
+            case HNMDR_MGMT_STATE_OTHER_MGR:
+            break;
 
-                // Device is active, responding to period health checks
-                case HNMDR_MGMT_STATE_ACTIVE:
-                    setNextMonitorState( it->second, HNMDR_MGMT_STATE_ACTIVE, 10 );
-                break;
+            // Device is active, responding to period health checks
+            case HNMDR_MGMT_STATE_ACTIVE:
+                setNextMonitorState( device, HNMDR_MGMT_STATE_ACTIVE, HNMD_MONITOR_WAIT_NONE );
+            break;
 
-                // Avahi notification that device is offline
-                case HNMDR_MGMT_STATE_DISAPPEARING:
-                break;
+            // Avahi notification that device is offline, no longer
+            // polled and evicted once the grace period passes.
+            case HNMDR_MGMT_STATE_DISAPPEARING:
+            break;
 
-                // Recent attempts to contact device have been unsuccessful
-                case HNMDR_MGMT_STATE_OFFLINE:
-                break;
+            // Recent attempts to contact device have been unsuccessful
+            case HNMDR_MGMT_STATE_OFFLINE:
+            break;
 
-                // These should not occur in normal operation, something very wrong.
-                case HNMDR_MGMT_STATE_NOTSET:
-                default:
-                break;
+            // These should not occur in normal operation, something very wrong.
+            case HNMDR_MGMT_STATE_NOTSET:
+            default:
+            break;
 
-                // Perform the steps to execute a device command request
-                case HNMDR_MGMT_STATE_EXEC_CMD:
-                    if( executeDeviceMgmtCmd( it->second ) != HNMDL_RESULT_SUCCESS )
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_OFFLINE, 10 );
-                    else
-                        setNextMonitorState( it->second, HNMDR_MGMT_STATE_OPT_INFO, 2 );
-                break;
+            // Perform the steps to execute a device command request
+            case HNMDR_MGMT_STATE_EXEC_CMD:
+                if( executeDeviceMgmtCmd( device ) != HNMDL_RESULT_SUCCESS )
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_OFFLINE, 10 );
+                else
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_OPT_INFO, 2 );
+            break;
+
+            // Update the cached health information for the device
+            case HNMDR_MGMT_STATE_UPDATE_HEALTH:
+            {
+                bool changed = false;
+                bool polled  = false;
+                bool pushed  = false;
 
-                // Update the cached health information for the device
-                case HNMDR_MGMT_STATE_UPDATE_HEALTH:
+                // Poll only when this device's interval has passed, devices
+                // pushing health events only need an occasional reconciliation poll.
+                if( isHealthPollDue( device ) == true )
                 {
-                    bool changed = false;
-                    updateDeviceHealthInfo( it->second, changed );
-                    if( changed == true )
-                        m_healthCache.debugPrintHealthReport();
-                    //setNextMonitorState( it->second, HNMDR_MGMT_STATE_ACTIVE, 2 );
-                    setNextMonitorState( it->second, HNMDR_MGMT_STATE_UPDATE_STRREF, 10 );
+                    HNMDL_RESULT_T result = updateDeviceHealthInfo( device, changed );
+
+                    adaptHealthPollInterval( device, (result == HNMDL_RESULT_SUCCESS), changed );
+
+                    polled = ( result == HNMDL_RESULT_SUCCESS );
                 }
-                break;
 
-                // Update referenced string information from a device.
-                case HNMDR_MGMT_STATE_UPDATE_STRREF:
                 {
-                    bool changed = false;
-                    updateDeviceStringReferences( it->second, changed );
+                    std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
                     if( changed == true )
                         m_healthCache.debugPrintHealthReport();
-                    //setNextMonitorState( it->second, HNMDR_MGMT_STATE_ACTIVE, 2 );
-                    setNextMonitorState( it->second, HNMDR_MGMT_STATE_UPDATE_HEALTH, 10 );
+
+                    pushed = ( m_strRefCheckSet.erase( device.getCRC32ID() ) != 0 );
                 }
-                break;
 
+                // Strings only need checking once there is new health
+                // to reference them, otherwise wait for the next poll.
+                if( (polled == true) || (pushed == true) )
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_UPDATE_STRREF, 0 );
+                else
+                    setNextMonitorState( device, HNMDR_MGMT_STATE_UPDATE_HEALTH, getHealthPollWaitSecs( device ) );
+            }
+            break;
+
+            // Update referenced string information from a device.
+            case HNMDR_MGMT_STATE_UPDATE_STRREF:
+            {
+                bool changed = false;
+                updateDeviceStringReferences( device, changed );
+                if( changed == true )
+                {
+                    std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+                    m_healthCache.debugPrintHealthReport();
+                }
+                //setNextMonitorState( device, HNMDR_MGMT_STATE_ACTIVE, 2 );
+                setNextMonitorState( device, HNMDR_MGMT_STATE_UPDATE_HEALTH, getHealthPollWaitSecs( device ) );
             }
+            break;
+
         }
+
+        postDeviceTransitions( device, prevState, prevOwner );
     }
 
-    std::cout << "HNManagedDeviceArbiter::monitor exit" << std::endl;
+    // Persist the caches if they have changed
+    checkCacheSave();
+
+    if( m_monitorWaitTime != HNMD_MONITOR_WAIT_NONE )
+        requestMonitorPass( m_monitorWaitTime );
 }
 
 HNMDL_RESULT_T 
-HNManagedDeviceArbiter::setDeviceMgmtCmdFromJSON( std::string crc32ID, std::istream *bodyStream )
+HNManagedDeviceArbiter::setDeviceMgmtCmdFromJSON( uint32_t crc32ID, std::istream *bodyStream )
 {
     // Scope lock
     std::lock_guard<std::mutex> guard( m_mapMutex );
 
     // Lookup the device
-    std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
+    std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
 
     if( it == m_deviceMap.end() )
     {
@@ -1852,13 +3933,13 @@ HNManagedDeviceArbiter::setDeviceMgmtCmdFromJSON( std::string crc32ID, std::istr
 
 
 HNMDL_RESULT_T
-HNManagedDeviceArbiter::startDeviceMgmtCmd( std::string crc32ID )
+HNManagedDeviceArbiter::startDeviceMgmtCmd( uint32_t crc32ID )
 {
     // Scope lock
     std::lock_guard<std::mutex> guard( m_mapMutex );
 
     // Lookup the device
-    std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
+    std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
 
     if( it == m_deviceMap.end() )
     {
@@ -1867,8 +3948,12 @@ HNManagedDeviceArbiter::startDeviceMgmtCmd( std::string crc32ID )
 
     // Validate the request
 
-    // Start the requests
-    setNextMonitorState( it->second, HNMDR_MGMT_STATE_EXEC_CMD, 0 );
+    // Start the requests.  This runs on a request worker, so
+    // leave the monitor's wait time alone and ask for a pass.
+    if( applyMonitorState( it->second, HNMDR_MGMT_STATE_EXEC_CMD ) == true )
+        markInventoryChanged();
+
+    requestMonitorPass( 0 );
 
     return HNMDL_RESULT_SUCCESS;
 }
@@ -1876,6 +3961,18 @@ HNManagedDeviceArbiter::startDeviceMgmtCmd( std::string crc32ID )
 void
 HNManagedDeviceArbiter::shutdown()
 {
+    // Reactor hosted, the reactor has already stopped
+    if( m_reactor != NULL )
+    {
+        m_reactor->removeFD( m_monitorTimerFD );
+        close( m_monitorTimerFD );
+        m_monitorTimerFD = -1;
+        m_reactor = NULL;
+
+        saveCacheFile();
+        return;
+    }
+
     if( !thelp )
     {
         //cleanup();
@@ -1887,12 +3984,20 @@ HNManagedDeviceArbiter::shutdown()
 
     delete ( (HNMDARunner*) thelp );
     thelp = NULL;
+
+    // Keep the caches for the next start
+    saveCacheFile();
 }
 
 void 
 HNManagedDeviceArbiter::killMonitoringLoop()
 {
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_monitorMutex );
+
     runMonitor = false;    
+
+    m_monitorCV.notify_one();
 }
 
 HNMDL_RESULT_T
@@ -1916,115 +4021,259 @@ HNManagedDeviceArbiter::executeDeviceMgmtCmd( HNMDARecord &device )
     return HNMDL_RESULT_FAILURE;
 }
 
+// Service URIs a device advertises normally name one of its own
+// addresses, those are sent to the currently preferred address.
+// Returns that address, or empty if the service is hosted
+// elsewhere.  Caller must hold the device lock.
+std::string
+HNManagedDeviceArbiter::usePreferredConnection( HNMDARecord &device, const std::string &host )
+{
+    HNMDARAddress dcInfo;
+
+    if( device.findPreferredConnection( dcInfo ) != HNMDL_RESULT_SUCCESS )
+        return "";
+
+    std::vector< HNMDARAddress > &addrList = device.getAddressListRef();
+
+    for( std::vector< HNMDARAddress >::iterator it = addrList.begin(); it != addrList.end(); it++ )
+    {
+        if( (it->getAddress() == host) || (it->getDNSName() == host) )
+            return dcInfo.getAddress();
+    }
+
+    return "";
+}
+
+// Score the address a request went to, successes are
+// timed from startTS to the response headers.
+void
+HNManagedDeviceArbiter::noteConnectionResult( HNMDARecord &device, const std::string &address, bool success, struct timespec &startTS )
+{
+    uint rttMS = 0;
+
+    if( success == true )
+    {
+        struct timespec endTS;
+        clock_gettime( CLOCK_MONOTONIC, &endTS );
+        rttMS = ((endTS.tv_sec - startTS.tv_sec) * 1000) + ((endTS.tv_nsec - startTS.tv_nsec) / 1000000);
+    }
+
+    device.lockForUpdate();
+    device.recordConnectionResult( address, success, rttMS );
+    device.unlockForUpdate();
+}
+
 HNMDL_RESULT_T
-HNManagedDeviceArbiter::updateDeviceOperationalInfo( HNMDARecord &device )
+HNManagedDeviceArbiter::fetchDeviceEndpoint( HNMDARecord &device, HNMDAR_POLL_EP_T endpoint, std::string path, std::string &body, bool &unchanged )
 {
     Poco::URI uri;
     HNMDARAddress dcInfo;
+    std::string etag;
+    std::string lastModified;
+
+    body.clear();
+    unchanged = false;
 
     device.lockForUpdate();
 
-    if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
+    if( device.findPreferredConnection( dcInfo ) != HNMDL_RESULT_SUCCESS )
     {
         device.unlockForUpdate();
         return HNMDL_RESULT_FAILURE;
     }
 
+    etag = device.getPollStateRef( endpoint ).getETag();
+    lastModified = device.getPollStateRef( endpoint ).getLastModified();
+
     device.unlockForUpdate();
 
     uri.setScheme( "http" );
     uri.setHost( dcInfo.getAddress() );
     uri.setPort( dcInfo.getPort() );
-    uri.setPath( "/hnode2/device/info" );
+    uri.setPath( path );
 
     pns::HTTPClientSession session( uri.getHost(), uri.getPort() );
     pns::HTTPRequest request( pns::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
     pns::HTTPResponse response;
 
-    session.sendRequest( request );
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
+    // Let the device answer with a 304 if it supports validators
+    if( etag.empty() == false )
+        request.set( "If-None-Match", etag );
 
-    if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+    if( lastModified.empty() == false )
+        request.set( "If-Modified-Since", lastModified );
+
+    struct timespec startTS;
+    clock_gettime( CLOCK_MONOTONIC, &startTS );
+
+    try
+    {
+        session.sendRequest( request );
+        std::istream& rs = session.receiveResponse( response );
+        std::cout << path << ": " << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
+
+        // Any response means the address is reachable, time
+        // it to the response headers.
+        noteConnectionResult( device, dcInfo.getAddress(), true, startTS );
+
+        if( response.getStatus() == Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED )
+        {
+            unchanged = true;
+            return HNMDL_RESULT_SUCCESS;
+        }
+
+        if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+        {
+            return HNMDL_RESULT_FAILURE;
+        }
+
+        Poco::StreamCopier::copyToString( rs, body );
+    }
+    catch( Poco::Exception &ex )
     {
+        std::cout << "fetchDeviceEndpoint - request failed: " << path << "  address: " << dcInfo.getAddress() << "  error: " << ex.displayText() << std::endl;
+
+        noteConnectionResult( device, dcInfo.getAddress(), false, startTS );
+
         return HNMDL_RESULT_FAILURE;
     }
-        
-    // Track any updates
-    bool changed = false;
 
-    // {
-    //   "crc32ID" : "4900fb4e",
-    //   "deviceType" : "hnode2-irrigation-device",
-    //   "hnodeID" : "29:72:e2:ae:db:90:11:ec:89:a1:b8:27:eb:52:da:55",
-    //   "instance" : "default",
-    //   "name" : "InitialName",
-    //   "version" : "2.0.0"
-    // }
-    // Parse the json body of the request
-    try
-    {
-        device.lockForUpdate();
+    // Devices that don't send validators still return the same
+    // bytes when nothing has changed, so compare a body hash.
+    uint64_t bodyHash = computeBodyHash( body );
 
-        // Attempt to parse the json    
-        pjs::Parser parser;
-        pdy::Var varRoot = parser.parse( rs );
+    device.lockForUpdate();
 
-        // Get a pointer to the root object
-        pjs::Object::Ptr jsRoot = varRoot.extract< pjs::Object::Ptr >();
+    HNMDARPollState &pollState = device.getPollStateRef( endpoint );
+
+    if( (pollState.hasBodyHash() == true) && (pollState.getBodyHash() == bodyHash) )
+        unchanged = true;
+
+    pollState.setValidators( response.get( "ETag", "" ), response.get( "Last-Modified", "" ), bodyHash );
+
+    device.unlockForUpdate();
+
+    return HNMDL_RESULT_SUCCESS;
+}
 
-        if( jsRoot->has( "deviceType" ) )
+// Applies /hnode2/device/info fields straight to the record
+class HNMDOpInfoJsonHandler : public HNMDJsonHandler
+{
+    public:
+        HNMDOpInfoJsonHandler( HNMDARecord &device )
+        : m_device( device )
         {
-            std::string dtype = jsRoot->getValue<std::string>( "deviceType" );
-            if( device.getDeviceType() != dtype )
-            {   
-                changed = true;
-                device.setDeviceType( dtype );
-            }
+            m_changed = false;
         }
 
-        if( jsRoot->has( "instance" ) )
+        bool isChanged()
         {
-            std::string inst = jsRoot->getValue<std::string>( "instance" );
-            if( device.getInstance() != inst )
-            {   
-                changed = true;
-                device.setInstance( inst );
-            }
+            return m_changed;
         }
 
-        if( jsRoot->has( "name" ) )
+        virtual bool arrayStart( uint depth, const std::string &key )
         {
-            std::string name = jsRoot->getValue<std::string>( "name" );
-            std::cout << "Device Info returned name: " << name << std::endl;
-            if( device.getName() != name )
-            {   
-                changed = true;
-                device.setName( name );
-            }
+            // Root must be an object
+            return (depth != 0);
         }
 
-        if( jsRoot->has( "version" ) )
+        virtual bool stringValue( uint depth, const std::string &key, const std::string &value )
         {
-            std::string version = jsRoot->getValue<std::string>( "version" );
-            if( device.getDeviceVersion() != version )
-            {   
-                changed = true;
-                device.setDeviceVersion( version );
+            if( depth != 1 )
+                return (depth != 0);
+
+            if( key == "deviceType" )
+            {
+                if( m_device.getDeviceType() != value )
+                {   
+                    m_changed = true;
+                    m_device.setDeviceType( value );
+                }
+            }
+            else if( key == "instance" )
+            {
+                if( m_device.getInstance() != value )
+                {   
+                    m_changed = true;
+                    m_device.setInstance( value );
+                }
+            }
+            else if( key == "name" )
+            {
+                std::cout << "Device Info returned name: " << value << std::endl;
+                if( m_device.getName() != value )
+                {   
+                    m_changed = true;
+                    m_device.setName( value );
+                }
+            }
+            else if( key == "version" )
+            {
+                if( m_device.getDeviceVersion() != value )
+                {   
+                    m_changed = true;
+                    m_device.setDeviceVersion( value );
+                }
             }
+
+            return true;
         }
 
-        device.unlockForUpdate();
+    private:
+        HNMDARecord &m_device;
+        bool m_changed;
+};
+
+HNMDL_RESULT_T
+HNManagedDeviceArbiter::updateDeviceOperationalInfo( HNMDARecord &device )
+{
+    std::string body;
+    bool unchanged = false;
+
+    if( fetchDeviceEndpoint( device, HNMDAR_POLL_EP_INFO, "/hnode2/device/info", body, unchanged ) != HNMDL_RESULT_SUCCESS )
+    {
+        return HNMDL_RESULT_FAILURE;
     }
-    catch( Poco::Exception ex )
+
+    // Skip parsing and record locking if the device reports no change
+    if( unchanged == true )
+    {
+        std::cout << "Device OpInfo not modified: " << device.getCRC32IDStr() << std::endl;
+        return HNMDL_RESULT_SUCCESS;
+    }
+
+    HNMDJsonReader reader;
+    HNMDOpInfoJsonHandler handler( device );
+
+    // {
+    //   "crc32ID" : "4900fb4e",
+    //   "deviceType" : "hnode2-irrigation-device",
+    //   "hnodeID" : "29:72:e2:ae:db:90:11:ec:89:a1:b8:27:eb:52:da:55",
+    //   "instance" : "default",
+    //   "name" : "InitialName",
+    //   "version" : "2.0.0"
+    // }
+    // Parse the json body of the request, fields are
+    // applied to the record as they are read.
+    device.lockForUpdate();
+
+    if( reader.parse( body, handler ) == false )
     {
         device.setOwnershipState( HNMDR_OWNER_STATE_UNKNOWN );
+
+        // Force a full parse on the next poll
+        device.getPollStateRef( HNMDAR_POLL_EP_INFO ).clear();
+
         device.unlockForUpdate();
-        std::cout << "HNMDMgmtCmd::setFromJSON exception: " << ex.displayText() << std::endl;
+        std::cout << "updateDeviceOperationalInfo parse error: " << reader.getErrorStr() << std::endl;
         // Request body was not understood
         return HNMDL_RESULT_FAILURE;
     }
 
+    device.unlockForUpdate();
+
+    bool changed = handler.isChanged();
+
     if( changed == true )
     {
         std::cout << "Device OpInfo values changed: " << device.getName() << " (" << device.getCRC32IDStr() << ")" << std::endl;
@@ -2034,43 +4283,75 @@ HNManagedDeviceArbiter::updateDeviceOperationalInfo( HNMDARecord &device )
         std::cout << "Device OpInfo values did not change: " << device.getName() << " (" << device.getCRC32IDStr() << ")" << std::endl;
     }
 
-    return HNMDL_RESULT_SUCCESS;
-}
+    return HNMDL_RESULT_SUCCESS;
+}
+
+// Collects the /hnode2/device/owner fields
+class HNMDOwnerJsonHandler : public HNMDJsonHandler
+{
+    public:
+        HNMDOwnerJsonHandler()
+        {
+            m_isAvailable = false;
+            m_isOwned = false;
+        }
+
+        virtual bool arrayStart( uint depth, const std::string &key )
+        {
+            // Root must be an object
+            return (depth != 0);
+        }
+
+        virtual bool boolValue( uint depth, const std::string &key, bool value )
+        {
+            if( depth != 1 )
+                return (depth != 0);
+
+            if( key == "isAvailable" )
+                m_isAvailable = value;
+            else if( key == "isOwned" )
+                m_isOwned = value;
+
+            return true;
+        }
+
+        virtual bool stringValue( uint depth, const std::string &key, const std::string &value )
+        {
+            if( depth != 1 )
+                return (depth != 0);
+
+            if( key == "owner_hnodeID" )
+                m_ownerHNodeID = value;
+
+            return true;
+        }
+
+        bool m_isAvailable;
+        bool m_isOwned;
+        std::string m_ownerHNodeID;
+};
 
 HNMDL_RESULT_T
 HNManagedDeviceArbiter::updateDeviceOwnerInfo( HNMDARecord &device )
 {
-    Poco::URI uri;
-    HNMDARAddress dcInfo;
-
-    device.lockForUpdate();
+    std::string body;
+    bool unchanged = false;
 
-    if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
+    if( fetchDeviceEndpoint( device, HNMDAR_POLL_EP_OWNER, "/hnode2/device/owner", body, unchanged ) != HNMDL_RESULT_SUCCESS )
     {
-        device.unlockForUpdate();
         return HNMDL_RESULT_FAILURE;
     }
 
-    device.unlockForUpdate();
-
-    uri.setScheme( "http" );
-    uri.setHost( dcInfo.getAddress() );
-    uri.setPort( dcInfo.getPort() );
-    uri.setPath( "/hnode2/device/owner" );
-
-    pns::HTTPClientSession session( uri.getHost(), uri.getPort() );
-    pns::HTTPRequest request( pns::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
-    pns::HTTPResponse response;
-
-    session.sendRequest( request );
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
-
-    if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+    // Skip parsing and record locking if the device reports no change
+    if( unchanged == true )
     {
-        return HNMDL_RESULT_FAILURE;
+        std::cout << "Device OwnerInfo not modified: " << device.getCRC32IDStr() << std::endl;
+        return HNMDL_RESULT_SUCCESS;
     }
 
+    HNMDJsonReader reader;
+    HNMDOwnerJsonHandler handler;
+
     // {
     // "isAvailable" : true,
     // "isOwned" : true,
@@ -2078,73 +4359,59 @@ HNManagedDeviceArbiter::updateDeviceOwnerInfo( HNMDARecord &device )
     // "owner_hnodeID" : "54:cb:b3:de:e4:7f:11:ec:84:ac:d0:50:99:9c:b1:04"
     // }
     // Parse the json body of the request
-    try
-    {
-        device.lockForUpdate();
+    device.lockForUpdate();
 
-        // Attempt to parse the json    
-        pjs::Parser parser;
-        pdy::Var varRoot = parser.parse( rs );
+    if( reader.parse( body, handler ) == false )
+    {
+        device.setOwnershipState( HNMDR_OWNER_STATE_UNKNOWN );
 
-        // Get a pointer to the root object
-        pjs::Object::Ptr jsRoot = varRoot.extract< pjs::Object::Ptr >();
+        // Force a full parse on the next poll
+        device.getPollStateRef( HNMDAR_POLL_EP_OWNER ).clear();
 
-        bool isAvailable = false;
-        if( jsRoot->has( "isAvailable" ) )
-        {
-            isAvailable = jsRoot->getValue<bool>( "isAvailable" );
-        }
+        device.unlockForUpdate();
+        std::cout << "updateDeviceOwnerInfo parse error: " << reader.getErrorStr() << std::endl;
+        // Request body was not understood
+        return HNMDL_RESULT_FAILURE;
+    }
 
-        bool isOwned     = false;
-        if( jsRoot->has( "isOwned" ) )
-        {
-            isOwned = jsRoot->getValue<bool>( "isOwned" );
-        }
+    bool isAvailable = handler.m_isAvailable;
+    bool isOwned     = handler.m_isOwned;
 
-        HNodeID ownerHNID;
-        if( jsRoot->has( "owner_hnodeID" ) )
-        {
-            ownerHNID.setFromStr( jsRoot->getValue<std::string>( "owner_hnodeID" ) );
-        }
+    HNodeID ownerHNID;
+    if( handler.m_ownerHNodeID.empty() == false )
+    {
+        ownerHNID.setFromStr( handler.m_ownerHNodeID );
+    }
 
-        std::cout << "updateDeviceOwnerInfo - isOwned: " << isOwned << "  isAvail: " << isAvailable << "  ownerCRC32: " << ownerHNID.getCRC32AsHexStr() << std::endl;
+    std::cout << "updateDeviceOwnerInfo - isOwned: " << isOwned << "  isAvail: " << isAvailable << "  ownerCRC32: " << ownerHNID.getCRC32AsHexStr() << std::endl;
 
-        // Determine how to update the device ownership information
-        if( isOwned == true )
-        {
-            // Save away the owners hnodeID
-            device.setOwnerID( ownerHNID );
+    // Determine how to update the device ownership information
+    if( isOwned == true )
+    {
+        // Save away the owners hnodeID
+        device.setOwnerID( ownerHNID );
 
-            std::cout << "updateDeviceOwnerInfo - ownerCompare - " << m_mgmtDevice->getHNodeIDCRC32Str() << " : " << ownerHNID.getCRC32() << std::endl;
+        std::cout << "updateDeviceOwnerInfo - ownerCompare - " << m_mgmtDevice->getHNodeIDCRC32Str() << " : " << ownerHNID.getCRC32() << std::endl;
 
-            // Check if we are the owner
-            if( getSelfCRC32ID() == ownerHNID.getCRC32() )
-                device.setOwnershipState( HNMDR_OWNER_STATE_MINE );
-            else
-                device.setOwnershipState( HNMDR_OWNER_STATE_OTHER );
-        }
-        else if( isAvailable == true )
-        {
-            device.clearOwnerID();
-            device.setOwnershipState( HNMDR_OWNER_STATE_AVAILABLE );
-        }
+        // Check if we are the owner
+        if( getSelfCRC32ID() == ownerHNID.getCRC32() )
+            device.setOwnershipState( HNMDR_OWNER_STATE_MINE );
         else
-        {
-            device.clearOwnerID();
-            device.setOwnershipState( HNMDR_OWNER_STATE_UNAVAILABLE );
-        }
-
-        device.unlockForUpdate();
+            device.setOwnershipState( HNMDR_OWNER_STATE_OTHER );
     }
-    catch( Poco::Exception ex )
+    else if( isAvailable == true )
     {
-        device.setOwnershipState( HNMDR_OWNER_STATE_UNKNOWN );
-        device.unlockForUpdate();
-        std::cout << "HNMDMgmtCmd::setFromJSON exception: " << ex.displayText() << std::endl;
-        // Request body was not understood
-        return HNMDL_RESULT_FAILURE;
+        device.clearOwnerID();
+        device.setOwnershipState( HNMDR_OWNER_STATE_AVAILABLE );
+    }
+    else
+    {
+        device.clearOwnerID();
+        device.setOwnershipState( HNMDR_OWNER_STATE_UNAVAILABLE );
     }
 
+    device.unlockForUpdate();
+
     return HNMDL_RESULT_SUCCESS;
 }
 
@@ -2157,7 +4424,7 @@ HNManagedDeviceArbiter::sendDeviceClaimRequest( HNMDARecord &device )
 
     device.lockForUpdate();
 
-    if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
+    if( device.findPreferredConnection( dcInfo ) != HNMDL_RESULT_SUCCESS )
     {
         device.unlockForUpdate();
         return HNMDL_RESULT_FAILURE;
@@ -2176,21 +4443,30 @@ HNManagedDeviceArbiter::sendDeviceClaimRequest( HNMDARecord &device )
 
     request.setContentType( "application/json" );
 
-    // Build the json payload to send
-    std::ostream& os = session.sendRequest( request );
-
     jsRoot.set( "owner_hnodeID", this->getSelfHNodeIDStr() );
 
-    // Render into a json string.
-    try {
+    struct timespec startTS;
+    clock_gettime( CLOCK_MONOTONIC, &startTS );
+
+    try
+    {
+        // Build the json payload to send
+        std::ostream& os = session.sendRequest( request );
+
+        // Render into a json string.
         pjs::Stringifier::stringify( jsRoot, os );
-    } catch( Poco::Exception& ex ) {
-        std::cerr << ex.displayText() << std::endl;
+
+        session.receiveResponse( response );
+        std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "sendDeviceClaimRequest - request failed: " << dcInfo.getAddress() << "  error: " << ex.displayText() << std::endl;
+        noteConnectionResult( device, dcInfo.getAddress(), false, startTS );
         return HNMDL_RESULT_FAILURE;
     }
- 
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+
+    noteConnectionResult( device, dcInfo.getAddress(), true, startTS );
 
     if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
     {
@@ -2208,7 +4484,7 @@ HNManagedDeviceArbiter::sendDeviceReleaseRequest( HNMDARecord &device )
 
     device.lockForUpdate();
 
-    if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
+    if( device.findPreferredConnection( dcInfo ) != HNMDL_RESULT_SUCCESS )
     {
         device.unlockForUpdate();
         return HNMDL_RESULT_FAILURE;
@@ -2225,10 +4501,24 @@ HNManagedDeviceArbiter::sendDeviceReleaseRequest( HNMDARecord &device )
     pns::HTTPRequest request( pns::HTTPRequest::HTTP_DELETE, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
     pns::HTTPResponse response;
 
-    session.sendRequest( request );
- 
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+    struct timespec startTS;
+    clock_gettime( CLOCK_MONOTONIC, &startTS );
+
+    try
+    {
+        session.sendRequest( request );
+
+        session.receiveResponse( response );
+        std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "sendDeviceReleaseRequest - request failed: " << dcInfo.getAddress() << "  error: " << ex.displayText() << std::endl;
+        noteConnectionResult( device, dcInfo.getAddress(), false, startTS );
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    noteConnectionResult( device, dcInfo.getAddress(), true, startTS );
 
     if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
     {
@@ -2246,7 +4536,7 @@ HNManagedDeviceArbiter::sendDeviceSetParameters( HNMDARecord &device )
 
     device.lockForUpdate();
 
-    if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
+    if( device.findPreferredConnection( dcInfo ) != HNMDL_RESULT_SUCCESS )
     {
         device.unlockForUpdate();
         return HNMDL_RESULT_FAILURE;
@@ -2263,12 +4553,26 @@ HNManagedDeviceArbiter::sendDeviceSetParameters( HNMDARecord &device )
     pns::HTTPRequest request( pns::HTTPRequest::HTTP_PUT, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
     pns::HTTPResponse response;
 
-    // Format the update parameters
-    std::ostream &os = session.sendRequest( request );
-    device.getDeviceMgmtCmdRef().getUpdateFieldsJSON( os );
- 
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+    struct timespec startTS;
+    clock_gettime( CLOCK_MONOTONIC, &startTS );
+
+    try
+    {
+        // Format the update parameters
+        std::ostream &os = session.sendRequest( request );
+        device.getDeviceMgmtCmdRef().getUpdateFieldsJSON( os );
+
+        session.receiveResponse( response );
+        std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "sendDeviceSetParameters - request failed: " << dcInfo.getAddress() << "  error: " << ex.displayText() << std::endl;
+        noteConnectionResult( device, dcInfo.getAddress(), false, startTS );
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    noteConnectionResult( device, dcInfo.getAddress(), true, startTS );
 
     if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
     {
@@ -2278,202 +4582,273 @@ HNManagedDeviceArbiter::sendDeviceSetParameters( HNMDARecord &device )
     return HNMDL_RESULT_SUCCESS;
 }
 
-HNMDL_RESULT_T
-HNManagedDeviceArbiter::updateDeviceServicesProvideInfo( HNMDARecord &device )
+// Applies a services provided or mappings list to the record, one
+// service entry at a time as each object in the array closes.
+class HNMDSrvListJsonHandler : public HNMDJsonHandler
 {
-    Poco::URI uri;
-    HNMDARAddress dcInfo;
-
-    device.lockForUpdate();
-
-    if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
-    {
-        device.unlockForUpdate();
-        return HNMDL_RESULT_FAILURE;
-    }
+    public:
+        HNMDSrvListJsonHandler( HNMDARecord &device, bool isMapping, std::vector< HNMDSymbol > &addedList )
+        : m_device( device ), m_addedList( addedList )
+        {
+            m_isMapping = isMapping;
+            m_changed = false;
+            clearEntry();
+        }
 
-    device.unlockForUpdate();
+        bool isChanged()
+        {
+            return m_changed;
+        }
 
-    uri.setScheme( "http" );
-    uri.setHost( dcInfo.getAddress() );
-    uri.setPort( dcInfo.getPort() );
-    uri.setPath( "/hnode2/device/services/provided" );
+        virtual bool objectStart( uint depth, const std::string &key )
+        {
+            // Root must be an array
+            if( depth == 0 )
+                return false;
 
-    pns::HTTPClientSession session( uri.getHost(), uri.getPort() );
-    pns::HTTPRequest request( pns::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
-    pns::HTTPResponse response;
+            if( depth == 1 )
+                clearEntry();
 
-    session.sendRequest( request );
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
+            return true;
+        }
 
-    if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
-    {
-        return HNMDL_RESULT_FAILURE;
-    }
-        
-    // Track any updates
-    bool changed = false;
+        virtual bool objectEnd( uint depth )
+        {
+            if( depth == 1 )
+                applyEntry();
 
-    // [
-    //   {
-    //     "type" : "hnst-health-src",
-    //     "version" : "1.0.0",
-    //     "uri" : ""
-    //   }
-    // ]
-    // Parse the json body of the request
-    try
-    {
-        device.lockForUpdate();
+            return true;
+        }
 
-        // Attempt to parse the json    
-        pjs::Parser parser;
-        pdy::Var varRoot = parser.parse( rs );
+        virtual bool stringValue( uint depth, const std::string &key, const std::string &value )
+        {
+            if( depth != 2 )
+                return (depth != 0);
 
-        // Note the start of potential service list updates
-        device.startSrvProviderUpdates();
+            if( key == "type" )
+            {
+                m_hasType = true;
+                m_type = value;
+            }
+            else if( key == "version" )
+            {
+                m_hasVersion = true;
+                m_version = value;
+            }
+            else if( key == "uri" )
+            {
+                m_hasURI = true;
+                m_uri = value;
+            }
 
-        // Get a pointer to the root object
-        pjs::Array::Ptr jsRoot = varRoot.extract< pjs::Array::Ptr >();
+            return true;
+        }
 
-        for( uint i = 0; i < jsRoot->size(); i++ )
-        {
-            pjs::Object::Ptr jsSrvObj = jsRoot->getObject( i );
+    private:
+        HNMDARecord &m_device;
+        std::vector< HNMDSymbol > &m_addedList;
 
-            if( jsSrvObj.isNull() )
-                continue;
+        bool m_isMapping;
+        bool m_changed;
 
-            if( jsSrvObj->has( "type" ) )
-            {
-                std::string stype = jsSrvObj->getValue<std::string>( "type" );
+        bool        m_hasType;
+        std::string m_type;
+        bool        m_hasVersion;
+        std::string m_version;
+        bool        m_hasURI;
+        std::string m_uri;
 
-                std::cout << "updateDeviceServicesProvideInfo - type: " << stype << std::endl;
+        void clearEntry()
+        {
+            m_hasType = false;
+            m_hasVersion = false;
+            m_hasURI = false;
+        }
 
-                // Get a record object reference for this service type.
-                // If it hasn't been seen before, a new record will be created.
-                bool added = false;
-                HNMDServiceEndpoint &srvRef = device.updateSrvProvider( stype, added );
+        void applyEntry()
+        {
+            // Mandatory service type field missing, skip to next record
+            if( m_hasType == false )
+                return;
 
-                if( added == true )
-                    changed = true;
+            std::cout << "updateDeviceServices - type: " << m_type << std::endl;
 
-                if( jsSrvObj->has( "version" ) )
-                {
-                    std::string version = jsSrvObj->getValue<std::string>( "version" );
-                    if( srvRef.getVersion() != version )
-                    {
-                        srvRef.setVersion( version );
-                        changed = true;
-                    }
-                }
+            // Get a record object reference for this service type.
+            // If it hasn't been seen before, a new record will be created.
+            bool added = false;
+            HNMDServiceEndpoint &srvRef = (m_isMapping == true) ? m_device.updateSrvMapping( m_type, added ) : m_device.updateSrvProvider( m_type, added );
 
-                if( jsSrvObj->has( "uri" ) )
-                {
-                    std::string uri = jsSrvObj->getValue<std::string>( "uri" );
-                    if( srvRef.getRootURIAsStr() != uri )
-                    {
-                        srvRef.setRootURIFromStr( uri );
-                        changed = true;
-                    }
-                }
+            if( added == true )
+            {
+                m_addedList.push_back( srvRef.getTypeSymbol() );
+                m_changed = true;
+            }
 
+            if( (m_hasVersion == true) && (srvRef.getVersion() != m_version) )
+            {
+                srvRef.setVersion( m_version );
+                m_changed = true;
             }
-            else
+
+            if( (m_hasURI == true) && (srvRef.getRootURIAsStr() != m_uri) )
             {
-                // Mandatory service type field missing, skip to next record
-                continue;
+                srvRef.setRootURIFromStr( m_uri );
+                m_changed = true;
             }
-            
         }
+};
 
-        // Done with updates to services provided list
-        if( device.completeSrvProviderUpdates() == true )
-            changed = true;
+HNMDL_RESULT_T
+HNManagedDeviceArbiter::updateDeviceServicesProvideInfo( HNMDARecord &device )
+{
+    std::string body;
+    bool unchanged = false;
 
-        device.unlockForUpdate();
+    if( fetchDeviceEndpoint( device, HNMDAR_POLL_EP_SRV_PROVIDED, "/hnode2/device/services/provided", body, unchanged ) != HNMDL_RESULT_SUCCESS )
+    {
+        return HNMDL_RESULT_FAILURE;
+    }
 
+    // Skip parsing and record locking if the device reports no change
+    if( unchanged == true )
+    {
+        std::cout << "Device ServicesProvided not modified: " << device.getCRC32IDStr() << std::endl;
+        return HNMDL_RESULT_SUCCESS;
     }
-    catch( Poco::Exception ex )
+
+    // Track any updates
+    std::vector< HNMDSymbol > addedList;
+    std::vector< HNMDSymbol > removedList;
+
+    HNMDJsonReader reader;
+    HNMDSrvListJsonHandler handler( device, false, addedList );
+
+    // [
+    //   {
+    //     "type" : "hnst-health-src",
+    //     "version" : "1.0.0",
+    //     "uri" : ""
+    //   }
+    // ]
+    // Parse the json body of the request
+    device.lockForUpdate();
+
+    // Note the start of potential service list updates
+    device.startSrvProviderUpdates();
+
+    if( reader.parse( body, handler ) == false )
     {
-        // Done with updates to services provided list
+        // Done with updates to services list
         device.abandonSrvProviderUpdates();
 
+        // Force a full parse on the next poll
+        device.getPollStateRef( HNMDAR_POLL_EP_SRV_PROVIDED ).clear();
+
         device.unlockForUpdate();
 
-        std::cout << "HNMDMgmtCmd::updateDeviceServicesProvideInfo exception: " << ex.displayText() << std::endl;
+        // Entries added before the failure stay in the record,
+        // so keep the index in step with them.
+        if( addedList.empty() == false )
+        {
+            std::lock_guard<std::mutex> guard( m_mapMutex );
+            applySrvIndexUpdates( m_providerMap, device.getCRC32ID(), addedList, removedList );
+        }
+
+        std::cout << "updateDeviceServicesProvideInfo parse error: " << reader.getErrorStr() << std::endl;
         // Request body was not understood
         return HNMDL_RESULT_FAILURE;
     }
 
-    // If anything changed then update the by-service-type lookup maps
-    // in the arbiter as well.
+    bool changed = handler.isChanged();
+
+    // Done with updates to services list
+    if( device.completeSrvProviderUpdates( removedList ) == true )
+        changed = true;
+
+    device.unlockForUpdate();
+
     if( changed == true )
-    {
         std::cout << "Device list service providers changed." << std::endl;
-        rebuildSrvProviderMap();
+
+    // Apply the added and removed service types to
+    // the by-service-type lookup index in the arbiter.
+    if( (addedList.empty() == false) || (removedList.empty() == false) )
+    {
+        std::lock_guard<std::mutex> guard( m_mapMutex );
+        applySrvIndexUpdates( m_providerMap, device.getCRC32ID(), addedList, removedList );
     }
 
     return HNMDL_RESULT_SUCCESS;
 }
 
 void 
-HNManagedDeviceArbiter::rebuildSrvProviderMap()
+HNManagedDeviceArbiter::applySrvIndexUpdates( HNMDServiceIndex &index, uint32_t crc32ID, std::vector< HNMDSymbol > &addedList, std::vector< HNMDSymbol > &removedList )
 {
-    // Clear the old map since it will be rebuilt
-    m_providerMap.clear();
+    // Caller must hold m_mapMutex
+    for( std::vector< HNMDSymbol >::iterator sit = addedList.begin(); sit != addedList.end(); sit++ )
+    {
+        std::cout << "applySrvIndexUpdates - add: " << **sit << "  device: " << crc32ID << std::endl;
+        index[ *sit ].insert( crc32ID );
+    }
 
-    // Walk through each device
-    std::map< std::string, HNMDARecord >::iterator it;
-    for( it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
+    for( std::vector< HNMDSymbol >::iterator sit = removedList.begin(); sit != removedList.end(); sit++ )
     {
-        // Get a list of provided endpoint type strings
-        std::vector< std::string > srvTypes;
+        HNMDServiceIndex::iterator mit = index.find( *sit );
 
-        std::cout << "rebuildSrvProviderMap - device: " << it->second.getCRC32IDStr() << std::endl;
+        if( mit == index.end() )
+            continue;
 
-        it->second.getSrvProviderTSList( srvTypes );
+        std::cout << "applySrvIndexUpdates - remove: " << **sit << "  device: " << crc32ID << std::endl;
+        mit->second.erase( crc32ID );
 
-        std::cout << "rebuildSrvProviderMap - tscnt: " << srvTypes.size() << std::endl;
+        // Drop service types that no longer have any devices
+        if( mit->second.empty() )
+            index.erase( mit );
+    }
 
-        // Add this device to the srvProviderMap for each service it provides
-        for( std::vector< std::string >::iterator sit = srvTypes.begin(); sit != srvTypes.end(); sit++ )
-        {
-            std::cout << "rebuildSrvProviderMap - tsstr: " << *sit << std::endl;
+    // Provided services also group the health summary
+    if( (&index == &m_providerMap) && ((addedList.empty() == false) || (removedList.empty() == false)) )
+        m_healthRollup.updateDeviceServices( crc32ID, addedList, removedList );
+}
 
-            std::map< std::string, std::vector< std::string > >::iterator mit;
-            mit = m_providerMap.find( *sit );
-            
-            if( mit != m_providerMap.end() )
-            {
-                std::cout << "rebuildSrvProviderMap - add-new" << std::endl;
-                mit->second.push_back( it->second.getCRC32IDStr() );
-            }
-            else
-            {
-                std::cout << "rebuildSrvProviderMap - add-tail" << std::endl;
-                std::vector< std::string > tmpList;
-                tmpList.push_back( it->second.getCRC32IDStr() );
-                m_providerMap.insert( std::pair< std::string, std::vector< std::string > >( *sit, tmpList ) );
-            }
-        }    
+void
+HNManagedDeviceArbiter::removeFromSrvIndex( HNMDServiceIndex &index, uint32_t crc32ID )
+{
+    // Caller must hold m_mapMutex
+    HNMDServiceIndex::iterator mit = index.begin();
+
+    while( mit != index.end() )
+    {
+        mit->second.erase( crc32ID );
+
+        if( mit->second.empty() )
+            mit = index.erase( mit );
+        else
+            mit++;
     }
 }
 
 std::string
-HNManagedDeviceArbiter::getDeviceServiceProviderURI( std::string devCRC32ID, std::string srvType )
+HNManagedDeviceArbiter::getDeviceServiceProviderURI( uint32_t devCRC32ID, std::string srvType )
 {
     std::string rtnURI;
 
-    std::map< std::string, HNMDARecord >::iterator it = m_deviceMap.find( devCRC32ID );
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( devCRC32ID );
 
     if( it == m_deviceMap.end() )
         return rtnURI;
 
-    std::cout << "getDeviceServiceProviderURI - found: " << devCRC32ID << std::endl;
+    std::cout << "getDeviceServiceProviderURI - found: " << it->second.getCRC32IDStr() << std::endl;
+
+    it->second.lockForUpdate();
 
     rtnURI = it->second.getServiceProviderURI( srvType );
 
+    it->second.unlockForUpdate();
+
     return rtnURI;
 }
 
@@ -2481,44 +4856,66 @@ HNMDL_RESULT_T
 HNManagedDeviceArbiter::executeDeviceServicesUpdateMapping( HNMDARecord &device )
 {
     std::map< std::string, std::string > uriMap;
+    std::map< std::string, std::string > maptoMap;
     std::vector< std::string > srvTypes;
     bool serviceProviderChanged = false;
 
-    // Note the start of potential service list updates
-    device.lockForUpdate();
-
     // Get a list of desired services
     std::cout << "executeDeviceServicesUpdateMapping - device: " << device.getCRC32IDStr() << std::endl;
 
+    device.lockForUpdate();
     device.getSrvMappingTSList( srvTypes );
+    device.unlockForUpdate();
 
     std::cout << "executeDeviceServicesUpdateMapping - tscnt: " << srvTypes.size() << std::endl;
 
-    // Walk through the desired services and see if the mapping is correct.
+    // Resolve the desired mapping uri for each service first.  The lookup
+    // takes the map lock, which must not be aquired while holding a device lock.
     for( std::vector< std::string >::iterator it = srvTypes.begin(); it != srvTypes.end(); it++ )
     {
         std::string maptoURI;
 
-        bool added = false;
-        HNMDServiceEndpoint &srvRef = device.updateSrvMapping( *it, added );
-
         // Generate the desired mapping uri
         // First check for a specific mapping
         // m_directedMappings.find();
         //if(  )
 
         // Otherwise look for a default mapping
-        std::map< std::string, HNMDSrvRef >::iterator sit = m_defaultMappings.find( *it );
+        std::string defCRC32Str;
+        {
+            // Scope lock
+            std::lock_guard<std::mutex> guard( m_mapMutex );
+
+            std::map< std::string, HNMDSrvRef >::iterator sit = m_defaultMappings.find( *it );
+
+            if( sit != m_defaultMappings.end() )
+                defCRC32Str = sit->second.getDevCRC32ID();
+        }
 
-        if( sit != m_defaultMappings.end() )
+        if( defCRC32Str.empty() == false )
         {
-            std::string maptoCRC32ID = sit->second.getDevCRC32ID();
+            uint32_t maptoCRC32ID = 0;
 
-            std::cout << "executeDeviceServicesUpdateMapping - defMapCRC32ID: " << maptoCRC32ID << std::endl;
+            std::cout << "executeDeviceServicesUpdateMapping - defMapCRC32ID: " << defCRC32Str << std::endl;
 
-            maptoURI = getDeviceServiceProviderURI( maptoCRC32ID, *it );
+            if( parseCRC32IDStr( defCRC32Str, maptoCRC32ID ) == HNMDL_RESULT_SUCCESS )
+                maptoURI = getDeviceServiceProviderURI( maptoCRC32ID, *it );
         }
 
+        maptoMap.insert( std::pair< std::string, std::string >( *it, maptoURI ) );
+    }
+
+    // Note the start of potential service list updates
+    device.lockForUpdate();
+
+    // Walk through the desired services and see if the mapping is correct.
+    for( std::vector< std::string >::iterator it = srvTypes.begin(); it != srvTypes.end(); it++ )
+    {
+        std::string maptoURI = maptoMap[ *it ];
+
+        bool added = false;
+        HNMDServiceEndpoint &srvRef = device.updateSrvMapping( *it, added );
+
         // Get any current mapping
         std::string mappedURI = srvRef.getRootURIAsStr();
 
@@ -2558,7 +4955,9 @@ HNManagedDeviceArbiter::executeDeviceServicesUpdateMapping( HNMDARecord &device
             jsSrvMapUpdate.add( jsMapObj );
         }
 
-        if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
+        device.lockForUpdate();
+
+        if( device.findPreferredConnection( dcInfo ) != HNMDL_RESULT_SUCCESS )
         {
             device.unlockForUpdate();
             return HNMDL_RESULT_FAILURE;
@@ -2577,19 +4976,28 @@ HNManagedDeviceArbiter::executeDeviceServicesUpdateMapping( HNMDARecord &device
 
         request.setContentType( "application/json" );
 
-        // Build the json payload to send
-        std::ostream& os = session.sendRequest( request );
+        struct timespec startTS;
+        clock_gettime( CLOCK_MONOTONIC, &startTS );
 
-        // Render into a json string.
-        try {
+        try
+        {
+            // Build the json payload to send
+            std::ostream& os = session.sendRequest( request );
+
+            // Render into a json string.
             pjs::Stringifier::stringify( jsSrvMapUpdate, os );
-        } catch( Poco::Exception& ex ) {
-            std::cerr << ex.displayText() << std::endl;
+
+            session.receiveResponse( response );
+            std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+        }
+        catch( Poco::Exception &ex )
+        {
+            std::cout << "executeDeviceServicesUpdateMapping - request failed: " << dcInfo.getAddress() << "  error: " << ex.displayText() << std::endl;
+            noteConnectionResult( device, dcInfo.getAddress(), false, startTS );
             return HNMDL_RESULT_FAILURE;
         }
- 
-        std::istream& rs = session.receiveResponse( response );
-        std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+
+        noteConnectionResult( device, dcInfo.getAddress(), true, startTS );
 
         if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
         {
@@ -2602,20 +5010,22 @@ HNManagedDeviceArbiter::executeDeviceServicesUpdateMapping( HNMDARecord &device
 }
 
 bool
-HNManagedDeviceArbiter::doesDeviceProvideService( std::string crc32ID, std::string srvType )
+HNManagedDeviceArbiter::doesDeviceProvideService( uint32_t crc32ID, std::string srvType )
 {
-    std::map< std::string, std::vector< std::string > >::iterator it = m_providerMap.find( srvType );
+    // A type that was never interned has no providers
+    HNMDSymbol srvSymbol = HNMDSymbolTable::lookup( srvType );
+    if( srvSymbol == NULL )
+        return false;
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    HNMDServiceIndex::iterator it = m_providerMap.find( srvSymbol );
 
     if( it == m_providerMap.end() )
         return false;
 
-    for( std::vector< std::string >::iterator idit = it->second.begin(); idit != it->second.end(); idit++ )
-    {
-        if( *idit == crc32ID )
-            return true;
-    }
-
-    return false;    
+    return ( it->second.count( crc32ID ) != 0 );
 }
 
 void
@@ -2624,24 +5034,32 @@ HNManagedDeviceArbiter::reportSrvProviderInfoList( std::vector< HNMDServiceInfo
     // Start with a clean slate
     srvList.clear();
 
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
     // Walk through each service
-    std::map< std::string, std::vector< std::string > >::iterator it;
+    HNMDServiceIndex::iterator it;
     for( it = m_providerMap.begin(); it != m_providerMap.end(); it++ )
     {
         HNMDServiceInfo srvInfo;
 
-        srvInfo.setSrvType( it->first );
+        srvInfo.setSrvType( *(it->first) );
 
         srvList.push_back( srvInfo );
 
-        for( std::vector< std::string >::iterator cit = it->second.begin(); cit != it->second.end(); cit++ )
+        for( std::unordered_set< uint32_t >::iterator cit = it->second.begin(); cit != it->second.end(); cit++ )
         {
-            std::map< std::string, HNMDARecord >::iterator dit = m_deviceMap.find( *cit );
+            std::unordered_map< uint32_t, HNMDARecord >::iterator dit = m_deviceMap.find( *cit );
+
+            if( dit == m_deviceMap.end() )
+                continue;
 
             HNMDServiceDevRef devRef;
 
+            dit->second.lockForUpdate();
             devRef.setDevName( dit->second.getName() );
             devRef.setDevCRC32ID( dit->second.getCRC32IDStr() );
+            dit->second.unlockForUpdate();
 
             srvList.back().getDeviceListRef().push_back( devRef );
         }
@@ -2651,39 +5069,27 @@ HNManagedDeviceArbiter::reportSrvProviderInfoList( std::vector< HNMDServiceInfo
 HNMDL_RESULT_T
 HNManagedDeviceArbiter::updateDeviceServicesMappingInfo( HNMDARecord &device )
 {
-    Poco::URI uri;
-    HNMDARAddress dcInfo;
-
-    device.lockForUpdate();
+    std::string body;
+    bool unchanged = false;
 
-    if( device.findPreferredConnection( HMDAR_ADDRTYPE_IPV4, dcInfo ) != HNMDL_RESULT_SUCCESS )
+    if( fetchDeviceEndpoint( device, HNMDAR_POLL_EP_SRV_MAPPINGS, "/hnode2/device/services/mappings", body, unchanged ) != HNMDL_RESULT_SUCCESS )
     {
-        device.unlockForUpdate();
         return HNMDL_RESULT_FAILURE;
     }
 
-    device.unlockForUpdate();
-
-    uri.setScheme( "http" );
-    uri.setHost( dcInfo.getAddress() );
-    uri.setPort( dcInfo.getPort() );
-    uri.setPath( "/hnode2/device/services/mappings" );
-
-    pns::HTTPClientSession session( uri.getHost(), uri.getPort() );
-    pns::HTTPRequest request( pns::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
-    pns::HTTPResponse response;
-
-    session.sendRequest( request );
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
-
-    if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+    // Skip parsing and record locking if the device reports no change
+    if( unchanged == true )
     {
-        return HNMDL_RESULT_FAILURE;
+        std::cout << "Device ServicesMapping not modified: " << device.getCRC32IDStr() << std::endl;
+        return HNMDL_RESULT_SUCCESS;
     }
-        
+
     // Track any updates
-    bool changed = false;
+    std::vector< HNMDSymbol > addedList;
+    std::vector< HNMDSymbol > removedList;
+
+    HNMDJsonReader reader;
+    HNMDSrvListJsonHandler handler( device, true, addedList );
 
     // [
     //   {
@@ -2693,227 +5099,556 @@ HNManagedDeviceArbiter::updateDeviceServicesMappingInfo( HNMDARecord &device )
     //   }
     // ]
     // Parse the json body of the request
-    try
+    device.lockForUpdate();
+
+    // Note the start of potential service list updates
+    device.startSrvMappingUpdates();
+
+    if( reader.parse( body, handler ) == false )
     {
-        device.lockForUpdate();
+        // Done with updates to services list
+        device.abandonSrvMappingUpdates();
 
-        // Attempt to parse the json    
-        pjs::Parser parser;
-        pdy::Var varRoot = parser.parse( rs );
+        // Force a full parse on the next poll
+        device.getPollStateRef( HNMDAR_POLL_EP_SRV_MAPPINGS ).clear();
+
+        device.unlockForUpdate();
 
-        // Note the start of potential service list updates
-        device.startSrvMappingUpdates();
+        // Entries added before the failure stay in the record,
+        // so keep the index in step with them.
+        if( addedList.empty() == false )
+        {
+            std::lock_guard<std::mutex> guard( m_mapMutex );
+            applySrvIndexUpdates( m_servicesMap, device.getCRC32ID(), addedList, removedList );
+        }
 
-        // Get a pointer to the root object
-        pjs::Array::Ptr jsRoot = varRoot.extract< pjs::Array::Ptr >();
+        std::cout << "updateDeviceServicesMappingInfo parse error: " << reader.getErrorStr() << std::endl;
+        // Request body was not understood
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    bool changed = handler.isChanged();
+
+    // Done with updates to services list
+    if( device.completeSrvMappingUpdates( removedList ) == true )
+        changed = true;
+
+    device.unlockForUpdate();
+
+    if( changed == true )
+        std::cout << "Device list service mappings changed." << std::endl;
+
+    // Apply the added and removed service types to
+    // the by-service-type lookup index in the arbiter.
+    if( (addedList.empty() == false) || (removedList.empty() == false) )
+    {
+        std::lock_guard<std::mutex> guard( m_mapMutex );
+        applySrvIndexUpdates( m_servicesMap, device.getCRC32ID(), addedList, removedList );
+    }
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+void
+HNManagedDeviceArbiter::reportSrvMappingInfoList( std::vector< HNMDServiceInfo > &srvList )
+{
+    // Start with a clean slate
+    srvList.clear();
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_mapMutex );
+
+    std::cout << "buildSrvMappingInfoList - size: " << m_servicesMap.size() << std::endl;
+
+    // Walk through each service
+    HNMDServiceIndex::iterator it;
+    for( it = m_servicesMap.begin(); it != m_servicesMap.end(); it++ )
+    {
+        HNMDServiceInfo srvInfo;
 
-        for( uint i = 0; i < jsRoot->size(); i++ )
+        srvInfo.setSrvType( *(it->first) );
+
+        srvList.push_back( srvInfo );
+
+        std::cout << "buildSrvMappingInfoList - size2: " << it->second.size() << std::endl;
+
+        for( std::unordered_set< uint32_t >::iterator cit = it->second.begin(); cit != it->second.end(); cit++ )
         {
-            pjs::Object::Ptr jsSrvObj = jsRoot->getObject( i );
+            std::unordered_map< uint32_t, HNMDARecord >::iterator dit = m_deviceMap.find( *cit );
 
-            if( jsSrvObj.isNull() )
+            if( dit == m_deviceMap.end() )
                 continue;
 
-            if( jsSrvObj->has( "type" ) )
-            {
-                std::string stype = jsSrvObj->getValue<std::string>( "type" );
+            HNMDServiceDevRef devRef;
+
+            dit->second.lockForUpdate();
+            devRef.setDevName( dit->second.getName() );
+            devRef.setDevCRC32ID( dit->second.getCRC32IDStr() );
+            dit->second.unlockForUpdate();
 
-                std::cout << "updateDeviceServicesMappingInfo - type: " << stype << std::endl;
+            srvList.back().getDeviceListRef().push_back( devRef );
+        }
+    }
+}
 
-                // Get a record object reference for this service type.
-                // If it hasn't been seen before, a new record will be created.
-                bool added = false;
-                HNMDServiceEndpoint &srvRef = device.updateSrvMapping( stype, added );
+void
+HNManagedDeviceArbiter::reportSrvDefaultMappings( std::vector< HNMDServiceAssoc > &assocList )
+{
+    // Start with a clean slate
+    assocList.clear();
 
-                if( added == true )
-                    changed = true;
+    // Scope lock, now read from the request workers
+    std::lock_guard<std::mutex> guard( m_mapMutex );
 
-                if( jsSrvObj->has( "version" ) )
-                {
-                    std::string version = jsSrvObj->getValue<std::string>( "version" );
-                    if( srvRef.getVersion() != version )
-                    {
-                        srvRef.setVersion( version );
-                        changed = true;
-                    }
-                }
+    std::cout << "reportSrvDefaultMappings - size: " << m_defaultMappings.size() << std::endl;
+
+    // Walk through each service
+    std::map< std::string, HNMDSrvRef >::iterator it;
+    for( it = m_defaultMappings.begin(); it != m_defaultMappings.end(); it++ )
+    {
+        HNMDServiceAssoc srvAssoc;
+
+        /*
+        if( it->)
+
+        HNMDServiceInfo srvInfo;
+
+        srvInfo.setSrvType( it->first );
+
+        srvList.push_back( srvInfo );
+
+        std::cout << "buildSrvMappingInfoList - size2: " << it->second.size() << std::endl;
+
+        for( std::vector< std::string >::iterator cit = it->second.begin(); cit != it->second.end(); cit++ )
+        {
+            std::map< std::string, HNMDARecord >::iterator dit = m_deviceMap.find( *cit );
+
+            HNMDServiceDevRef devRef;
+
+            devRef.setDevName( dit->second.getName() );
+            devRef.setDevCRC32ID( dit->second.getCRC32IDStr() );
+
+            srvList.back().getDeviceListRef().push_back( devRef );
+        }
+        */
+    }
+}
+
+void
+HNManagedDeviceArbiter::reportSrvDirectedMappings( std::vector< HNMDServiceAssoc > &assocList )
+{
+    assocList.clear();
+}
+
+void
+HNManagedDeviceArbiter::generateAllDeviceHealthReportAsJSON( std::ostream &bodyStream )
+{
+    std::string reportJSON;
+    uint64_t    generation;
+
+    getClusterHealthReport( reportJSON, generation );
+
+    bodyStream.write( reportJSON.data(), reportJSON.size() );
+}
+
+void
+HNManagedDeviceArbiter::getClusterHealthReport( std::string &reportJSON, uint64_t &generation )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_healthMutex );
+
+    // Only walk the health cache if something has
+    // changed since the report was last rendered.
+    if( m_healthReportGeneration != m_healthGeneration )
+    {
+        std::ostringstream reportStream;
+
+        m_healthCache.generateAllDeviceHealthReportAsJSON( reportStream );
+
+        m_healthReportJSON = reportStream.str();
+        m_healthReportGeneration = m_healthGeneration;
+    }
+
+    reportJSON = m_healthReportJSON;
+    generation = m_healthReportGeneration;
+}
+
+HNMDL_RESULT_T
+HNManagedDeviceArbiter::notifyHealthEvent( const std::string &body )
+{
+    std::string crc32Str;
+    uint32_t    crc32ID = 0;
+    HNMDARecord *device = NULL;
+    bool changed = false;
+
+    // The event body is the same health document the device serves
+    // from its hnsrv-health-source endpoint, so pull out the source.
+    try
+    {
+        pjs::Parser parser;
+        pdy::Var varRoot = parser.parse( body );
+
+        pjs::Object::Ptr jsRoot = varRoot.extract< pjs::Object::Ptr >();
+
+        if( jsRoot->has( "deviceCRC32" ) == false )
+        {
+            std::cout << "notifyHealthEvent - missing deviceCRC32" << std::endl;
+            return HNMDL_RESULT_FAILURE;
+        }
+
+        crc32Str = jsRoot->getValue<std::string>( "deviceCRC32" );
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "notifyHealthEvent - parse error: " << ex.displayText() << std::endl;
+        return HNMDL_RESULT_FAILURE;
+    }
+
+    if( parseCRC32IDStr( crc32Str, crc32ID ) != HNMDL_RESULT_SUCCESS )
+        return HNMDL_RESULT_FAILURE;
+
+    // Only accept events from devices we are managing.  The map
+    // lock is held throughout, since the monitor may evict records.
+    {
+        std::lock_guard<std::mutex> guard( m_mapMutex );
+
+        std::unordered_map< uint32_t, HNMDARecord >::iterator it = m_deviceMap.find( crc32ID );
+
+        if( it == m_deviceMap.end() )
+        {
+            std::cout << "notifyHealthEvent - unknown device: " << crc32Str << std::endl;
+            return HNMDL_RESULT_FAILURE;
+        }
+
+        device = &(it->second);
+
+        device->lockForUpdate();
+
+        if( device->getOwnershipState() != HNMDR_OWNER_STATE_MINE )
+        {
+            device->unlockForUpdate();
+            std::cout << "notifyHealthEvent - device not owned: " << crc32Str << std::endl;
+            return HNMDL_RESULT_FAILURE;
+        }
+
+        // Note the push so polling can back off to reconciliation
+        device->setLastHealthPush( time(NULL) );
+
+        device->unlockForUpdate();
+    }
+
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+        applyDeviceHealthBody( crc32ID, body, changed, generation );
+
+        // New health may reference strings that aren't cached yet
+        if( changed == true )
+            m_strRefCheckSet.insert( crc32ID );
+    }
+
+    if( changed == true )
+    {
+        std::cout << "Health Cache - Pushed health status changed: " << crc32Str << std::endl;
+
+        // Have the monitor check the string references
+        requestMonitorPass( 0 );
+
+        HNMDChangeEvent *event = new HNMDChangeEvent( HNMD_CHGEVT_TYPE_HEALTH );
+        event->setDevCRC32ID( crc32ID );
+        event->setGeneration( generation );
+        postChangeEvent( event );
+    }
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+uint64_t
+HNManagedDeviceArbiter::noteDeviceHealthChanged( uint32_t crc32ID, const std::string &body )
+{
+    // Caller must hold m_healthMutex
+    m_healthGeneration += 1;
 
-                if( jsSrvObj->has( "uri" ) )
-                {
-                    std::string uri = jsSrvObj->getValue<std::string>( "uri" );
-                    if( srvRef.getRootURIAsStr() != uri )
-                    {
-                        srvRef.setRootURIFromStr( uri );
-                        changed = true;
-                    }
-                }
+    m_deviceHealthGeneration[ crc32ID ] = m_healthGeneration;
+    m_deviceHealthBody[ crc32ID ] = body;
 
-            }
-            else
-            {
-                // Mandatory service type field missing, skip to next record
-                continue;
-            }
-            
-        }
+    m_cacheDirty = true;
 
-        // Done with updates to services provided list
-        if( device.completeSrvMappingUpdates() == true )
-            changed = true;
+    return m_healthGeneration;
+}
 
-        device.unlockForUpdate();
+HNMDL_RESULT_T
+HNManagedDeviceArbiter::applyDeviceHealthBody( uint32_t crc32ID, const std::string &body, bool &changed, uint64_t &generation )
+{
+    // Caller must hold m_healthMutex
+    changed = false;
 
-    }
-    catch( Poco::Exception ex )
+    // The first live report from a device replayed out of the
+    // cache file fills in the history and rollup the replay skipped.
+    bool claimed = ( m_cacheReplaySet.erase( crc32ID ) != 0 );
+
+    // Most reports repeat the previous one byte for byte, catch
+    // those before the health cache parses and walks the document.
+    uint64_t hash = computeBodyHash( body );
+
+    std::unordered_map< uint32_t, uint64_t >::iterator it = m_deviceHealthHash.find( crc32ID );
+    if( (it != m_deviceHealthHash.end()) && (it->second == hash) )
     {
-        // Done with updates to services provided list
-        device.abandonSrvMappingUpdates();
+        if( claimed == true )
+            recordHealthHistory( crc32ID, body );
 
-        device.unlockForUpdate();
+        return HNMDL_RESULT_SUCCESS;
+    }
 
-        std::cout << "HNMDMgmtCmd::updateDeviceServicesMappingInfo exception: " << ex.displayText() << std::endl;
-        // Request body was not understood
+    try
+    {
+        std::istringstream rs( body );
+        m_healthCache.updateDeviceHealth( crc32ID, rs, changed );
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "applyDeviceHealthBody - parse error: " << ex.displayText() << std::endl;
+        m_deviceHealthHash.erase( crc32ID );
         return HNMDL_RESULT_FAILURE;
     }
 
-    // If anything changed then update the by-service-type lookup maps
-    // in the arbiter as well.
+    m_deviceHealthHash[ crc32ID ] = hash;
+
     if( changed == true )
+        generation = noteDeviceHealthChanged( crc32ID, body );
+
+    if( (changed == true) || (claimed == true) )
+        recordHealthHistory( crc32ID, body );
+
+    return HNMDL_RESULT_SUCCESS;
+}
+
+// Load a health document saved by an earlier run.  Unlike a live
+// report it adds no history or rollup status, the device may not
+// be rediscovered.
+bool
+HNManagedDeviceArbiter::replayDeviceHealthBody( uint32_t crc32ID, const std::string &body, uint64_t generation )
+{
+    // Caller must hold m_healthMutex
+    bool changed = false;
+
+    try
     {
-        std::cout << "Device list service mappings changed." << std::endl;
-        rebuildSrvMappings();
+        std::istringstream rs( body );
+        m_healthCache.updateDeviceHealth( crc32ID, rs, changed );
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "replayDeviceHealthBody - parse error: " << ex.displayText() << std::endl;
+        return false;
     }
 
-    return HNMDL_RESULT_SUCCESS;
+    m_deviceHealthHash[ crc32ID ] = computeBodyHash( body );
+    m_deviceHealthGeneration[ crc32ID ] = generation;
+    m_deviceHealthBody[ crc32ID ] = body;
+
+    m_cacheReplaySet.insert( crc32ID );
+
+    return true;
 }
 
-void 
-HNManagedDeviceArbiter::rebuildSrvMappings()
+void
+HNManagedDeviceArbiter::recordHealthHistory( uint32_t crc32ID, const std::string &body )
 {
-    // Clear the old map since it will be rebuilt
-    m_servicesMap.clear();
-    
-    // Walk through each device
-    std::map< std::string, HNMDARecord >::iterator it;
-    for( it = m_deviceMap.begin(); it != m_deviceMap.end(); it++ )
+    time_t now = time(NULL);
+
+    // Only called for documents that changed, so the parse
+    // here is paid once per change rather than per poll.
+    try
     {
-        // Get a list of provided endpoint type strings
-        std::vector< std::string > srvTypes;
+        pjs::Parser parser;
+        pdy::Var varRoot = parser.parse( body );
 
-        std::cout << "rebuildSrvMapping - device: " << it->second.getCRC32IDStr() << std::endl;
+        pjs::Object::Ptr jsRoot = varRoot.extract< pjs::Object::Ptr >();
 
-        it->second.getSrvMappingTSList( srvTypes );
+        // Overall device status for the summary counts
+        if( jsRoot->has( "deviceStatus" ) )
+            m_healthRollup.setDeviceStatus( crc32ID, HNMDHealthHistory::statusFromStr( jsRoot->getValue<std::string>( "deviceStatus" ) ) );
 
-        std::cout << "rebuildSrvMapping - tscnt: " << srvTypes.size() << std::endl;
+        if( jsRoot->has( "rootComponent" ) == false )
+            return;
 
-        // Add this device to the srvMappings for each service it desires
-        for( std::vector< std::string >::iterator sit = srvTypes.begin(); sit != srvTypes.end(); sit++ )
-        {
-            std::cout << "rebuildSrvMapping - tsstr: " << *sit << std::endl;
+        pjs::Object::Ptr jsRootComp = jsRoot->getObject( "rootComponent" );
 
-            std::map< std::string, std::vector< std::string > >::iterator mit;
-            mit = m_servicesMap.find( *sit );
-            
-            if( mit != m_servicesMap.end() )
-            {
-                std::cout << "rebuildSrvMapping - add-new" << std::endl;
-                mit->second.push_back( it->second.getCRC32IDStr() );
-            }
-            else
-            {
-                std::cout << "rebuildSrvMapping - add-tail" << std::endl;
-                std::vector< std::string > tmpList;
-                tmpList.push_back( it->second.getCRC32IDStr() );
-                m_servicesMap.insert( std::pair< std::string, std::vector< std::string > >( *sit, tmpList ) );
-            }
-        }    
+        recordComponentHistory( crc32ID, &jsRootComp, now );
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "recordHealthHistory - parse error: " << ex.displayText() << std::endl;
     }
 }
 
 void
-HNManagedDeviceArbiter::reportSrvMappingInfoList( std::vector< HNMDServiceInfo > &srvList )
+HNManagedDeviceArbiter::recordComponentHistory( uint32_t crc32ID, void *jsCompPtr, time_t timestamp )
 {
-    // Start with a clean slate
-    srvList.clear();
-
-    std::cout << "buildSrvMappingInfoList - size: " << m_servicesMap.size() << std::endl;
+    // Cast the ptr-ptr back to a POCO JSON Ptr
+    pjs::Object::Ptr jsComp = *((pjs::Object::Ptr *) jsCompPtr);
 
-    // Walk through each service
-    std::map< std::string, std::vector< std::string > >::iterator it;
-    for( it = m_servicesMap.begin(); it != m_servicesMap.end(); it++ )
-    {
-        HNMDServiceInfo srvInfo;
+    if( jsComp.isNull() || (jsComp->has( "id" ) == false) )
+        return;
 
-        srvInfo.setSrvType( it->first );
+    std::string compID = jsComp->getValue<std::string>( "id" );
 
-        srvList.push_back( srvInfo );
+    // The propagated status includes the status of any children
+    std::string status;
+    if( jsComp->has( "propagatedStatus" ) )
+        status = jsComp->getValue<std::string>( "propagatedStatus" );
+    else if( jsComp->has( "setStatus" ) )
+        status = jsComp->getValue<std::string>( "setStatus" );
 
-        std::cout << "buildSrvMappingInfoList - size2: " << it->second.size() << std::endl;
+    m_healthHistory.recordComponentStatus( crc32ID, compID, status, timestamp );
 
-        for( std::vector< std::string >::iterator cit = it->second.begin(); cit != it->second.end(); cit++ )
-        {
-            std::map< std::string, HNMDARecord >::iterator dit = m_deviceMap.find( *cit );
+    if( jsComp->has( "children" ) == false )
+        return;
 
-            HNMDServiceDevRef devRef;
+    pjs::Array::Ptr jsChildArr = jsComp->getArray( "children" );
+    if( jsChildArr.isNull() )
+        return;
 
-            devRef.setDevName( dit->second.getName() );
-            devRef.setDevCRC32ID( dit->second.getCRC32IDStr() );
+    for( uint i = 0; i < jsChildArr->size(); i++ )
+    {
+        pjs::Object::Ptr jsChild = jsChildArr->getObject( i );
 
-            srvList.back().getDeviceListRef().push_back( devRef );
-        }
+        recordComponentHistory( crc32ID, &jsChild, timestamp );
     }
 }
 
 void
-HNManagedDeviceArbiter::reportSrvDefaultMappings( std::vector< HNMDServiceAssoc > &assocList )
+HNManagedDeviceArbiter::writeHealthSummaryAsJSON( std::ostream &os, uint64_t &generation )
 {
-    // Start with a clean slate
-    assocList.clear();
+    m_healthRollup.writeSummaryAsJSON( os, generation );
+}
 
-    std::cout << "reportSrvDefaultMappings - size: " << m_defaultMappings.size() << std::endl;
+void
+HNManagedDeviceArbiter::writeHealthHistoryAsJSON( std::ostream &os, uint32_t crc32ID, std::string compID, time_t start, time_t end )
+{
+    m_healthHistory.writeHistoryAsJSON( os, crc32ID, compID, start, end );
+}
 
-    // Walk through each service
-    std::map< std::string, HNMDSrvRef >::iterator it;
-    for( it = m_defaultMappings.begin(); it != m_defaultMappings.end(); it++ )
+bool
+HNManagedDeviceArbiter::getHealthChangesSince( uint64_t epoch, uint64_t since, std::string &deltaJSON )
+{
+    std::ostringstream os;
+    bool found = false;
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_healthMutex );
+
+    // A client with no history, one from another run, or one
+    // that still holds devices since dropped gets every device.
+    bool reset = ( (since == 0) || (epoch != m_healthEpoch) || (since > m_healthGeneration) || (since < m_healthResetGeneration) );
+
+    // The stored documents are the device's own health JSON,
+    // so they are spliced into the response as-is.  Clients
+    // pass the since token back on their next request.
+    os << "{\"epoch\":" << m_healthEpoch << ",\"generation\":" << m_healthGeneration;
+    os << ",\"since\":\"" << m_healthEpoch << "-" << m_healthGeneration << "\"";
+    os << ",\"reset\":" << (reset ? "true" : "false") << ",\"devices\":[";
+
+    for( std::unordered_map< uint32_t, uint64_t >::iterator it = m_deviceHealthGeneration.begin(); it != m_deviceHealthGeneration.end(); it++ )
     {
-        HNMDServiceAssoc srvAssoc;
+        if( (reset == false) && (it->second <= since) )
+            continue;
 
-        /*
-        if( it->)
+        if( found == true )
+            os << ",";
 
-        HNMDServiceInfo srvInfo;
+        os << m_deviceHealthBody[ it->first ];
+        found = true;
+    }
 
-        srvInfo.setSrvType( it->first );
+    os << "]}";
 
-        srvList.push_back( srvInfo );
+    deltaJSON = os.str();
 
-        std::cout << "buildSrvMappingInfoList - size2: " << it->second.size() << std::endl;
+    return ( (reset == true) || (found == true) );
+}
 
-        for( std::vector< std::string >::iterator cit = it->second.begin(); cit != it->second.end(); cit++ )
-        {
-            std::map< std::string, HNMDARecord >::iterator dit = m_deviceMap.find( *cit );
+// When the device's next health poll falls due, as seen at now
+time_t
+HNManagedDeviceArbiter::getHealthPollDueTime( HNMDARecord &device, time_t now )
+{
+    device.lockForUpdate();
 
-            HNMDServiceDevRef devRef;
+    time_t lastPush = device.getLastHealthPush();
+    time_t lastPoll = device.getLastHealthPoll();
+    time_t interval = device.getHealthPollInterval();
 
-            devRef.setDevName( dit->second.getName() );
-            devRef.setDevCRC32ID( dit->second.getCRC32IDStr() );
+    device.unlockForUpdate();
 
-            srvList.back().getDeviceListRef().push_back( devRef );
-        }
-        */
-    }
+    time_t due = lastPoll + interval;
+
+    // Devices that have pushed recently are only polled
+    // once per reconciliation interval.  If pushes stop
+    // arriving then fall back to regular polling.
+    if( (lastPush != 0) && ((now - lastPush) < HNMD_HEALTH_RECONCILE_SECS) )
+        due = std::min( lastPoll + HNMD_HEALTH_RECONCILE_SECS, std::max( due, lastPush + HNMD_HEALTH_RECONCILE_SECS ) );
+
+    return due;
 }
 
-void
-HNManagedDeviceArbiter::reportSrvDirectedMappings( std::vector< HNMDServiceAssoc > &assocList )
+// Seconds until the device needs its next health poll, at
+// least one so a poll held back by the budget isn't spun on.
+uint
+HNManagedDeviceArbiter::getHealthPollWaitSecs( HNMDARecord &device )
 {
-    assocList.clear();
+    time_t now = time(NULL);
+    time_t due = getHealthPollDueTime( device, now );
+
+    if( due <= now )
+        return 1;
+
+    return (uint)(due - now);
+}
+
+bool
+HNManagedDeviceArbiter::isHealthPollDue( HNMDARecord &device )
+{
+    time_t now = time(NULL);
+
+    bool due = ( now >= getHealthPollDueTime( device, now ) );
+
+    // Over the request budget, try again next pass.
+    if( (due == true) && (m_healthPollBudget.tryTake() == false) )
+    {
+        std::cout << "isHealthPollDue - deferred by poll budget: " << device.getCRC32IDStr() << std::endl;
+        return false;
+    }
+
+    return due;
 }
 
 void
-HNManagedDeviceArbiter::generateAllDeviceHealthReportAsJSON( std::ostream &bodyStream )
+HNManagedDeviceArbiter::adaptHealthPollInterval( HNMDARecord &device, bool success, bool changed )
 {
-    m_healthCache.generateAllDeviceHealthReportAsJSON( bodyStream );
+    device.lockForUpdate();
+
+    uint interval = device.getHealthPollInterval();
+
+    // Count a failed attempt as a poll, so an unreachable
+    // device is retried after the interval, not right away.
+    if( success == false )
+        device.setLastHealthPoll( time(NULL) );
+
+    // Anything interesting goes back to fast polling,
+    // quiet devices are polled less and less often.
+    if( (success == false) || (changed == true) )
+        interval = HNMD_HEALTH_POLL_MIN_SECS;
+    else
+        interval *= 2;
+
+    if( interval > m_healthPollMaxSecs )
+        interval = m_healthPollMaxSecs;
+
+    device.setHealthPollInterval( interval );
+
+    device.unlockForUpdate();
 }
 
 HNMDL_RESULT_T
@@ -2936,6 +5671,9 @@ HNManagedDeviceArbiter::updateDeviceHealthInfo( HNMDARecord &device, bool &chang
 
     // Put it into a uri data structure
     uri = uriStr;
+    std::string address = usePreferredConnection( device, uri.getHost() );
+    if( address.empty() == false )
+        uri.setHost( address );
     std::cout << "updateDeviceHealthInfo - uri: " << uri.toString() << std::endl;
 
     device.unlockForUpdate();
@@ -2946,23 +5684,57 @@ HNManagedDeviceArbiter::updateDeviceHealthInfo( HNMDARecord &device, bool &chang
     pns::HTTPClientSession session( uri.getHost(), uri.getPort() );
     pns::HTTPRequest request( pns::HTTPRequest::HTTP_GET, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
     pns::HTTPResponse response;
+    std::string body;
 
-    session.sendRequest( request );
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << "updateDeviceHealthInfo: " << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
+    struct timespec startTS;
+    clock_gettime( CLOCK_MONOTONIC, &startTS );
 
-    if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+    try
+    {
+        session.sendRequest( request );
+        std::istream& rs = session.receiveResponse( response );
+        std::cout << "updateDeviceHealthInfo: " << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
+
+        noteConnectionResult( device, address, true, startTS );
+
+        if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+        {
+            return HNMDL_RESULT_FAILURE;
+        }
+
+        // Keep the raw document so change deltas can be served
+        Poco::StreamCopier::copyToString( rs, body );
+    }
+    catch( Poco::Exception &ex )
     {
+        std::cout << "updateDeviceHealthInfo - request failed: " << ex.displayText() << std::endl;
+        noteConnectionResult( device, address, false, startTS );
         return HNMDL_RESULT_FAILURE;
     }
 
+    uint64_t generation = 0;
+
     device.lockForUpdate();
 
+    device.setLastHealthPoll( time(NULL) );
+
     // Track any updates
-    m_healthCache.updateDeviceHealth( device.getCRC32ID(), rs, changed );
+    {
+        std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+        applyDeviceHealthBody( device.getCRC32ID(), body, changed, generation );
+    }
 
     device.unlockForUpdate();
 
+    if( changed == true )
+    {
+        HNMDChangeEvent *event = new HNMDChangeEvent( HNMD_CHGEVT_TYPE_HEALTH );
+        event->setDevCRC32ID( device.getCRC32ID() );
+        event->setGeneration( generation );
+        postChangeEvent( event );
+    }
+
     if( changed == true )
     {
         std::cout << "Health Cache - Health status changed: \"" << device.getName() << "\" (" << device.getCRC32IDStr() << ")" << std::endl;
@@ -2970,7 +5742,6 @@ HNManagedDeviceArbiter::updateDeviceHealthInfo( HNMDARecord &device, bool &chang
     else
     {
         std::cout << "Health Cache - Health status did NOT change: \"" << device.getName() << "\" (" << device.getCRC32IDStr() << ")" << std::endl;
-        m_healthCache.debugPrintHealthReport();
     }
 
     return HNMDL_RESULT_SUCCESS;
@@ -2996,14 +5767,78 @@ HNManagedDeviceArbiter::updateDeviceStringReferences( HNMDARecord &device, bool
 
     // Put it into a uri data structure
     uri = uriStr;
+    std::string address = usePreferredConnection( device, uri.getHost() );
+    if( address.empty() == false )
+        uri.setHost( address );
     std::cout << "updateDeviceStringReferences - uri: " << uri.toString() << std::endl;
 
     // Build the outbound request json
     pjs::Object jsRoot;
     pjs::Array  jsStrRefs;
 
+    changed = false;
+
+    // Devices with the same type and version publish the same strings
+    HNMDFirmwareKey fwKey( device.getDeviceTypeSymbol(), device.getDeviceVersionSymbol() );
+    bool shareFW = ( (fwKey.first != NULL) && (fwKey.second != NULL) );
+
     std::vector< std::string > formatCodeList;
-    m_formatStrCache.getUncachedStrRefList( device.getCRC32ID(), formatCodeList );
+    {
+        std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+        m_formatStrCache.getUncachedStrRefList( device.getCRC32ID(), formatCodeList );
+
+        // Satisfy what we can from strings already fetched
+        // from another device running this firmware.
+        if( (shareFW == true) && (formatCodeList.empty() == false) )
+        {
+            std::vector< std::string > replayList;
+            std::vector< std::string > missingList;
+
+            m_firmwareStrMap[ fwKey ].planFetch( formatCodeList, replayList, missingList );
+
+            if( m_deviceFirmware.find( device.getCRC32ID() ) == m_deviceFirmware.end() )
+            {
+                m_deviceFirmware[ device.getCRC32ID() ] = fwKey;
+                m_cacheDirty = true;
+            }
+
+            for( std::vector< std::string >::iterator rit = replayList.begin(); rit != replayList.end(); rit++ )
+            {
+                bool replayChanged = false;
+
+                try
+                {
+                    std::istringstream rs( *rit );
+                    m_formatStrCache.updateStringDefinitions( device.getCRC32IDStr(), rs, replayChanged );
+                }
+                catch( Poco::Exception &ex )
+                {
+                    std::cout << "updateDeviceStringReferences - replay error: " << ex.displayText() << std::endl;
+                }
+
+                if( replayChanged == true )
+                    changed = true;
+            }
+
+            if( replayList.empty() == false )
+            {
+                std::cout << "updateDeviceStringReferences - shared strings applied: " << replayList.size() << "  still missing: " << missingList.size() << std::endl;
+                formatCodeList.clear();
+                m_formatStrCache.getUncachedStrRefList( device.getCRC32ID(), formatCodeList );
+            }
+        }
+
+        // Newly cached strings show up in the rendered report
+        if( changed == true )
+            m_healthGeneration += 1;
+    }
+
+    // Nothing to request if every referenced string is already cached
+    if( formatCodeList.empty() == true )
+    {
+        device.unlockForUpdate();
+        return HNMDL_RESULT_SUCCESS;
+    }
 
     for( std::vector< std::string >::iterator srit = formatCodeList.begin(); srit != formatCodeList.end(); srit++ )
     {
@@ -3023,30 +5858,99 @@ HNManagedDeviceArbiter::updateDeviceStringReferences( HNMDARecord &device, bool
     pns::HTTPClientSession session( uri.getHost(), uri.getPort() );
     pns::HTTPRequest request( pns::HTTPRequest::HTTP_PUT, uri.getPathAndQuery(), pns::HTTPMessage::HTTP_1_1 );
     pns::HTTPResponse response;
+    std::string body;
 
-    // Start request
-    std::ostream& os = session.sendRequest( request );
+    struct timespec startTS;
+    clock_gettime( CLOCK_MONOTONIC, &startTS );
 
-    // Render json request string to http payload.
-    try {
+    try
+    {
+        // Start request
+        std::ostream& os = session.sendRequest( request );
+
+        // Render json request string to http payload.
         pjs::Stringifier::stringify( jsRoot, os );
-    } catch( Poco::Exception& ex ) {
-        std::cerr << ex.displayText() << std::endl;
-    }    
 
-    // Wait for response data
-    std::istream& rs = session.receiveResponse( response );
-    std::cout << "updateDeviceStringReferences: " << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
+        // Wait for response data
+        std::istream& rs = session.receiveResponse( response );
+        std::cout << "updateDeviceStringReferences: " << response.getStatus() << " " << response.getReason() << " " << response.getContentLength() << std::endl;
 
-    if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+        noteConnectionResult( device, address, true, startTS );
+
+        if( response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK )
+        {
+            return HNMDL_RESULT_FAILURE;
+        }
+
+        // Keep the raw response so it can be shared
+        Poco::StreamCopier::copyToString( rs, body );
+    }
+    catch( Poco::Exception &ex )
     {
+        std::cout << "updateDeviceStringReferences - request failed: " << ex.displayText() << std::endl;
+        noteConnectionResult( device, address, false, startTS );
         return HNMDL_RESULT_FAILURE;
     }
 
+    HNMDL_RESULT_T result = HNMDL_RESULT_SUCCESS;
+
     device.lockForUpdate();
 
     // Track any updates
-    m_formatStrCache.updateStringDefinitions( device.getCRC32IDStr(), rs, changed );
+    {
+        std::lock_guard<std::mutex> healthGuard( m_healthMutex );
+
+        bool fetchChanged = false;
+        bool parsed = true;
+
+        // A malformed reply must not skip the unlock below
+        try
+        {
+            std::istringstream bs( body );
+            m_formatStrCache.updateStringDefinitions( device.getCRC32IDStr(), bs, fetchChanged );
+        }
+        catch( Poco::Exception &ex )
+        {
+            std::cout << "updateDeviceStringReferences - parse error: " << ex.displayText() << std::endl;
+            parsed = false;
+            result = HNMDL_RESULT_FAILURE;
+        }
+
+        // Only share bodies that parsed, and map only the codes the
+        // body actually resolved.  A code the firmware never defines
+        // would otherwise be replayed, refetched and stored again on
+        // every pass.
+        if( (shareFW == true) && (parsed == true) )
+        {
+            std::vector< std::string > stillMissing;
+            m_formatStrCache.getUncachedStrRefList( device.getCRC32ID(), stillMissing );
+
+            std::set< std::string > missingSet( stillMissing.begin(), stillMissing.end() );
+            std::vector< std::string > resolvedList;
+
+            for( std::vector< std::string >::iterator rit = formatCodeList.begin(); rit != formatCodeList.end(); rit++ )
+            {
+                if( missingSet.find( *rit ) == missingSet.end() )
+                    resolvedList.push_back( *rit );
+            }
+
+            if( m_firmwareStrMap[ fwKey ].addDefinitions( resolvedList, body ) == true )
+                m_cacheDirty = true;
+
+            if( m_deviceFirmware.find( device.getCRC32ID() ) == m_deviceFirmware.end() )
+            {
+                m_deviceFirmware[ device.getCRC32ID() ] = fwKey;
+                m_cacheDirty = true;
+            }
+        }
+
+        // Newly cached strings show up in the rendered report
+        if( fetchChanged == true )
+        {
+            m_healthGeneration += 1;
+            changed = true;
+        }
+    }
 
     device.unlockForUpdate();
 
@@ -3059,5 +5963,5 @@ HNManagedDeviceArbiter::updateDeviceStringReferences( HNMDARecord &device, bool
         std::cout << "String Cache - String Cache contents did NOT change: \"" << device.getName() << "\" (" << device.getCRC32IDStr() << ")" << std::endl;
     }
 
-    return HNMDL_RESULT_SUCCESS;
+    return result;
 }
@@ -1,17 +1,72 @@
 #ifndef _HN_MANAGED_DEVICE_ARBITER_H_
 #define _HN_MANAGED_DEVICE_ARBITER_H_
 
+#include <time.h>
+
 #include <string>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
 
 #include <hnode2/HNodeDevice.h>
 #include <hnode2/HNodeID.h>
 #include <hnode2/HNDeviceHealth.h>
+#include <hnode2/HNSigSyncQueue.h>
+
+#include "HNMDHealthHistory.h"
+#include "HNEventReactor.h"
 
 // Forward declaration for friend class below
 class HNMDARunner;
 
+// Seconds between saves of the health and string cache file
+// while its contents are changing.
+#define HNMD_CACHE_SAVE_SECS  30
+
+// Cache file layout version, bump when the layout changes
+#define HNMD_CACHE_FILE_MAGIC    0x434d4e48
+#define HNMD_CACHE_FILE_VERSION  1
+
+// Devices that push health events are still polled this often
+// so the cache can't drift if an event is lost.
+#define HNMD_HEALTH_RECONCILE_SECS  300
+
+// Health polling starts at the monitor period and backs off, while
+// reports are unchanged, up to a configurable maximum.
+#define HNMD_HEALTH_POLL_MIN_SECS      10
+#define HNMD_HEALTH_POLL_DEF_MAX_SECS  300
+
+// Default limit on health polls per second across all devices,
+// 0 for no limit.
+#define HNMD_HEALTH_POLL_DEF_BUDGET    5
+
+// Seconds a device reported as leaving the network is held in the
+// DISAPPEARING state, in case it comes back, before it is evicted.
+#define HNMD_DISAPPEAR_GRACE_SECS  120
+
+// Monitor wait time when nothing needs another pass
+#define HNMD_MONITOR_WAIT_NONE  ((uint) -1)
+
+// Address selection.  Addresses are ranked by smoothed round trip
+// time, with unmeasured addresses assumed to be this fast.
+#define HNMDAR_ADDR_DEFAULT_RTT_MS  50
+
+// Each consecutive failure adds this much to an address's rank, for
+// a holdoff that grows with the failure count up to a ceiling.
+#define HNMDAR_ADDR_FAIL_PENALTY_MS   1000
+#define HNMDAR_ADDR_FAIL_HOLDOFF_SECS 30
+#define HNMDAR_ADDR_FAIL_HOLDOFF_MAX  300
+
+// How long a device's chosen address is reused before the
+// addresses are ranked again.
+#define HNMDAR_ADDR_RESCORE_SECS  60
+
 typedef enum HNManagedDeviceListResultEnum
 {
     HNMDL_RESULT_SUCCESS,
@@ -96,15 +151,40 @@ class HNMDARAddress
         std::string        m_address;
         uint16_t           m_port;
 
+        // Set when the address is classified, false for addresses
+        // that can't be connected to (multicast, unparsable, or
+        // IPv6 link local without an interface scope).
+        bool               m_connectable;
+
+        // Smoothed round trip in milliseconds, 0 until measured
+        uint               m_rttMS;
+
+        // Consecutive failures, and when the last one happened
+        uint               m_failCnt;
+        time_t             m_lastFailTime;
+
     public:
         HNMDARAddress();
        ~HNMDARAddress();
 
+        // Classifies the address, keeps any existing score
         void setAddressInfo( std::string dnsName, std::string address, uint16_t port );
 
         HMDAR_ADDRTYPE_T  getType();
         std::string getTypeAsStr();
 
+        bool isConnectable();
+        bool isIPv6();
+
+        void recordSuccess( uint rttMS );
+        void recordFailure( time_t now );
+
+        uint getRTT();
+        uint getFailCount();
+
+        // Lower is better, UINT_MAX if the address is unusable
+        uint getScore( time_t now );
+
         std::string getDNSName();
         std::string getAddress();
         uint16_t    getPort();
@@ -114,6 +194,25 @@ class HNMDARAddress
         void debugPrint( uint offset );
 };
 
+// Strings that repeat across the fleet (device types, versions,
+// service types) are interned so each distinct value is stored once
+// and can be compared by pointer.  Symbols live for the life of the
+// process.
+typedef const std::string* HNMDSymbol;
+
+class HNMDSymbolTable
+{
+    public:
+        static HNMDSymbol intern( const std::string &value );
+        static HNMDSymbol lookup( const std::string &value );
+
+        static const std::string& str( HNMDSymbol symbol );
+
+    private:
+        static std::mutex s_tableMutex;
+        static std::unordered_set< std::string > s_table;
+};
+
 class HNMDServiceEndpoint
 {
     public:
@@ -124,6 +223,7 @@ class HNMDServiceEndpoint
 
         void setType( std::string type );
         std::string getType();
+        HNMDSymbol getTypeSymbol();
 
         void setVersion( std::string version );
         std::string getVersion();
@@ -137,13 +237,49 @@ class HNMDServiceEndpoint
         void debugPrint( uint offset );
 
     private:
-        std::string m_type;
-        std::string m_version;
+        HNMDSymbol  m_type;
+        HNMDSymbol  m_version;
         std::string m_rootURI;
 
         bool m_visited;
 };
 
+// Device REST endpoints that are polled for changes
+typedef enum HNMDARPollEndpointEnum
+{
+    HNMDAR_POLL_EP_INFO,
+    HNMDAR_POLL_EP_OWNER,
+    HNMDAR_POLL_EP_SRV_PROVIDED,
+    HNMDAR_POLL_EP_SRV_MAPPINGS,
+    HNMDAR_POLL_EP_COUNT
+}HNMDAR_POLL_EP_T;
+
+// Validators from the last successful poll of a device endpoint,
+// used to detect an unchanged response without parsing it.
+class HNMDARPollState
+{
+    public:
+        HNMDARPollState();
+       ~HNMDARPollState();
+
+        void clear();
+
+        void setValidators( std::string etag, std::string lastModified, uint64_t bodyHash );
+
+        std::string getETag();
+        std::string getLastModified();
+
+        bool hasBodyHash();
+        uint64_t getBodyHash();
+
+    private:
+        std::string m_etag;
+        std::string m_lastModified;
+
+        bool     m_hashValid;
+        uint64_t m_bodyHash;
+};
+
 typedef enum HNManagedDeviceRecordManagementStateEnum
 {
     HNMDR_MGMT_STATE_NOTSET,           // Default value
@@ -197,8 +333,8 @@ class HNMDARecord
 
         std::string m_discID;
         HNodeID     m_hnodeID;
-        std::string m_devType;
-        std::string m_devVersion;
+        HNMDSymbol  m_devType;
+        HNMDSymbol  m_devVersion;
         std::string m_instance;
         std::string m_name;
 
@@ -208,11 +344,11 @@ class HNMDARecord
 
         HNMDMgmtCmd m_mgmtCmd;
 
-        // A map of provided service endpoints
-        std::map< std::string, HNMDServiceEndpoint > m_srvMapProvided;
+        // A map of provided service endpoints, keyed by service type
+        std::unordered_map< HNMDSymbol, HNMDServiceEndpoint > m_srvMapProvided;
 
         // A map of desired service endpoints, and current mappings 
-        std::map< std::string, HNMDServiceEndpoint > m_srvMapDesired;
+        std::unordered_map< HNMDSymbol, HNMDServiceEndpoint > m_srvMapDesired;
 
         // Flags to indicate which cluster services
         // the device desires to use.
@@ -224,6 +360,36 @@ class HNMDARecord
         // A mutex for guarding record modifications.
         std::mutex *m_deviceMutex;
 
+        // Set when an inventory visible field changes, so the
+        // arbiter knows when its inventory snapshot is stale.
+        bool m_modified;
+
+        // Renewed from a global counter when the record is created
+        // and each time m_modified is collected, so a snapshot copy
+        // of the record can tell if it is current.
+        uint64_t m_revision;
+
+        // Conditional request state for each polled endpoint
+        HNMDARPollState m_pollState[ HNMDAR_POLL_EP_COUNT ];
+
+        // When health was last pushed by the device, and
+        // when it was last polled by the arbiter.
+        time_t m_lastHealthPush;
+        time_t m_lastHealthPoll;
+
+        // Current seconds between health polls
+        uint   m_healthPollInterval;
+
+        // When discovery reported the device as leaving
+        time_t m_disappearTime;
+
+        // Index into m_addrList of the best scoring address, or -1
+        // if it needs to be chosen again, and when it was chosen.
+        int    m_preferredAddrIdx;
+        time_t m_preferredAddrTime;
+
+        void selectPreferredAddress( time_t now );
+
         HNMDL_RESULT_T handleHealthComponentStrInstanceUpdate( void *jsSIPtr, HNFSInstance *strInstPtr, bool &changed );
         HNMDL_RESULT_T handleHealthComponentUpdate( void *jsCompPtr, HNDHComponent *compPtr, bool &changed );
         HNMDL_RESULT_T handleHealthComponentChildren( void *jsArrPtr, HNDHComponent *rootComponent, bool &changed );
@@ -246,21 +412,23 @@ class HNMDARecord
         void setInstance( std::string value );
         void setName( std::string value );
 
-        void addAddressInfo( std::string dnsName, std::string address, uint16_t port );
+        bool addAddressInfo( std::string dnsName, std::string address, uint16_t port );
+        void clearAddressList();
 
         void setOwnerID( HNodeID &ownerID );
         void clearOwnerID();
 
         void startSrvProviderUpdates();
         void abandonSrvProviderUpdates();
-        bool completeSrvProviderUpdates();
+        bool completeSrvProviderUpdates( std::vector< HNMDSymbol > &removedList );
         HNMDServiceEndpoint& updateSrvProvider( std::string srvType, bool &added );
 
         void getSrvProviderTSList( std::vector< std::string > &srvTypesList );
+        void getSrvProviderSymbolList( std::vector< HNMDSymbol > &srvSymbolList );
 
         void startSrvMappingUpdates();
         void abandonSrvMappingUpdates();
-        bool completeSrvMappingUpdates();
+        bool completeSrvMappingUpdates( std::vector< HNMDSymbol > &removedList );
         HNMDServiceEndpoint& updateSrvMapping( std::string srvType, bool &added );
 
         void getSrvMappingTSList( std::vector< std::string > &srvTypesList );
@@ -276,6 +444,8 @@ class HNMDARecord
         std::string getDiscoveryID();
         std::string getDeviceType();
         std::string getDeviceVersion();
+        HNMDSymbol getDeviceTypeSymbol();
+        HNMDSymbol getDeviceVersionSymbol();
         std::string getHNodeIDStr();
         std::string getInstance();
         std::string getName();
@@ -283,8 +453,32 @@ class HNMDARecord
         std::string getCRC32IDStr();
 
         void getAddressList( std::vector< HNMDARAddress > &addrList );
+        std::vector< HNMDARAddress >& getAddressListRef();
+
+        bool checkAndClearModified();
+        uint64_t getRevision();
+
+        // True for the steady state alternation between the health
+        // and string reference polls, which isn't a visible change.
+        static bool isHealthCycleStep( HNMDR_MGMT_STATE_T fromState, HNMDR_MGMT_STATE_T toState );
+
+        HNMDARPollState& getPollStateRef( HNMDAR_POLL_EP_T endpoint );
+        void clearPollStates();
+
+        void setLastHealthPush( time_t value );
+        time_t getLastHealthPush();
+
+        void setLastHealthPoll( time_t value );
+        time_t getLastHealthPoll();
+
+        void setHealthPollInterval( uint value );
+        uint getHealthPollInterval();
 
-        HNMDL_RESULT_T findPreferredConnection( HMDAR_ADDRTYPE_T preferredType, HNMDARAddress &connInfo );
+        void setDisappearTime( time_t value );
+        time_t getDisappearTime();
+
+        HNMDL_RESULT_T findPreferredConnection( HNMDARAddress &connInfo );
+        void recordConnectionResult( const std::string &address, bool success, uint rttMS );
         
         HNMDL_RESULT_T updateRecord( HNMDARecord &newRecord );
 
@@ -299,6 +493,38 @@ class HNMDARecord
         void debugPrint( uint offset );
 };
 
+typedef std::shared_ptr< HNMDARecord > HNMDARecordPtr;
+
+// An immutable, versioned copy of the device inventory.  The arbiter
+// rebuilds it only when a record has changed since the last build and
+// hands the same instance to every reader until then.  Record copies
+// that haven't changed are shared with the previous snapshot.  Readers
+// must treat the contained records as read-only.
+class HNMDInventorySnapshot
+{
+    public:
+        HNMDInventorySnapshot( uint64_t version, uint deviceCnt );
+       ~HNMDInventorySnapshot();
+
+        uint64_t getVersion();
+
+        void addDevice( HNMDARecordPtr device );
+
+        std::vector< HNMDARecordPtr >& getDeviceListRef();
+
+        HNMDARecord* findDevice( uint32_t crc32ID );
+
+    private:
+        uint64_t m_version;
+
+        std::vector< HNMDARecordPtr > m_deviceList;
+
+        // Map of CRC32ID to index in m_deviceList
+        std::unordered_map< uint32_t, uint > m_crc32Index;
+};
+
+typedef std::shared_ptr< HNMDInventorySnapshot > HNMDInventorySnapshotPtr;
+
 // Class for associating device and service
 class HNMDSrvRef
 {
@@ -382,7 +608,168 @@ class HNMDServiceAssoc
         std::string    m_desirerCRC32ID;
 };
 
-class HNManagedDeviceArbiter
+typedef enum HNMDChangeEventTypeEnum
+{
+    HNMD_CHGEVT_TYPE_NOTSET,
+    HNMD_CHGEVT_TYPE_DEVICE_ADDED,  // New device record created from discovery
+    HNMD_CHGEVT_TYPE_DEVICE_REMOVED,// Device reported as leaving the network
+    HNMD_CHGEVT_TYPE_MGMT_STATE,    // Device management state changed
+    HNMD_CHGEVT_TYPE_OWNERSHIP,     // Device ownership state changed
+    HNMD_CHGEVT_TYPE_HEALTH         // Cached health for a device changed
+}HNMD_CHGEVT_TYPE_T;
+
+// Posted by the arbiter to the management device
+// event loop when tracked state changes.
+class HNMDChangeEvent
+{
+    public:
+        HNMDChangeEvent( HNMD_CHGEVT_TYPE_T type );
+       ~HNMDChangeEvent();
+
+        HNMD_CHGEVT_TYPE_T getType();
+        std::string getTypeStr();
+
+        void setDevCRC32ID( uint32_t value );
+        uint32_t getDevCRC32ID();
+
+        void setGeneration( uint64_t value );
+        uint64_t getGeneration();
+
+        // New state string, or device type for additions
+        void setDetail( std::string value );
+        std::string getDetail();
+
+    private:
+        HNMD_CHGEVT_TYPE_T m_type;
+
+        uint32_t m_devCRC32ID;
+        uint64_t m_generation;
+
+        std::string m_detail;
+};
+
+// Limits a request rate, tokens refill continuously
+// up to a burst capacity.
+class HNMDTokenBucket
+{
+    public:
+        HNMDTokenBucket();
+       ~HNMDTokenBucket();
+
+        // A rate of 0 disables the limit
+        void setRate( uint perSecond, uint burst );
+
+        bool tryTake();
+
+    private:
+        double m_rate;
+        double m_capacity;
+        double m_tokens;
+
+        struct timespec m_lastRefill;
+};
+
+// Format string definitions fetched from one device, shared
+// with other devices running the same firmware.
+class HNMDFirmwareStrings
+{
+    public:
+        HNMDFirmwareStrings();
+       ~HNMDFirmwareStrings();
+
+        // Returns false, storing nothing, if the body defines
+        // no code that isn't already mapped.
+        bool addDefinitions( std::vector< std::string > &fmtCodeList, const std::string &body );
+
+        // Split requested codes into already fetched response
+        // bodies to replay and codes that still must be fetched.
+        void planFetch( std::vector< std::string > &fmtCodeList, std::vector< std::string > &replayList, std::vector< std::string > &missingList );
+
+        uint getBodyCount();
+        const std::string& getBody( uint index );
+        void getBodyCodes( uint index, std::vector< std::string > &fmtCodeList );
+
+    private:
+        // String definition responses as returned by a device
+        std::vector< std::string > m_bodyList;
+
+        // fmtCode to the index of the response that defined it
+        std::unordered_map< std::string, uint > m_codeMap;
+};
+
+// Count of devices in each health status for one rollup group
+class HNMDRollupCounts
+{
+    public:
+        HNMDRollupCounts();
+       ~HNMDRollupCounts();
+
+        void add( HNMDHH_STATUS_T status );
+        void remove( HNMDHH_STATUS_T status );
+
+        uint getCount( HNMDHH_STATUS_T status );
+        uint getTotal();
+
+        void writeAsJSON( std::ostream &os );
+
+    private:
+        uint m_counts[ HNMDHH_STATUS_COUNT ];
+};
+
+// The groups a device is currently counted in
+class HNMDRollupMember
+{
+    public:
+        HNMDRollupMember();
+       ~HNMDRollupMember();
+
+    private:
+        HNMDHH_STATUS_T m_status;
+        HNMDSymbol      m_devType;
+
+        std::unordered_set< HNMDSymbol > m_services;
+
+    friend class HNMDHealthRollup;
+};
+
+// Device health counts in total, per device type and per provided
+// service.  Each change only touches the groups of the device involved.
+class HNMDHealthRollup
+{
+    public:
+        HNMDHealthRollup();
+       ~HNMDHealthRollup();
+
+        void setDeviceType( uint32_t crc32ID, HNMDSymbol devType );
+        void setDeviceStatus( uint32_t crc32ID, HNMDHH_STATUS_T status );
+        void updateDeviceServices( uint32_t crc32ID, std::vector< HNMDSymbol > &addedList, std::vector< HNMDSymbol > &removedList );
+        void removeDevice( uint32_t crc32ID );
+
+        void writeSummaryAsJSON( std::ostream &os, uint64_t &generation );
+
+    private:
+        // Innermost lock, may be taken under any other arbiter lock.
+        std::mutex m_rollupMutex;
+
+        // Bumped on every count change
+        uint64_t m_generation;
+
+        HNMDRollupCounts m_total;
+
+        std::unordered_map< HNMDSymbol, HNMDRollupCounts > m_typeCounts;
+        std::unordered_map< HNMDSymbol, HNMDRollupCounts > m_serviceCounts;
+
+        std::unordered_map< uint32_t, HNMDRollupMember > m_memberMap;
+};
+
+// Device type and version symbols identifying a firmware
+typedef std::pair< HNMDSymbol, HNMDSymbol > HNMDFirmwareKey;
+
+// Index of service type to the CRC32IDs of devices that provide
+// (or desire) that service.
+typedef std::unordered_map< HNMDSymbol, std::unordered_set< uint32_t > > HNMDServiceIndex;
+
+class HNManagedDeviceArbiter : public HNEventHandler
 {
     private:
         // The management node device itself.
@@ -394,16 +781,36 @@ class HNManagedDeviceArbiter
         // A mutex over the device map modifications
         std::mutex m_mapMutex;
 
-        // A map of known hnode2 devices
-        std::map< std::string, HNMDARecord > m_deviceMap;
+        // A map of known hnode2 devices, keyed by numeric CRC32ID.
+        // Records are never moved once inserted, so pointers to
+        // them stay valid across later inserts.  Records are only
+        // erased by the monitor thread, between passes.
+        std::unordered_map< uint32_t, HNMDARecord > m_deviceMap;
+
+        // Guards the inventory version and snapshot pointer.
+        // Never held while aquiring m_mapMutex or a device lock.
+        std::mutex m_snapshotMutex;
 
-        // A map of serviceType to list of device CRC32ID for providers
-        std::map< std::string, std::vector< std::string > > m_providerMap;
+        // Bumped each time an inventory visible change is made
+        uint64_t m_inventoryVersion;
 
-        // A map of serviceType to list of device CRC32ID for desirers
-        std::map< std::string, std::vector< std::string > > m_servicesMap;
+        // The most recently built inventory snapshot
+        HNMDInventorySnapshotPtr m_inventorySnapshot;
 
-        // Map serviceType to default provider
+        // The record copies in that snapshot, by CRC32ID, reused by
+        // the next build for records whose revision hasn't moved.
+        // Guarded by m_mapMutex.
+        std::unordered_map< uint32_t, HNMDARecordPtr > m_snapshotRecordMap;
+
+        // Index of serviceType to device CRC32IDs for providers.
+        // Maintained incrementally under m_mapMutex.
+        HNMDServiceIndex m_providerMap;
+
+        // Index of serviceType to device CRC32IDs for desirers.
+        // Maintained incrementally under m_mapMutex.
+        HNMDServiceIndex m_servicesMap;
+
+        // Map serviceType to default provider, guarded by m_mapMutex
         std::map< std::string, HNMDSrvRef > m_defaultMappings;
 
         // Map service desired to service provider
@@ -415,6 +822,68 @@ class HNManagedDeviceArbiter
         // A cache of health data for devices
         HNHealthCache m_healthCache;
 
+        // Format string responses by firmware, so devices running the
+        // same firmware don't each have to be asked for the same strings.
+        std::map< HNMDFirmwareKey, HNMDFirmwareStrings > m_firmwareStrMap;
+
+        // Guards m_healthCache, m_formatStrCache and m_firmwareStrMap, which are updated
+        // from both the monitor thread and pushed health events.
+        // Never held while aquiring m_mapMutex or a device lock.
+        std::mutex m_healthMutex;
+
+        // Bumped each time the health or string caches change
+        uint64_t m_healthGeneration;
+
+        // Generations restart with the daemon, change tokens
+        // also carry when this run started.
+        uint64_t m_healthEpoch;
+
+        // Generation at which devices were last dropped from the
+        // health cache, clients from before it are sent a reset.
+        uint64_t m_healthResetGeneration;
+
+        // The last rendered cluster health report, and the
+        // health generation it was rendered from.
+        uint64_t    m_healthReportGeneration;
+        std::string m_healthReportJSON;
+
+        // Per device, the health generation of its last change
+        // and the health document from that change.
+        std::unordered_map< uint32_t, uint64_t > m_deviceHealthGeneration;
+        std::unordered_map< uint32_t, std::string > m_deviceHealthBody;
+
+        // Per device, hash of the last health document applied
+        // to the health cache.
+        std::unordered_map< uint32_t, uint64_t > m_deviceHealthHash;
+
+        // Status transitions of each device component over time
+        HNMDHealthHistory m_healthHistory;
+
+        // Device status counts for the health summary
+        HNMDHealthRollup m_healthRollup;
+
+        // Per device, the firmware whose strings it uses
+        std::unordered_map< uint32_t, HNMDFirmwareKey > m_deviceFirmware;
+
+        // Devices whose pushed health changed since their string
+        // references were last checked.  Guarded by m_healthMutex.
+        std::unordered_set< uint32_t > m_strRefCheckSet;
+
+        // Devices replayed from the cache file that have not yet
+        // reported live health, and when the file was loaded.
+        // Guarded by m_healthMutex.
+        std::unordered_set< uint32_t > m_cacheReplaySet;
+        time_t                         m_cacheLoadTime;
+
+        // Where the health and string caches are saved across
+        // restarts, and whether they changed since the last save.
+        std::string m_cacheFilePath;
+        bool        m_cacheDirty;
+        time_t      m_cacheSaveTime;
+
+        // Queue for change notifications to the management device
+        HNSigSyncQueue *m_changeQueue;
+
         // The thread helper
         void *thelp;
 
@@ -423,8 +892,56 @@ class HNManagedDeviceArbiter
 
         uint m_monitorWaitTime;
 
+        // When the next monitor pass is due.  Other threads that give
+        // the monitor work bring it forward, otherwise the monitor
+        // sleeps until its own next deadline.
+        std::mutex                            m_monitorMutex;
+        std::condition_variable               m_monitorCV;
+        bool                                  m_monitorDue;
+        std::chrono::steady_clock::time_point m_monitorDeadline;
+
+        // Set when hosted on a shared reactor, where the monitor
+        // passes are driven by a timer instead of our own thread.
+        HNEventReactor *m_reactor;
+        int             m_monitorTimerFD;
+
+        // Rotates where each monitor pass starts, so rate limited
+        // work is shared fairly between devices.
+        uint m_monitorPassCnt;
+
+        // Health poll back-off ceiling and global request budget
+        uint            m_healthPollMaxSecs;
+        HNMDTokenBucket m_healthPollBudget;
+
+        bool applyMonitorState( HNMDARecord &device, HNMDR_MGMT_STATE_T nextState );
         void setNextMonitorState( HNMDARecord &device, HNMDR_MGMT_STATE_T nextState, uint minValue );
 
+        void markInventoryChanged();
+
+        bool applyDiscoverAdd( HNMDARecord &record );
+        void applyDiscoverRemove( HNMDARecord &device );
+        void evictDisappearedDevices( time_t now );
+        void dropUnclaimedCacheDevices( time_t now );
+        void dropDeviceHealthState( uint32_t crc32ID );
+        uint64_t noteDeviceHealthRemoved();
+        void postHealthRemovedEvents( std::vector< uint32_t > &removedList, uint64_t generation );
+        void removeFromSrvIndex( HNMDServiceIndex &index, uint32_t crc32ID );
+        void debugPrintDeviceMap();
+
+        uint64_t noteDeviceHealthChanged( uint32_t crc32ID, const std::string &body );
+        HNMDL_RESULT_T applyDeviceHealthBody( uint32_t crc32ID, const std::string &body, bool &changed, uint64_t &generation );
+        bool replayDeviceHealthBody( uint32_t crc32ID, const std::string &body, uint64_t generation );
+        void recordHealthHistory( uint32_t crc32ID, const std::string &body );
+        void recordComponentHistory( uint32_t crc32ID, void *jsCompPtr, time_t timestamp );
+        void postChangeEvent( HNMDChangeEvent *event );
+        void postDeviceChangeEvent( HNMD_CHGEVT_TYPE_T type, uint32_t crc32ID, std::string detail );
+        void postDeviceTransitions( HNMDARecord &device, HNMDR_MGMT_STATE_T prevState, HNMDR_OWNER_STATE_T prevOwner );
+
+        std::string usePreferredConnection( HNMDARecord &device, const std::string &host );
+        void noteConnectionResult( HNMDARecord &device, const std::string &address, bool success, struct timespec &startTS );
+
+        HNMDL_RESULT_T fetchDeviceEndpoint( HNMDARecord &device, HNMDAR_POLL_EP_T endpoint, std::string path, std::string &body, bool &unchanged );
+
         HNMDL_RESULT_T updateDeviceOperationalInfo( HNMDARecord &device );
         HNMDL_RESULT_T updateDeviceOwnerInfo( HNMDARecord &device );
         HNMDL_RESULT_T sendDeviceClaimRequest( HNMDARecord &device );
@@ -436,17 +953,31 @@ class HNManagedDeviceArbiter
 
         HNMDL_RESULT_T executeDeviceMgmtCmd( HNMDARecord &device );
 
+        time_t getHealthPollDueTime( HNMDARecord &device, time_t now );
+        uint getHealthPollWaitSecs( HNMDARecord &device );
+        bool isHealthPollDue( HNMDARecord &device );
+        void adaptHealthPollInterval( HNMDARecord &device, bool success, bool changed );
+
         HNMDL_RESULT_T updateDeviceHealthInfo( HNMDARecord &device, bool &changed );
         HNMDL_RESULT_T updateDeviceStringReferences( HNMDARecord &device, bool &changed );
 
-        std::string getDeviceServiceProviderURI( std::string devCRC32ID, std::string srvType );
+        std::string getDeviceServiceProviderURI( uint32_t devCRC32ID, std::string srvType );
 
-        void rebuildSrvProviderMap();
-        void rebuildSrvMappings();
+        void applySrvIndexUpdates( HNMDServiceIndex &index, uint32_t crc32ID, std::vector< HNMDSymbol > &addedList, std::vector< HNMDSymbol > &removedList );
         
         void addMgmtDeviceProvidedSrv( HNMDARecord &record, std::string srvType, std::string version, std::string pathExt );
         void initMgmtDevice( HNMDARecord &record );
 
+        HNMDL_RESULT_T loadCacheFile();
+        HNMDL_RESULT_T saveCacheFile();
+        void checkCacheSave();
+
+        void initMonitor();
+        void runMonitorPass();
+
+        void requestMonitorPass( uint delaySecs );
+        bool waitForMonitorPass();
+
     protected:
         void runMonitoringLoop();
         void killMonitoringLoop();
@@ -456,33 +987,53 @@ class HNManagedDeviceArbiter
        ~HNManagedDeviceArbiter();
 
         HNMDL_RESULT_T notifyDiscoverAdd( HNMDARecord &record );
+        HNMDL_RESULT_T notifyDiscoverBatch( std::vector< HNMDARecord > &recordList, std::vector< std::string > &removedList );
         HNMDL_RESULT_T notifyDiscoverRemove( HNMDARecord &record );
 
         void setSelfInfo( HNodeDevice *mgmtDevice );
+        void setChangeNotifyQueue( HNSigSyncQueue *changeQueue );
+        void setCacheFilePath( std::string path );
+        void setHealthPollLimits( uint maxSecs, uint budgetPerSec );
+
+        void writeHealthHistoryAsJSON( std::ostream &os, uint32_t crc32ID, std::string compID, time_t start, time_t end );
+        void writeHealthSummaryAsJSON( std::ostream &os, uint64_t &generation );
         std::string getSelfHNodeIDStr();
         std::string getSelfCRC32IDStr();
         uint32_t getSelfCRC32ID();
 
         void start();
+        void startOnReactor( HNEventReactor *reactor );
         void shutdown();
 
-        HNMDL_RESULT_T getDeviceCopy( std::string crc32ID, HNMDARecord &device );
-        void getDeviceListCopy( std::vector< HNMDARecord > &deviceList );
+        virtual void handleReactorEvent( int fd, uint32_t events );
+
+        uint64_t getInventoryVersion();
+        HNMDInventorySnapshotPtr getInventorySnapshot();
+
+        static HNMDL_RESULT_T parseCRC32IDStr( std::string value, uint32_t &crc32ID );
+        static std::string formatCRC32IDStr( uint32_t crc32ID );
 
-        HNMDL_RESULT_T lookupConnectionInfo( std::string crc32ID, HMDAR_ADDRTYPE_T preferredType, HNMDARAddress &connInfo );
+        static uint64_t computeBodyHash( const std::string &body );
 
-        HNMDL_RESULT_T setDeviceMgmtCmdFromJSON( std::string crc32ID, std::istream *bodyStream );
+        HNMDL_RESULT_T lookupConnectionInfo( uint32_t crc32ID, HNMDARAddress &connInfo );
+        void reportConnectionResult( uint32_t crc32ID, const std::string &address, bool success, uint rttMS );
 
-        HNMDL_RESULT_T startDeviceMgmtCmd( std::string crc32ID );
+        HNMDL_RESULT_T setDeviceMgmtCmdFromJSON( uint32_t crc32ID, std::istream *bodyStream );
 
-        bool doesDeviceProvideService( std::string crc32ID, std::string srvType );
+        HNMDL_RESULT_T startDeviceMgmtCmd( uint32_t crc32ID );
+
+        bool doesDeviceProvideService( uint32_t crc32ID, std::string srvType );
 
         void reportSrvProviderInfoList( std::vector< HNMDServiceInfo > &srvList );
         void reportSrvMappingInfoList( std::vector< HNMDServiceInfo > &srvList );
         void reportSrvDefaultMappings( std::vector< HNMDServiceAssoc > &assocList );
         void reportSrvDirectedMappings( std::vector< HNMDServiceAssoc > &assocList );
 
+        HNMDL_RESULT_T notifyHealthEvent( const std::string &body );
+
         void generateAllDeviceHealthReportAsJSON( std::ostream &bodyStream );
+        void getClusterHealthReport( std::string &reportJSON, uint64_t &generation );
+        bool getHealthChangesSince( uint64_t epoch, uint64_t since, std::string &deltaJSON );
 
         void debugPrint();
 
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
 #include <sys/un.h>
 #include <sys/socket.h>
 
@@ -11,9 +12,12 @@
 
 #include <iostream>
 #include <sstream>
+#include <exception>
 
 #include <jwt.h>
 
+#include "Poco/Thread.h"
+#include "Poco/Runnable.h"
 #include <Poco/Util/ServerApplication.h>
 #include <Poco/Util/Option.h>
 #include <Poco/Util/OptionSet.h>
@@ -26,6 +30,7 @@
 
 #include <hnode2/HNodeDevice.h>
 
+#include "HNMDJson.h"
 #include "HNManagementDevice.h"
 
 using namespace Poco::Util;
@@ -37,6 +42,17 @@ namespace pdy = Poco::Dynamic;
 extern const std::string g_HNode2MgmtRest;
 extern const std::string g_HNode2ProxyMgmtAPI;
 
+// Milliseconds on a clock that doesn't jump with wall time
+static uint64_t
+monotonicMS()
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
 void 
 HNManagementDevice::defineOptions( OptionSet& options )
 {
@@ -51,6 +67,15 @@ HNManagementDevice::defineOptions( OptionSet& options )
     options.addOption(
               Option("instance", "", "Specify the instance name of this daemon.").required(false).repeatable(false).argument("name"));
 
+    options.addOption(
+              Option("health-poll-max", "", "Longest interval, in seconds, that health polling of an unchanging device backs off to.").required(false).repeatable(false).argument("seconds"));
+
+    options.addOption(
+              Option("health-poll-budget", "", "Limit on health polls per second across all devices, 0 for no limit.").required(false).repeatable(false).argument("count"));
+
+    options.addOption(
+              Option("reactor-threads", "", "Run the components on a shared pool of this many event threads, at least 3, or 0 for a thread per component.").required(false).repeatable(false).argument("count"));
+
 }
 
 void 
@@ -66,6 +91,21 @@ HNManagementDevice::handleOption( const std::string& name, const std::string& va
          _instancePresent = true;
          _instance = value;
     }
+    else if( "health-poll-max" == name )
+    {
+         _healthPollMaxPresent = true;
+         _healthPollMax = strtoul( value.c_str(), NULL, 0 );
+    }
+    else if( "health-poll-budget" == name )
+    {
+         _healthPollBudgetPresent = true;
+         _healthPollBudget = strtoul( value.c_str(), NULL, 0 );
+    }
+    else if( "reactor-threads" == name )
+    {
+         _reactorThreadsPresent = true;
+         _reactorThreads = strtoul( value.c_str(), NULL, 0 );
+    }
 }
 
 void 
@@ -135,6 +175,11 @@ HNManagementDevice::main( const std::vector<std::string>& args )
 
     m_hnodeDev.addEndpoint( hndEP );
  
+    // Resolve operation ids to the local handlers
+    initOpHandlerTable();
+
+    m_runEpoch = time(NULL);
+
     // Setup the decoder for proxy requests that will be handled locally.
     registerProxyEndpointsFromOpenAPI( g_HNode2ProxyMgmtAPI );
 
@@ -151,6 +196,21 @@ HNManagementDevice::main( const std::vector<std::string>& args )
 
     m_proxySeq.setParentResponseQueue( &m_proxyResponseQueue );
 
+    // Setup the queue for change notifications from the arbiter
+    m_arbiterEventQueue.init();
+
+    m_arbiter.setChangeNotifyQueue( &m_arbiterEventQueue );
+
+    // Apply any health polling limits from the command line
+    if( _healthPollMaxPresent || _healthPollBudgetPresent )
+    {
+        m_arbiter.setHealthPollLimits( _healthPollMaxPresent ? _healthPollMax : HNMD_HEALTH_POLL_DEF_MAX_SECS,
+                                       _healthPollBudgetPresent ? _healthPollBudget : HNMD_HEALTH_POLL_DEF_BUDGET );
+    }
+
+    // Health and string caches are kept across restarts
+    m_arbiter.setCacheFilePath( std::string( HNODE_MGMT_CACHE_DIR ) + "/" + HNODE_MGMT_DEVTYPE + "-" + m_instanceName + "-health.cache" );
+
     // Start accepting device notifications
     m_hnodeDev.setNotifySink( this );
 
@@ -158,67 +218,120 @@ HNManagementDevice::main( const std::vector<std::string>& args )
     m_hnodeDev.registerProvidedServiceExtension( "hnsrv-health-sink", "1.0.0", "health-sink" );
 
     // Initialize for event loop
-    epollFD = epoll_create1( 0 );
-    if( epollFD == -1 )
+    m_useReactor = ( _reactorThreadsPresent && (_reactorThreads > 0) );
+
+    if( m_useReactor == true )
     {
-        //log.error( "ERROR: Failure to create epoll event loop: %s", strerror(errno) );
-        return Application::EXIT_SOFTWARE;
-    }
+        if( _reactorThreads < HNMD_REACTOR_MIN_THREADS )
+        {
+            syslog( LOG_WARNING, "HNManagementDevice - Raising reactor threads from %u to %u", _reactorThreads, HNMD_REACTOR_MIN_THREADS );
+            _reactorThreads = HNMD_REACTOR_MIN_THREADS;
+        }
 
-    // Buffer where events are returned 
-    events = (struct epoll_event *) calloc( MAXEVENTS, sizeof event );
+        if( m_reactor.init() != HNER_RESULT_SUCCESS )
+            return Application::EXIT_SOFTWARE;
+    }
+    else
+    {
+        epollFD = epoll_create1( 0 );
+        if( epollFD == -1 )
+        {
+            //log.error( "ERROR: Failure to create epoll event loop: %s", strerror(errno) );
+            return Application::EXIT_SOFTWARE;
+        }
 
+        // Buffer where events are returned 
+        events = (struct epoll_event *) calloc( MAXEVENTS, sizeof event );
+    }
 
     // Start the HNode Device
     m_hnodeDev.start();
 
     // Start the Managed Device Arbiter
-    m_arbiter.start();
+    if( m_useReactor == true )
+        m_arbiter.startOnReactor( &m_reactor );
+    else
+        m_arbiter.start();
 
     // Start processing requests from the browser via SCGI
-    reqsink.start( m_instanceName );
+    if( m_useReactor == true )
+        reqsink.startOnReactor( m_instanceName, &m_reactor );
+    else
+        reqsink.start( m_instanceName );
 
     // Start the AvahiBrowser component
     avBrowser.start();
 
     // Start the proxy sequencer
-    m_proxySeq.start();
+    if( m_useReactor == true )
+        m_proxySeq.startOnReactor( &m_reactor );
+    else
+        m_proxySeq.start();
+
+    // Start the local request workers, they answer through the sink
+    m_workerPool.setParent( this );
+    m_workerPool.setResponseQueue( reqsink.getProxyResponseQueue() );
+    m_workerPool.start( HNMD_WORKER_THREAD_CNT );
 
     // Hook the browser into the event loop
-    int discoverFD = avBrowser.getEventQueue().getEventFD();
+    m_avBrowser  = &avBrowser;
+    m_discoverFD = avBrowser.getEventQueue().getEventFD();
    
-    if( addSocketToEPoll( discoverFD ) !=  HNMD_RESULT_SUCCESS )
+    if( addSocketToEPoll( m_discoverFD ) !=  HNMD_RESULT_SUCCESS )
     {
         return Application::EXIT_SOFTWARE;
     }
 
     // Hook the SCGI Request Queue into the event loop
-    int scgiQFD = m_scgiRequestQueue.getEventFD();
+    m_scgiQFD = m_scgiRequestQueue.getEventFD();
    
-    if( addSocketToEPoll( scgiQFD ) !=  HNMD_RESULT_SUCCESS )
+    if( addSocketToEPoll( m_scgiQFD ) !=  HNMD_RESULT_SUCCESS )
     {
         return Application::EXIT_SOFTWARE;
     }
 
     // Hook the Proxy Sequencer Response Queue into the event loop
-    int proxyQFD = m_proxyResponseQueue.getEventFD();
+    m_proxyQFD = m_proxyResponseQueue.getEventFD();
+   
+    if( addSocketToEPoll( m_proxyQFD ) !=  HNMD_RESULT_SUCCESS )
+    {
+        return Application::EXIT_SOFTWARE;
+    }
+
+    // Hook the Arbiter change notifications into the event loop
+    m_arbiterQFD = m_arbiterEventQueue.getEventFD();
    
-    if( addSocketToEPoll( proxyQFD ) !=  HNMD_RESULT_SUCCESS )
+    if( addSocketToEPoll( m_arbiterQFD ) !=  HNMD_RESULT_SUCCESS )
     {
         return Application::EXIT_SOFTWARE;
     }
 
+    if( m_useReactor == true )
+    {
+        // Deadlines are delivered as timer events
+        m_loopTimerFD = HNEventReactor::createTimer();
+
+        if( (m_loopTimerFD == -1) || (addSocketToEPoll( m_loopTimerFD ) != HNMD_RESULT_SUCCESS) )
+        {
+            return Application::EXIT_SOFTWARE;
+        }
+
+        // This thread is one of the reactor threads
+        m_reactor.start( _reactorThreads - 1 );
+        m_reactor.run();
+        m_reactor.stop();
+    }
+
     // The event loop 
     quit = false;
-    while( quit == false )
+    while( (m_useReactor == false) && (quit == false) )
     {
         int n;
         int i;
-        struct tm newtime;
-        time_t ltime;
 
-        // Check for events
-        n = epoll_wait( epollFD, events, MAXEVENTS, 2000 );
+        // Check for events, only waking on our own
+        // when something is due.
+        n = epoll_wait( epollFD, events, MAXEVENTS, getNextDeadlineMS() );
 
         // EPoll error
         if( n < 0 )
@@ -232,10 +345,9 @@ HNManagementDevice::main( const std::vector<std::string>& args )
             return Application::EXIT_SOFTWARE;
         }
 
-        std::cout << "HNManagementDevice::monitor wakeup" << std::endl;
-
         // Check these critical tasks everytime
         // the event loop wakes up.
+        checkDeadlines();
  
         // If it was a timeout then continue to next loop
         // skip socket related checks.
@@ -244,118 +356,196 @@ HNManagementDevice::main( const std::vector<std::string>& args )
 
         // Socket event
         for( i = 0; i < n; i++ )
-	    {
-            if( discoverFD == events[i].data.fd )
-            {
-                // Avahi Browser Event
-                while( avBrowser.getEventQueue().getPostedCnt() )
-                {
-                    HNAvahiBrowserEvent *event = (HNAvahiBrowserEvent*) avBrowser.getEventQueue().aquireRecord();
+            handleEvent( events[i].data.fd, events[i].events );
+    }
+
+    m_workerPool.shutdown();
+    m_proxySeq.shutdown();
+    avBrowser.shutdown();
+    reqsink.shutdown();
+    m_arbiter.shutdown();
+    //m_hnodeDev.shutdown();
 
-                    std::cout << "=== Discover Event ===" << std::endl;
-                    event->debugPrint();
+    waitForTerminationRequest();
 
-                    switch( event->getEventType() )
-                    {
-                        case HNAB_EVTYPE_ADD:
-                        {
-                            HNMDARecord notifyRec;
-
-                            notifyRec.setDiscoveryID( event->getName() );
-                            notifyRec.setDeviceType( event->getTxtValue( "devType" ) );
-                            notifyRec.setHNodeIDFromStr( event->getTxtValue( "hnodeID" ) );
-                            notifyRec.setName( event->getTxtValue( "name" ) );
-
-                            notifyRec.addAddressInfo( event->getHostname(), event->getAddress(), event->getPort() );
-
-                            HNMDL_RESULT_T result = m_arbiter.notifyDiscoverAdd( notifyRec );
-                            if( result != HNMDL_RESULT_SUCCESS )
-                            {
-                                // Note error
-                            }
-                        }
-                        break;
-
-                        case HNAB_EVTYPE_REMOVE:
-                        break;
-                    }
+    std::cout << "Server teminated" << std::endl;
 
-                    m_arbiter.debugPrint();
+    return Application::EXIT_OK;
+}
 
-                    avBrowser.getEventQueue().releaseRecord( event );
-                }
-            }
-            else if( scgiQFD == events[i].data.fd )
-            {
-                while( m_scgiRequestQueue.getPostedCnt() )
-                {
-                    HNSCGIRR *proxyRR = (HNSCGIRR *) m_scgiRequestQueue.aquireRecord();
 
-                    std::cout << "HNManagementDevice::Received proxy request" << std::endl;
+void
+HNManagementDevice::handleEvent( int fd, uint32_t events )
+{
+    if( m_discoverFD == fd )
+    {
+        // Avahi Browser Event
+        while( m_avBrowser->getEventQueue().getPostedCnt() )
+        {
+            HNAvahiBrowserEvent *event = (HNAvahiBrowserEvent*) m_avBrowser->getEventQueue().aquireRecord();
 
-                    HNProxyTicket *proxyTicket = checkForProxyRequest( proxyRR );
+            std::cout << "=== Discover Event ===" << std::endl;
+            event->debugPrint();
 
-                    if( proxyTicket != NULL )
-                    {
-                        std::cout << "Proxy request to device: " << proxyTicket->getCRC32ID() << std::endl;
-                        m_proxySeq.getRequestQueue()->postRecord( proxyTicket );
-                        continue;
-                    }
+            // Bursts of events are coalesced and
+            // applied to the arbiter together.
+            queueDiscoveryEvent( event );
 
-                    HNOperationData *opData = mapProxyRequest( proxyRR );
+            m_avBrowser->getEventQueue().releaseRecord( event );
+        }
+    }
+    else if( m_scgiQFD == fd )
+    {
+        while( m_scgiRequestQueue.getPostedCnt() )
+        {
+            HNSCGIRR *proxyRR = (HNSCGIRR *) m_scgiRequestQueue.aquireRecord();
 
-                    if( opData == NULL )
-                    {
-                        proxyRR->getRspMsg().configAsNotFound();
-                        reqsink.getProxyResponseQueue()->postRecord( proxyRR );
-                        continue;
-                    }
+            std::cout << "HNManagementDevice::Received proxy request" << std::endl;
 
-                    std::cout << "Local management device request: " << opData->getOpID() << std::endl;
-                    handleLocalSCGIRequest( proxyRR, opData );
-                    reqsink.getProxyResponseQueue()->postRecord( proxyRR );
-                    delete opData;
-                }
+            // Match the request once, the result is used for
+            // both proxy and local handling.
+            HNMgmtRouteMatch route;
+            m_routeTrie.match( proxyRR->getReqMsg().getMethod(), proxyRR->getReqMsg().getURI(), route );
+
+            HNProxyTicket *proxyTicket = checkForProxyRequest( proxyRR, route );
+
+            if( proxyTicket != NULL )
+            {
+                std::cout << "Proxy request to device: " << proxyTicket->getCRC32ID() << std::endl;
+                m_proxySeq.getRequestQueue()->postRecord( proxyTicket );
+                continue;
             }
-            else if( proxyQFD == events[i].data.fd )
+
+            HNOperationData *opData = mapProxyRequest( proxyRR, route );
+
+            if( opData == NULL )
             {
-                while( m_proxyResponseQueue.getPostedCnt() )
-                {
-                    HNProxyTicket *proxyTicket = (HNProxyTicket *) m_proxyResponseQueue.aquireRecord();
+                proxyRR->getRspMsg().configAsNotFound();
+                reqsink.getProxyResponseQueue()->postRecord( proxyRR );
+                continue;
+            }
+
+            std::cout << "Local management device request: " << opData->getOpID() << std::endl;
+
+            HNMD_OPCODE_T opcode = m_proxyOpcodeList[ route.getRouteIndex() ];
+
+            // Requests that are held open, like health change polls
+            // and event streams, stay with the event loop and post
+            // their own response.  Everything else goes to a worker.
+            if( (opcode < HNMD_OPCODE_COUNT) && (m_opTable[ opcode ].isDeferred() == true) )
+            {
+                handleLocalSCGIRequest( proxyRR, opData, opcode );
+                delete opData;
+                continue;
+            }
+
+            m_workerPool.queueRequest( proxyRR, opData, opcode );
+        }
+    }
+    else if( m_proxyQFD == fd )
+    {
+        while( m_proxyResponseQueue.getPostedCnt() )
+        {
+            HNProxyTicket *proxyTicket = (HNProxyTicket *) m_proxyResponseQueue.aquireRecord();
 
-                    std::cout << "HNManagementDevice::Received proxy response" << std::endl;
+            std::cout << "HNManagementDevice::Received proxy response" << std::endl;
 
-                    HNSCGIRR *proxyRR = proxyTicket->getRR();
+            HNSCGIRR *proxyRR = proxyTicket->getRR();
 
-                    std::cout << "Deleting HNProxyTicket: " << proxyTicket << std::endl;
+            // Feed the outcome back into the device's address selection
+            m_arbiter.reportConnectionResult( proxyTicket->getCRC32Val(), proxyTicket->getAddress(), proxyTicket->isSuccess(), proxyTicket->getRTT() );
 
-                    delete proxyTicket;
+            if( proxyTicket->isSuccess() == false )
+                proxyRR->getRspMsg().configAsBadGateway();
 
-                    reqsink.getProxyResponseQueue()->postRecord( proxyRR );
-                }
-            }            
+            std::cout << "Deleting HNProxyTicket: " << proxyTicket << std::endl;
+
+            delete proxyTicket;
+
+            reqsink.getProxyResponseQueue()->postRecord( proxyRR );
         }
     }
+    else if( m_arbiterQFD == fd )
+    {
+        while( m_arbiterEventQueue.getPostedCnt() )
+        {
+            HNMDChangeEvent *event = (HNMDChangeEvent *) m_arbiterEventQueue.aquireRecord();
 
-    m_proxySeq.shutdown();
-    avBrowser.shutdown();
-    reqsink.shutdown();
-    m_arbiter.shutdown();
-    //m_hnodeDev.shutdown();
+            publishChangeEvent( event );
 
-    waitForTerminationRequest();
+            delete event;
+        }
 
-    std::cout << "Server teminated" << std::endl;
+        // Release any held requests that now have changes
+        checkPendingHealthPolls();
+    }
+}
 
-    return Application::EXIT_OK;
+void
+HNManagementDevice::checkDeadlines()
+{
+    // Answer any held health change requests that have timed out
+    checkPendingHealthPolls();
+
+    // Apply coalesced discovery events once their window closes
+    checkDiscoveryBatch( monotonicMS() );
+}
+
+int
+HNManagementDevice::getNextDeadlineMS()
+{
+    int64_t waitMS = -1;
+
+    if( isDiscoveryBatchPending() == true )
+    {
+        uint64_t now = monotonicMS();
+        waitMS = (m_discoveryBatchDeadline > now) ? (int64_t)(m_discoveryBatchDeadline - now) : 0;
+    }
+
+    // Health poll deadlines are whole seconds, so this never
+    // wakes before now reaches the deadline.
+    time_t now = time(NULL);
+
+    std::lock_guard<std::mutex> guard( m_pendingPollMutex );
+
+    for( std::list< HNMDPendingHealthPoll >::iterator it = m_pendingHealthPolls.begin(); it != m_pendingHealthPolls.end(); it++ )
+    {
+        int64_t pollMS = (it->getDeadline() > now) ? ((int64_t)(it->getDeadline() - now) * 1000) : 0;
+
+        if( (waitMS < 0) || (pollMS < waitMS) )
+            waitMS = pollMS;
+    }
+
+    return (int) waitMS;
 }
 
+void
+HNManagementDevice::handleReactorEvent( int fd, uint32_t events )
+{
+    if( fd == m_loopTimerFD )
+        HNEventReactor::clearTimer( m_loopTimerFD );
+    else
+        handleEvent( fd, events );
+
+    checkDeadlines();
+
+    // Arm for whatever is due next, the timer stays idle otherwise
+    int waitMS = getNextDeadlineMS();
+
+    if( waitMS < 0 )
+        HNEventReactor::disarmTimer( m_loopTimerFD );
+    else
+        HNEventReactor::armTimer( m_loopTimerFD, waitMS );
+}
 
 HNMD_RESULT_T
 HNManagementDevice::addSocketToEPoll( int sfd )
 {
     int flags, s;
 
+    if( m_useReactor == true )
+        return (m_reactor.addFD( sfd, this ) == HNER_RESULT_SUCCESS) ? HNMD_RESULT_SUCCESS : HNMD_RESULT_FAILURE;
+
     flags = fcntl( sfd, F_GETFL, 0 );
     if( flags == -1 )
     {
@@ -387,6 +577,9 @@ HNManagementDevice::removeSocketFromEPoll( int sfd )
 {
     int s;
 
+    if( m_useReactor == true )
+        return (m_reactor.removeFD( sfd ) == HNER_RESULT_SUCCESS) ? HNMD_RESULT_SUCCESS : HNMD_RESULT_FAILURE;
+
     s = epoll_ctl( epollFD, EPOLL_CTL_DEL, sfd, NULL );
     if( s == -1 )
     {
@@ -485,47 +678,57 @@ HNManagementDevice::dispatchEP( HNodeDevice *parent, HNOperationData *opData )
     std::cout << "  opID: " << opData->getOpID() << std::endl;
     //std::cout << "  thread: " << std::this_thread::get_id() << std::endl;
 
-    std::string opID = opData->getOpID();
-
-    // GET "/hnode2/mgmt/status"
-    if( "getStatus" == opID )
-    {
-        //action.setType( HNID_AR_TYPE_IRRSTATUS );
-    }
-    else if( "postHealthEvent" == opID )
+    switch( lookupOpcode( opData->getOpID() ) )
     {
-        std::istream& rs = opData->requestBody();
-        std::string body;
-        Poco::StreamCopier::copyToString( rs, body );
+        // GET "/hnode2/mgmt/status"
+        case HNMD_OPCODE_GET_STATUS:
+            //action.setType( HNID_AR_TYPE_IRRSTATUS );
+        break;
+
+        case HNMD_OPCODE_POST_HEALTH_EVENT:
+        {
+            std::istream& rs = opData->requestBody();
+            std::string body;
+            Poco::StreamCopier::copyToString( rs, body );
         
-        std::cout << "=== Post Health Event Data ===" << std::endl;
-        std::cout << body << std::endl;
+            std::cout << "=== Post Health Event Data ===" << std::endl;
 
-        // Object was created return info
-        opData->responseSetCreated( "he1" );
-        opData->responseSetStatusAndReason( HNR_HTTP_CREATED );
+            // Feed the event straight into the health cache
+            if( m_arbiter.notifyHealthEvent( body ) != HNMDL_RESULT_SUCCESS )
+            {
+                opData->responseSetStatusAndReason( HNR_HTTP_BAD_REQUEST );
+                opData->responseSend();
+                return;
+            }
 
-        //action.setType( HNID_AR_TYPE_IRRSTATUS );
-    }
-    else if( "postLogEvent" == opID )
-    {
-        std::istream& rs = opData->requestBody();
-        std::string body;
-        Poco::StreamCopier::copyToString( rs, body );
+            // Object was created return info
+            opData->responseSetCreated( "he1" );
+            opData->responseSetStatusAndReason( HNR_HTTP_CREATED );
+
+            //action.setType( HNID_AR_TYPE_IRRSTATUS );
+        }
+        break;
+
+        case HNMD_OPCODE_POST_LOG_EVENT:
+        {
+            std::istream& rs = opData->requestBody();
+            std::string body;
+            Poco::StreamCopier::copyToString( rs, body );
         
-        std::cout << "=== Post Log Event Data ===" << std::endl;
-        std::cout << body << std::endl;
+            std::cout << "=== Post Log Event Data ===" << std::endl;
+            std::cout << body << std::endl;
 
-        // Object was created return info
-        opData->responseSetCreated( "le1" );
-        opData->responseSetStatusAndReason( HNR_HTTP_CREATED );      
-        //action.setType( HNID_AR_TYPE_IRRSTATUS );
-    }
-    else
-    {
-        // Send back not implemented
-        opData->responseSetStatusAndReason( HNR_HTTP_NOT_IMPLEMENTED );
-        opData->responseSend();
+            // Object was created return info
+            opData->responseSetCreated( "le1" );
+            opData->responseSetStatusAndReason( HNR_HTTP_CREATED );      
+            //action.setType( HNID_AR_TYPE_IRRSTATUS );
+        }
+        break;
+
+        default:
+            // Send back not implemented
+            opData->responseSetStatusAndReason( HNR_HTTP_NOT_IMPLEMENTED );
+            opData->responseSend();
         return;
     }
 
@@ -558,6 +761,10 @@ HNManagementDevice::registerProxyEndpointsFromOpenAPI( std::string openAPIJson )
 {
     HNRestPath *path;
 
+    // Requests of the form /hnode2/mgmt/device-proxy/{crc32ID}/*
+    // are forwarded to the device.
+    m_routeTrie.addPrefixRoute( "/hnode2/mgmt/device-proxy/{crc32ID}", "deviceProxy" );
+
     // Invoke the json parser
     try
     {
@@ -610,6 +817,11 @@ HNManagementDevice::registerProxyEndpointsFromOpenAPI( std::string openAPIJson )
                 // http factory class
                 path = addProxyPath( "HNManagementDevice", opID, NULL );
 
+                // Resolve the handler now rather than per request
+                m_proxyOpcodeList.push_back( lookupOpcode( opID ) );
+                if( m_proxyOpcodeList.back() == HNMD_OPCODE_NONE )
+                    std::cout << "WARNING: No local handler for opID: " << opID << std::endl;
+
                 // Record the method for this specific path record
                 path->setMethod( mit->first );
 
@@ -631,6 +843,9 @@ HNManagementDevice::registerProxyEndpointsFromOpenAPI( std::string openAPIJson )
                         path->addPathElement( HNRPE_TYPE_PATH, *sit );
                     }
                 } 
+
+                // Add the path to the match trie as well
+                m_routeTrie.addRoute( mit->first, pit->first, opID, (m_proxyPathList.size() - 1) );
             }
         }
 
@@ -643,31 +858,28 @@ HNManagementDevice::registerProxyEndpointsFromOpenAPI( std::string openAPIJson )
 }
 
 HNProxyTicket* 
-HNManagementDevice::checkForProxyRequest( HNSCGIRR *reqRR )
+HNManagementDevice::checkForProxyRequest( HNSCGIRR *reqRR, HNMgmtRouteMatch &route )
 {
     std::vector< std::string > pathStrs;
-    Poco::URI uri( reqRR->getReqMsg().getURI() );
 
     std::cout << "checkForProxyRequest - method: " << reqRR->getReqMsg().getMethod() << std::endl;
-    std::cout << "checkForProxyRequest - URI: " << uri.toString() << std::endl;
-
-    // Break the uri into segments
-    uri.getPathSegments( pathStrs );
+    std::cout << "checkForProxyRequest - URI: " << reqRR->getReqMsg().getURI() << std::endl;
 
-    // Make sure we have at least the correct number of segments
-    // to represent a device proxy request.  Then check that
-    // url is of the form /hnode2/mgmt/device-proxy/{crc32ID}/*
-    if( pathStrs.size() < 4 )
-        return NULL;
-
-    if( (pathStrs[0] != "hnode2") || (pathStrs[1] != "mgmt") || (pathStrs[2] != "device-proxy") )
+    // The trie matched the url against the
+    // /hnode2/mgmt/device-proxy/{crc32ID}/* prefix.
+    if( route.getKind() != HNMRT_KIND_PREFIX )
         return NULL;
 
     // Grab the CRC32ID and try to look up the device. 
-    std::string crc32ID = pathStrs[3];
+    std::string crc32ID;
+    uint32_t    crc32Val = 0;
+
+    route.getParam( "crc32ID", crc32ID );
 
     HNMDARAddress dcInfo;
-    HNMDL_RESULT_T result = m_arbiter.lookupConnectionInfo( crc32ID, HMDAR_ADDRTYPE_IPV4, dcInfo );
+    HNMDL_RESULT_T result = m_arbiter.parseCRC32IDStr( crc32ID, crc32Val );
+    if( result == HNMDL_RESULT_SUCCESS )
+        result = m_arbiter.lookupConnectionInfo( crc32Val, dcInfo );
     if( result != HNMDL_RESULT_SUCCESS )
     {
         std::cout << "WARNING: Proxy failed to lookup device: " << crc32ID << std::endl;
@@ -679,37 +891,33 @@ HNManagementDevice::checkForProxyRequest( HNSCGIRR *reqRR )
     std::cout << "Allocated new HNProxyTicket: " << rtnTicket << std::endl;
 
     rtnTicket->setCRC32ID( crc32ID );
+    rtnTicket->setCRC32Val( crc32Val );
     rtnTicket->setAddress( dcInfo.getAddress() );
     rtnTicket->setPort( dcInfo.getPort() );
-    rtnTicket->setQueryStr( uri.getRawQuery() );
+    rtnTicket->setQueryStr( route.getRawQuery() );
 
     // Extract the remainder of the path for 
     // use when constructing the proxy request
-    pathStrs.erase( pathStrs.begin(), pathStrs.begin()+4);
+    route.getRemainder( pathStrs );
     rtnTicket->buildProxyPath( pathStrs );
 
     return rtnTicket;
 }
 
 HNOperationData*
-HNManagementDevice::mapProxyRequest( HNSCGIRR *reqRR )
+HNManagementDevice::mapProxyRequest( HNSCGIRR *reqRR, HNMgmtRouteMatch &route )
 {
     HNOperationData *opData = NULL;
-    std::vector< std::string > pathStrs;
-
-    Poco::URI uri( reqRR->getReqMsg().getURI() );
 
     std::cout << "mapProxyRequest - method: " << reqRR->getReqMsg().getMethod() << std::endl;
-    std::cout << "mapProxyRequest - URI: " << uri.toString() << std::endl;
-
-    // Break the uri into segments
-    uri.getPathSegments( pathStrs );
+    std::cout << "mapProxyRequest - URI: " << reqRR->getReqMsg().getURI() << std::endl;
 
     // Check it this is a local request that the managment node should handle
-    for( std::vector< HNRestPath >::iterator it = m_proxyPathList.begin(); it != m_proxyPathList.end(); it++ )
+    if( (route.getKind() == HNMRT_KIND_LOCAL) && (route.getRouteIndex() < m_proxyPathList.size()) )
     {
-        std::cout << "Check handler: " << it->getOpID() << std::endl;
-        opData = it->checkForHandler( reqRR->getReqMsg().getMethod(), pathStrs );
+        // Only the matched path is consulted, to build up the
+        // operation data and its parameters.
+        opData = m_proxyPathList[ route.getRouteIndex() ].checkForHandler( reqRR->getReqMsg().getMethod(), route.getSegmentsRef() );
         if( opData != NULL )
             return opData;
     }
@@ -802,493 +1010,1256 @@ HNManagementDevice::generateJWT( std::string username, uint duration, std::strin
     return HNMD_RESULT_SUCCESS;
 }
 
-void 
-HNManagementDevice::handleLocalSCGIRequest( HNSCGIRR *reqRR, HNOperationData *opData )
+// Each thread reuses its own render buffer, so its capacity
+// settles at the largest response it has rendered.
+static std::string&
+localRenderBuffer()
 {
-    std::cout << "HNManagementDevice::handleLocalProxyRequest() - entry" << std::endl;
-    std::cout << "  dispatchID: " << opData->getDispatchID() << std::endl;
-    std::cout << "  opID: " << opData->getOpID() << std::endl;
+    static thread_local std::string buffer;
+
+    buffer.clear();
+    return buffer;
+}
 
-    std::string opID = opData->getOpID();
+static void
+writeAddressListJSON( HNMDJsonWriter &jw, std::vector< HNMDARAddress > &addrList )
+{
+    jw.beginArray();
 
-    // POST /hnode2/mgmt/auth
-    if( "createAuthToken" == opID )
+    for( std::vector< HNMDARAddress >::iterator ait = addrList.begin(); ait != addrList.end(); ait++ )
     {
-        std::cout << "== createAuthToken request ==" << std::endl;
+        jw.beginObject();
+        jw.field( "type", ait->getTypeAsStr() );
+        jw.field( "dnsName", ait->getDNSName() );
+        jw.field( "address", ait->getAddress() );
+        jw.field( "port", ait->getPort() );
+        jw.endObject();
+    }
 
-        // Pull the content portion into the local buffer.
-        reqRR->getReqMsg().readContentToLocal();
-       
-        std::string body;
-        Poco::StreamCopier::copyToString( reqRR->getReqMsg().getLocalInputStream(), body );
-        std::cout << body << std::endl;
-
-        std::string jwtStr;
-        HNMD_RESULT_T result = generateJWT( "admin", (12*60*60), jwtStr );
-        switch( result )
-        {
-            case HNMD_RESULT_NOT_AUTHORIZED:
-#if 0           
-            reqRR->getRspMsg().configAsInternalServerError();
-            return;
-#endif              
-            break;
+    jw.endArray();
+}
 
-            case HNMD_RESULT_SUCCESS:
-            {
-                reqRR->getRspMsg().setStatusCode(200);
-                reqRR->getRspMsg().setReason("OK");
-                reqRR->getRspMsg().setContentType("application/json");
-
-                std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
-                pjs::Object jsRoot;
-
-                jsRoot.set( "username", "admin" );
-                jsRoot.set( "accessToken", jwtStr );
-
-                pjs::Array jsRoles;
-                jsRoles.add("ROLE_ADMIN");
-                jsRoot.set( "roles", jsRoles );
-
-                // Render into a json string.
-                try {
-                    pjs::Stringifier::stringify( jsRoot, msg );
-                } catch( ... ) {
-                    // Send back not implemented
-                    reqRR->getRspMsg().configAsInternalServerError();
-                    return;
-                }
+static void
+writeServiceInfoListJSON( HNMDJsonWriter &jw, std::vector< HNMDServiceInfo > &srvInfoList )
+{
+    jw.beginObject();
 
-                reqRR->getRspMsg().finalizeLocalContent();
-                return;
-            }
-            break;
+    for( std::vector< HNMDServiceInfo >::iterator sit = srvInfoList.begin(); sit != srvInfoList.end(); sit++ )
+    {
+        jw.key( sit->getSrvType() );
+        jw.beginArray();
 
-            default:
-            break;
+        for( std::vector< HNMDServiceDevRef >::iterator pit = sit->getDeviceListRef().begin(); pit != sit->getDeviceListRef().end(); pit++ )
+        {
+            jw.beginObject();
+            jw.field( "name", pit->getDevName() );
+            jw.field( "devCRC32ID", pit->getDevCRC32ID() );
+            jw.endObject();
         }
 
-        // Failure
-        reqRR->getRspMsg().configAsInternalServerError();
-        return;            
-    }    
-    // GET "/hnode2/mgmt/status"
-    else if( "getStatus" == opID )
-    {
-        std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
-        pjs::Object jsRoot;
+        jw.endArray();
+    }
 
-        jsRoot.set( "state", "enable" );
-        jsRoot.set( "test2", "00:00:00" );
+    jw.endObject();
+}
 
-        // Render into a json string.
-        try {
-            pjs::Stringifier::stringify( jsRoot, msg );
-        } catch( ... ) {
-            // Send back not implemented
-            reqRR->getRspMsg().configAsInternalServerError();
-            return;
-        }
+HNMD_RESULT_T
+HNManagementDevice::renderDeviceInventory( HNMDInventorySnapshotPtr inventory, std::string &buffer )
+{
+    static const char *arrayNames[] = { "ownedDevices", "unclaimedDevices", "unavailableDevices" };
 
-        reqRR->getRspMsg().finalizeLocalContent();
-        reqRR->getRspMsg().setContentType("application/json");
-        reqRR->getRspMsg().setStatusCode(200);
-        reqRR->getRspMsg().setReason("OK");
-        return;
-    }
-    else if( "getDeviceInventory" == opID )
-    {
-        std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
-        pjs::Object jsRoot;
-        pjs::Array jsOwnedArray;
-        pjs::Array jsUnclaimedArray;
-        pjs::Array jsOtherOwnerArray;
-        pjs::Array jsUnavailableArray;
+    HNMDJsonWriter jw( buffer );
 
-        std::vector< HNMDARecord > deviceList;
-        m_arbiter.getDeviceListCopy( deviceList );
+    // Records in the snapshot are read-only from here.
+    std::vector< HNMDARecordPtr > &deviceList = inventory->getDeviceListRef();
 
+    jw.beginObject();
+
+    // Report the owned, unclaimed, and unavailable arrays,
+    // one pass over the snapshot for each.
+    for( uint group = 0; group < 3; group++ )
+    {
+        jw.key( arrayNames[ group ] );
+        jw.beginArray();
 
-        for( std::vector< HNMDARecord >::iterator dit = deviceList.begin(); dit != deviceList.end(); dit++ )
+        for( std::vector< HNMDARecordPtr >::iterator dit = deviceList.begin(); dit != deviceList.end(); dit++ )
         {
-            pjs::Object jsDevice;
-            pjs::Array  jsAddrArray;
+            uint devGroup;
 
             // Don't report the self device information here, 
             // do it via the local status request or similar.
-            if( dit->getManagementState() == HNMDR_MGMT_STATE_SELF )
+            if( (*dit)->getManagementState() == HNMDR_MGMT_STATE_SELF )
                 continue;
 
-            jsDevice.set( "name", dit->getName() );
-            jsDevice.set( "hnodeID", dit->getHNodeIDStr() );
-            jsDevice.set( "deviceType", dit->getDeviceType() );
-            jsDevice.set( "deviceVersion", dit->getDeviceVersion() );
-            jsDevice.set( "discID", dit->getDiscoveryID() );
-            jsDevice.set( "crc32ID", dit->getCRC32ID() );
-            jsDevice.set( "hexID", dit->getCRC32IDStr() );
-            jsDevice.set( "mgmtState", dit->getManagementStateStr() );
-            std::vector< HNMDARAddress > addrList;
-            dit->getAddressList( addrList );
-            for( std::vector< HNMDARAddress >::iterator ait = addrList.begin(); ait != addrList.end(); ait++ )
-            {
-                pjs::Object jsAddress;
-
-                jsAddress.set( "type", ait->getTypeAsStr() );
-                jsAddress.set( "dnsName", ait->getDNSName() );
-                jsAddress.set( "address", ait->getAddress() );
-                jsAddress.set( "port", ait->getPort() );
-
-                jsAddrArray.add( jsAddress );
-            }
-
-            jsDevice.set( "addresses", jsAddrArray );
-
-            switch( dit->getOwnershipState() )
+            switch( (*dit)->getOwnershipState() )
             {
                 case HNMDR_OWNER_STATE_MINE: 
-                    jsOwnedArray.add( jsDevice );
+                    devGroup = 0;
                 break;
 
                 case HNMDR_OWNER_STATE_AVAILABLE:
-                    jsUnclaimedArray.add( jsDevice );
+                    devGroup = 1;
                 break;
 
                 // All other states are reported as unavailable
                 case HNMDR_OWNER_STATE_OTHER:
                 default:
-                {
-                    // Default to unavailable
-                    jsUnavailableArray.add( jsDevice );
-                }
+                    devGroup = 2;
+                break;
             }
-        }
 
-        // Report the owned, unclaimed, other-owner, and unavailable arrays
-        jsRoot.set( "ownedDevices", jsOwnedArray );
-        jsRoot.set( "unclaimedDevices", jsUnclaimedArray );
-        jsRoot.set( "unavailableDevices", jsUnavailableArray );
+            if( devGroup != group )
+                continue;
 
-        // Render into a json string.
-        try {
-            pjs::Stringifier::stringify( jsRoot, msg );
-        } catch( ... ) {
-            // Send back not implemented
-            reqRR->getRspMsg().configAsInternalServerError();
-            return;
+            jw.beginObject();
+            jw.field( "name", (*dit)->getName() );
+            jw.field( "hnodeID", (*dit)->getHNodeIDStr() );
+            jw.field( "deviceType", (*dit)->getDeviceType() );
+            jw.field( "deviceVersion", (*dit)->getDeviceVersion() );
+            jw.field( "discID", (*dit)->getDiscoveryID() );
+            jw.field( "crc32ID", (*dit)->getCRC32ID() );
+            jw.field( "hexID", (*dit)->getCRC32IDStr() );
+            jw.field( "mgmtState", (*dit)->getManagementStateStr() );
+
+            jw.key( "addresses" );
+            writeAddressListJSON( jw, (*dit)->getAddressListRef() );
+
+            jw.endObject();
         }
 
-        reqRR->getRspMsg().finalizeLocalContent();
-        reqRR->getRspMsg().setContentType("application/json");
-        reqRR->getRspMsg().setStatusCode(200);
-        reqRR->getRspMsg().setReason("OK");
-        return;
+        jw.endArray();
     }
-    else if( "getDeviceMgmtStatus" == opID )
-    {
-        std::string devCRC32ID;
 
-        if( opData->getParam( "devCRC32ID", devCRC32ID ) == true )
-        {
-            opData->responseSetStatusAndReason( HNR_HTTP_INTERNAL_SERVER_ERROR );
-            opData->responseSend();
-            return; 
-        }
+    jw.endObject();
 
-        std::cout << "=== Get Device Mgmt Status Request (id: " << devCRC32ID << ") ===" << std::endl;
+    return HNMD_RESULT_SUCCESS;
+}
 
-        std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
-        pjs::Object jsRoot;
+// Define this helper class here so that the Poco exposure in the 
+// public header file is lessened.
+class HNMDWorkerRunner : public Poco::Runnable
+{
+    private:
+        Poco::Thread    m_thread;
+        HNMDWorkerPool *m_poolObj;
 
-        HNMDARecord device;
-        if( m_arbiter.getDeviceCopy( devCRC32ID, device ) != HNMDL_RESULT_SUCCESS )
+    public:  
+        HNMDWorkerRunner( HNMDWorkerPool *value )
         {
-            opData->responseSetStatusAndReason( HNR_HTTP_INTERNAL_SERVER_ERROR );
-            opData->responseSend();
-            return; 
+            m_poolObj = value;
         }
 
-        jsRoot.set( "name", device.getName() );
-        jsRoot.set( "hnodeID", device.getHNodeIDStr() );
-        jsRoot.set( "deviceType", device.getDeviceType() );
-        jsRoot.set( "deviceVersion", device.getDeviceVersion() );
-        jsRoot.set( "discID", device.getDiscoveryID() );
-        jsRoot.set( "crc32ID", device.getCRC32ID() );
-        jsRoot.set( "mgmtState", device.getManagementStateStr() );
-
-        pjs::Array  jsAddrArray;
-        std::vector< HNMDARAddress > addrList;
-        device.getAddressList( addrList );
-        for( std::vector< HNMDARAddress >::iterator ait = addrList.begin(); ait != addrList.end(); ait++ )
+        void startThread()
         {
-            pjs::Object jsAddress;
+            m_thread.start( *this );
+        }
 
-            jsAddress.set( "type", ait->getTypeAsStr() );
-            jsAddress.set( "dnsName", ait->getDNSName() );
-            jsAddress.set( "address", ait->getAddress() );
-            jsAddress.set( "port", ait->getPort() );
+        void joinThread()
+        {
+            m_thread.join();
+        }
 
-            jsAddrArray.add( jsAddress );
+        virtual void run()
+        {
+            m_poolObj->runWorkerLoop();
         }
+};
 
-        jsRoot.set( "addresses", jsAddrArray );
+HNMDWorkItem::HNMDWorkItem( HNSCGIRR *reqRR, HNOperationData *opData, HNMD_OPCODE_T opcode )
+{
+    m_reqRR  = reqRR;
+    m_opData = opData;
+    m_opcode = opcode;
+}
 
-        // Render into a json string.
-        try {
-            pjs::Stringifier::stringify( jsRoot, msg );
-        } catch( ... ) {
-            // Send back not implemented
-            reqRR->getRspMsg().configAsInternalServerError();
-            return;
-        }
+HNMDWorkItem::~HNMDWorkItem()
+{
 
-        reqRR->getRspMsg().finalizeLocalContent();
-        reqRR->getRspMsg().setContentType("application/json");
-        reqRR->getRspMsg().setStatusCode(200);
-        reqRR->getRspMsg().setReason("OK");
-        return;
+}
+
+HNSCGIRR*
+HNMDWorkItem::getRR()
+{
+    return m_reqRR;
+}
+
+HNOperationData*
+HNMDWorkItem::getOpData()
+{
+    return m_opData;
+}
+
+HNMD_OPCODE_T
+HNMDWorkItem::getOpcode()
+{
+    return m_opcode;
+}
+
+HNMDWorkerPool::HNMDWorkerPool()
+{
+    m_parent = NULL;
+    m_responseQueue = NULL;
+    m_runWorkers = false;
+}
+
+HNMDWorkerPool::~HNMDWorkerPool()
+{
+
+}
+
+void
+HNMDWorkerPool::setParent( HNManagementDevice *parent )
+{
+    m_parent = parent;
+}
+
+void
+HNMDWorkerPool::setResponseQueue( HNSigSyncQueue *responseQueue )
+{
+    m_responseQueue = responseQueue;
+}
+
+void
+HNMDWorkerPool::start( uint threadCnt )
+{
+    std::cout << "HNMDWorkerPool::start() - threads: " << threadCnt << std::endl;
+
+    m_runWorkers = true;
+
+    for( uint i = 0; i < threadCnt; i++ )
+    {
+        HNMDWorkerRunner *runner = new HNMDWorkerRunner( this );
+
+        m_thelpList.push_back( runner );
+
+        runner->startThread();
+    }
+}
+
+void
+HNMDWorkerPool::shutdown()
+{
+    // Tell the workers to exit once the queue is drained
+    {
+        // Scope lock
+        std::lock_guard<std::mutex> guard( m_queueMutex );
+        m_runWorkers = false;
     }
-    else if( "postDeviceMgmtCommand" == opID )
+
+    m_queueCV.notify_all();
+
+    for( std::vector< void* >::iterator it = m_thelpList.begin(); it != m_thelpList.end(); it++ )
     {
-        std::string devCRC32ID;
+        ( (HNMDWorkerRunner*) *it )->joinThread();
+        delete ( (HNMDWorkerRunner*) *it );
+    }
+
+    m_thelpList.clear();
+}
+
+void
+HNMDWorkerPool::queueRequest( HNSCGIRR *reqRR, HNOperationData *opData, HNMD_OPCODE_T opcode )
+{
+    {
+        // Scope lock
+        std::lock_guard<std::mutex> guard( m_queueMutex );
+        m_workQueue.push_back( HNMDWorkItem( reqRR, opData, opcode ) );
+    }
+
+    m_queueCV.notify_one();
+}
+
+void
+HNMDWorkerPool::runWorkerLoop()
+{
+    while( true )
+    {
+        std::unique_lock<std::mutex> lock( m_queueMutex );
+
+        while( (m_runWorkers == true) && m_workQueue.empty() )
+            m_queueCV.wait( lock );
+
+        if( m_workQueue.empty() )
+            return;
+
+        HNMDWorkItem item = m_workQueue.front();
+        m_workQueue.pop_front();
+
+        lock.unlock();
 
-        if( opData->getParam( "devCRC32ID", devCRC32ID ) == true )
+        // Run the handler without the queue lock held.  A throw
+        // would end this worker and strand the request, so the
+        // client gets a 500 instead.
+        bool post = true;
+
+        try
         {
-            reqRR->getRspMsg().configAsInternalServerError();
-            return; 
+            post = m_parent->handleLocalSCGIRequest( item.getRR(), item.getOpData(), item.getOpcode() );
+        }
+        catch( std::exception &ex )
+        {
+            syslog( LOG_ERR, "HNMDWorkerPool - Request handler failed: %s", ex.what() );
+            item.getRR()->getRspMsg().configAsInternalServerError();
+            post = true;
+        }
+        catch( ... )
+        {
+            syslog( LOG_ERR, "HNMDWorkerPool - Request handler failed" );
+            item.getRR()->getRspMsg().configAsInternalServerError();
+            post = true;
         }
 
-        std::cout << "=== Post Device Mgmt Command (id: " << devCRC32ID << ") ===" << std::endl;
+        if( post == true )
+            m_responseQueue->postRecord( item.getRR() );
 
-        // Pull the content portion into the local buffer.
-        reqRR->getReqMsg().readContentToLocal();
+        delete item.getOpData();
+    }
+}
+
+HNMDPendingHealthPoll::HNMDPendingHealthPoll( HNSCGIRR *reqRR, uint64_t epoch, uint64_t since, time_t deadline )
+{
+    m_reqRR    = reqRR;
+    m_epoch    = epoch;
+    m_since    = since;
+    m_deadline = deadline;
+}
 
-        std::istream *bodyStream = &reqRR->getReqMsg().getLocalInputStream();
+HNMDPendingHealthPoll::~HNMDPendingHealthPoll()
+{
 
-        std::cout << "stream state: " << bodyStream->rdstate() << std::endl;
-        std::cout << "stream 1char: " << bodyStream->peek() << std::endl;
+}
 
-        // Parse the command request, erroring if it isn't ok
-        if( m_arbiter.setDeviceMgmtCmdFromJSON( devCRC32ID, bodyStream ) != HNMDL_RESULT_SUCCESS )
+HNSCGIRR*
+HNMDPendingHealthPoll::getRR()
+{
+    return m_reqRR;
+}
+
+uint64_t
+HNMDPendingHealthPoll::getEpoch()
+{
+    return m_epoch;
+}
+
+uint64_t
+HNMDPendingHealthPoll::getSince()
+{
+    return m_since;
+}
+
+time_t
+HNMDPendingHealthPoll::getDeadline()
+{
+    return m_deadline;
+}
+
+void
+HNManagementDevice::queueDiscoveryEvent( HNAvahiBrowserEvent *event )
+{
+    switch( event->getEventType() )
+    {
+        case HNAB_EVTYPE_ADD:
         {
-            reqRR->getRspMsg().configAsInternalServerError();
-            return;
+            HNMDARecord notifyRec;
+
+            notifyRec.setDiscoveryID( event->getName() );
+            notifyRec.setDeviceType( event->getTxtValue( "devType" ) );
+            notifyRec.setHNodeIDFromStr( event->getTxtValue( "hnodeID" ) );
+            notifyRec.setName( event->getTxtValue( "name" ) );
+
+            notifyRec.addAddressInfo( event->getHostname(), event->getAddress(), event->getPort() );
+
+            // Start the window with the first event of a burst,
+            // later events don't extend it.
+            if( isDiscoveryBatchPending() == false )
+                m_discoveryBatchDeadline = monotonicMS() + HNMD_DISCOVERY_BATCH_MSECS;
+
+            // Cancels a remove from earlier in the window
+            m_discoveryRemoveSet.erase( notifyRec.getDiscoveryID() );
+
+            // Repeat announcements, for instance one per address,
+            // fold into the record already waiting.
+            std::map< std::string, HNMDARecord >::iterator it = m_discoveryBatch.find( notifyRec.getDiscoveryID() );
+
+            if( it == m_discoveryBatch.end() )
+                m_discoveryBatch.insert( std::pair< std::string, HNMDARecord >( notifyRec.getDiscoveryID(), notifyRec ) );
+            else
+                it->second.updateRecord( notifyRec );
         }
+        break;
 
-        // Kick off execution of the new command request
-        if( m_arbiter.startDeviceMgmtCmd( devCRC32ID ) != HNMDL_RESULT_SUCCESS )
+        case HNAB_EVTYPE_REMOVE:
         {
-            reqRR->getRspMsg().configAsInternalServerError();
-            return; 
+            if( isDiscoveryBatchPending() == false )
+                m_discoveryBatchDeadline = monotonicMS() + HNMD_DISCOVERY_BATCH_MSECS;
+
+            // Cancels an add from earlier in the window
+            m_discoveryBatch.erase( event->getName() );
+
+            m_discoveryRemoveSet.insert( event->getName() );
         }
-        
-        reqRR->getRspMsg().setStatusCode(200);
-        reqRR->getRspMsg().setReason("OK");
+        break;
+    }
+}
+
+bool
+HNManagementDevice::isDiscoveryBatchPending()
+{
+    return ( (m_discoveryBatch.empty() == false) || (m_discoveryRemoveSet.empty() == false) );
+}
+
+void
+HNManagementDevice::checkDiscoveryBatch( uint64_t now )
+{
+    if( isDiscoveryBatchPending() == false )
+        return;
+
+    if( now < m_discoveryBatchDeadline )
         return;
+
+    std::vector< HNMDARecord > recordList;
+    std::vector< std::string > removedList;
+
+    for( std::map< std::string, HNMDARecord >::iterator it = m_discoveryBatch.begin(); it != m_discoveryBatch.end(); it++ )
+        recordList.push_back( it->second );
+
+    removedList.assign( m_discoveryRemoveSet.begin(), m_discoveryRemoveSet.end() );
+
+    m_discoveryBatch.clear();
+    m_discoveryRemoveSet.clear();
+
+    if( m_arbiter.notifyDiscoverBatch( recordList, removedList ) != HNMDL_RESULT_SUCCESS )
+    {
+        // Note error
     }
-    else if( "getDeviceServices" == opID )
+}
+
+// GET /hnode2/mgmt/events
+void
+HNManagementDevice::handleEventStreamRequest( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::cout << "=== Event Stream Request ===" << std::endl;
+
+    // No content length, the sink holds the connection
+    // open and writes events as they are published.
+    reqRR->setStreaming( true );
+
+    reqRR->getRspMsg().setContentType( "text/event-stream" );
+    reqRR->getRspMsg().addHdrPair( "Cache-Control", "no-cache" );
+    reqRR->getRspMsg().addHdrPair( "X-Accel-Buffering", "no" );
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+
+    reqsink.getProxyResponseQueue()->postRecord( reqRR );
+}
+
+void
+HNManagementDevice::publishChangeEvent( HNMDChangeEvent *event )
+{
+    std::string buffer;
+    HNMDJsonWriter jw( buffer );
+
+    // The detail can come straight from a device's mDNS record,
+    // the writer escapes it so a quote or newline can't break
+    // the JSON or start a new event field.
+    jw.beginObject();
+    jw.field( "crc32ID", HNManagedDeviceArbiter::formatCRC32IDStr( event->getDevCRC32ID() ) );
+
+    switch( event->getType() )
     {
-        std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
-        pjs::Object jsRoot;
-        pjs::Object jsProviderSet;
-        pjs::Object jsMappingSet;
-        pjs::Object jsDefaultSet;
-        pjs::Array  jsDirectedArray;
+        case HNMD_CHGEVT_TYPE_HEALTH:
+            jw.field( "generation", (unsigned long) event->getGeneration() );
+        break;
+
+        case HNMD_CHGEVT_TYPE_DEVICE_ADDED:
+            jw.field( "deviceType", event->getDetail() );
+        break;
+
+        default:
+            jw.field( "state", event->getDetail() );
+        break;
+    }
 
-        std::vector< HNMDServiceInfo > srvInfoList;
-        m_arbiter.reportSrvProviderInfoList( srvInfoList );
+    jw.endObject();
 
-        for( std::vector< HNMDServiceInfo >::iterator sit = srvInfoList.begin(); sit != srvInfoList.end(); sit++ )
+    // Format as a Server-Sent Event, the data is
+    // a single line JSON object.
+    std::string msg = "event: " + event->getTypeStr() + "\ndata: " + buffer + "\n\n";
+
+    reqsink.getStreamEventQueue()->postRecord( new HNSCGIStreamEvent( msg ) );
+}
+
+// GET /hnode2/mgmt/cluster-health/changes?since=<epoch>-<generation>&timeout=<seconds>
+void
+HNManagementDevice::handleHealthChangesRequest( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    uint64_t epoch   = 0;
+    uint64_t since   = 0;
+    uint     timeout = HNMD_HEALTH_POLL_DEF_TIMEOUT;
+
+    Poco::URI::QueryParameters params;
+
+    // A bad escape in the query makes the parse throw, and this
+    // runs on the main event loop, so answer it here.
+    try
+    {
+        Poco::URI uri( reqRR->getReqMsg().getURI() );
+        params = uri.getQueryParameters();
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "handleHealthChangesRequest - bad query: " << ex.displayText() << std::endl;
+
+        reqRR->getRspMsg().configAsBadRequest();
+        reqsink.getProxyResponseQueue()->postRecord( reqRR );
+        return;
+    }
+
+    for( Poco::URI::QueryParameters::iterator it = params.begin(); it != params.end(); it++ )
+    {
+        if( it->first == "since" )
         {
-            pjs::Object jsProvider;
-            pjs::Array  jsProviderArray;
+            // The token from the last response.  Without a run
+            // epoch it can't be trusted and the client gets a reset.
+            char *endPtr = NULL;
+            uint64_t tmpEpoch = strtoull( it->second.c_str(), &endPtr, 10 );
 
-            for( std::vector< HNMDServiceDevRef >::iterator pit = sit->getDeviceListRef().begin(); pit != sit->getDeviceListRef().end(); pit++ )
+            if( *endPtr == '-' )
             {
-                jsProvider.set( "name", pit->getDevName() );
-                jsProvider.set( "devCRC32ID", pit->getDevCRC32ID() );
-              
-                jsProviderArray.add( jsProvider );
+                epoch = tmpEpoch;
+                since = strtoull( endPtr + 1, NULL, 10 );
             }
-
-            jsProviderSet.set( sit->getSrvType(), jsProviderArray );
         }
+        else if( it->first == "timeout" )
+            timeout = strtoul( it->second.c_str(), NULL, 10 );
+    }
+
+    if( timeout > HNMD_HEALTH_POLL_MAX_TIMEOUT )
+        timeout = HNMD_HEALTH_POLL_MAX_TIMEOUT;
 
-        m_arbiter.reportSrvMappingInfoList( srvInfoList );
+    std::cout << "=== Cluster Health Changes Request (since: " << epoch << "-" << since << "  timeout: " << timeout << ") ===" << std::endl;
 
-        for( std::vector< HNMDServiceInfo >::iterator sit = srvInfoList.begin(); sit != srvInfoList.end(); sit++ )
+    // Answer right away if there is already something newer,
+    // or if the client asked not to wait.
+    if( fillHealthChangesResponse( reqRR, epoch, since, (timeout == 0) ) == true )
+    {
+        reqsink.getProxyResponseQueue()->postRecord( reqRR );
+        return;
+    }
+
+    // Hold the request until a change or the deadline
+    std::lock_guard<std::mutex> guard( m_pendingPollMutex );
+
+    reqRR->setCloseCall( pendingHealthPollClosed, this );
+    m_pendingHealthPolls.push_back( HNMDPendingHealthPoll( reqRR, epoch, since, time(NULL) + timeout ) );
+}
+
+// Called from the sink thread when a client leaves before its
+// request is answered.  Returns true if the request was still held
+// here, in which case it is forgotten and the sink deletes it.
+bool
+HNManagementDevice::pendingHealthPollClosed( HNSCGIRR *reqRR, void *objAddr )
+{
+    HNManagementDevice *mgmtDev = (HNManagementDevice *) objAddr;
+
+    // Scope lock
+    std::lock_guard<std::mutex> guard( mgmtDev->m_pendingPollMutex );
+
+    for( std::list< HNMDPendingHealthPoll >::iterator it = mgmtDev->m_pendingHealthPolls.begin(); it != mgmtDev->m_pendingHealthPolls.end(); it++ )
+    {
+        if( it->getRR() == reqRR )
         {
-            pjs::Object jsProvider;
-            pjs::Array  jsProviderArray;
+            mgmtDev->m_pendingHealthPolls.erase( it );
+            return true;
+        }
+    }
 
-            for( std::vector< HNMDServiceDevRef >::iterator pit = sit->getDeviceListRef().begin(); pit != sit->getDeviceListRef().end(); pit++ )
-            {
-                jsProvider.set( "name", pit->getDevName() );
-                jsProvider.set( "devCRC32ID", pit->getDevCRC32ID() );
-              
-                jsProviderArray.add( jsProvider );
-            }
+    // Already answered, the sink gets it back through its queue
+    return false;
+}
 
-            jsMappingSet.set( sit->getSrvType(), jsProviderArray );
+bool
+HNManagementDevice::fillHealthChangesResponse( HNSCGIRR *reqRR, uint64_t epoch, uint64_t since, bool force )
+{
+    std::string deltaJSON;
+
+    if( (m_arbiter.getHealthChangesSince( epoch, since, deltaJSON ) == false) && (force == false) )
+        return false;
+
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    msg.write( deltaJSON.data(), deltaJSON.size() );
+
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().setContentType("application/json");
+    reqRR->getRspMsg().addHdrPair( "Cache-Control", "no-cache" );
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+
+    return true;
+}
+
+void
+HNManagementDevice::checkPendingHealthPolls()
+{
+    time_t now = time(NULL);
+
+    // Held across the post, so a closing client either finds
+    // its request here or gets it back through the sink queue.
+    std::lock_guard<std::mutex> guard( m_pendingPollMutex );
+
+    for( std::list< HNMDPendingHealthPoll >::iterator it = m_pendingHealthPolls.begin(); it != m_pendingHealthPolls.end(); )
+    {
+        // Once the deadline passes, reply with an empty change set
+        if( fillHealthChangesResponse( it->getRR(), it->getEpoch(), it->getSince(), (now >= it->getDeadline()) ) == true )
+        {
+            reqsink.getProxyResponseQueue()->postRecord( it->getRR() );
+            it = m_pendingHealthPolls.erase( it );
         }
+        else
+            it++;
+    }
+}
 
-        std::vector< HNMDServiceAssoc > assocList;
-        m_arbiter.reportSrvDefaultMappings( assocList );
+HNMDOpHandler::HNMDOpHandler()
+{
+    m_opcode  = HNMD_OPCODE_NONE;
+    m_handler = NULL;
+    m_flags   = 0;
+}
+
+HNMDOpHandler::HNMDOpHandler( HNMD_OPCODE_T opcode, std::string opID, HNMDOpHandlerFunc handler, uint flags, std::string contentType )
+{
+    m_opcode      = opcode;
+    m_opID        = opID;
+    m_handler     = handler;
+    m_flags       = flags;
+    m_contentType = contentType;
+}
+
+HNMDOpHandler::~HNMDOpHandler()
+{
+
+}
+
+HNMD_OPCODE_T
+HNMDOpHandler::getOpcode()
+{
+    return m_opcode;
+}
 
-        for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
+std::string
+HNMDOpHandler::getOpID()
+{
+    return m_opID;
+}
+
+HNMDOpHandlerFunc
+HNMDOpHandler::getHandler()
+{
+    return m_handler;
+}
+
+bool
+HNMDOpHandler::isBodyRequired()
+{
+    return (m_flags & HNMD_OPF_BODY_REQUIRED) ? true : false;
+}
+
+bool
+HNMDOpHandler::isCacheable()
+{
+    return (m_flags & HNMD_OPF_CACHEABLE) ? true : false;
+}
+
+bool
+HNMDOpHandler::isDeferred()
+{
+    return (m_flags & HNMD_OPF_DEFERRED) ? true : false;
+}
+
+std::string
+HNMDOpHandler::getContentType()
+{
+    return m_contentType;
+}
+
+void
+HNManagementDevice::registerOpHandler( HNMD_OPCODE_T opcode, std::string opID, HNMDOpHandlerFunc handler, uint flags, std::string contentType )
+{
+    m_opTable[ opcode ] = HNMDOpHandler( opcode, opID, handler, flags, contentType );
+    m_opcodeMap[ opID ] = opcode;
+}
+
+void
+HNManagementDevice::initOpHandlerTable()
+{
+    m_opTable.clear();
+    m_opTable.resize( HNMD_OPCODE_COUNT );
+    m_opcodeMap.clear();
+
+    // Local handlers for the SCGI management interface
+    registerOpHandler( HNMD_OPCODE_CREATE_AUTH_TOKEN, "createAuthToken", &HNManagementDevice::handleCreateAuthToken, 0, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_STATUS, "getStatus", &HNManagementDevice::handleGetStatus, 0, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_DEVICE_INVENTORY, "getDeviceInventory", &HNManagementDevice::handleGetDeviceInventory, HNMD_OPF_CACHEABLE, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_DEVICE_MGMT_STATUS, "getDeviceMgmtStatus", &HNManagementDevice::handleGetDeviceMgmtStatus, 0, "application/json" );
+    registerOpHandler( HNMD_OPCODE_POST_DEVICE_MGMT_COMMAND, "postDeviceMgmtCommand", &HNManagementDevice::handlePostDeviceMgmtCommand, HNMD_OPF_BODY_REQUIRED, "" );
+    registerOpHandler( HNMD_OPCODE_GET_DEVICE_SERVICES, "getDeviceServices", &HNManagementDevice::handleGetDeviceServices, 0, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_CLUSTER_HEALTH, "getClusterHealth", &HNManagementDevice::handleGetClusterHealth, HNMD_OPF_CACHEABLE, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_CLUSTER_HEALTH_SUMMARY, "getClusterHealthSummary", &HNManagementDevice::handleGetClusterHealthSummary, HNMD_OPF_CACHEABLE, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_CLUSTER_HEALTH_HISTORY, "getClusterHealthHistory", &HNManagementDevice::handleGetClusterHealthHistory, 0, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_CLUSTER_HEALTH_CHANGES, "getClusterHealthChanges", &HNManagementDevice::handleHealthChangesRequest, HNMD_OPF_DEFERRED, "application/json" );
+    registerOpHandler( HNMD_OPCODE_GET_EVENT_STREAM, "getEventStream", &HNManagementDevice::handleEventStreamRequest, HNMD_OPF_DEFERRED, "text/event-stream" );
+
+    // Served through dispatchEP by the hnode device REST interface
+    registerOpHandler( HNMD_OPCODE_POST_HEALTH_EVENT, "postHealthEvent", NULL, HNMD_OPF_BODY_REQUIRED, "" );
+    registerOpHandler( HNMD_OPCODE_POST_LOG_EVENT, "postLogEvent", NULL, HNMD_OPF_BODY_REQUIRED, "" );
+}
+
+HNMD_OPCODE_T
+HNManagementDevice::lookupOpcode( std::string opID )
+{
+    std::unordered_map< std::string, HNMD_OPCODE_T >::iterator it = m_opcodeMap.find( opID );
+
+    if( it == m_opcodeMap.end() )
+        return HNMD_OPCODE_NONE;
+
+    return it->second;
+}
+
+bool
+HNManagementDevice::handleLocalSCGIRequest( HNSCGIRR *reqRR, HNOperationData *opData, HNMD_OPCODE_T opcode )
+{
+    std::cout << "HNManagementDevice::handleLocalProxyRequest() - entry" << std::endl;
+    std::cout << "  dispatchID: " << opData->getDispatchID() << std::endl;
+    std::cout << "  opID: " << opData->getOpID() << std::endl;
+
+    if( (opcode >= HNMD_OPCODE_COUNT) || (m_opTable[ opcode ].getHandler() == NULL) )
+    {
+        // Send back not found
+        reqRR->getRspMsg().configAsNotFound();
+        return true;
+    }
+
+    HNMDOpHandler &op = m_opTable[ opcode ];
+
+    if( op.isBodyRequired() == true )
+    {
+        // Pull the content portion into the local buffer.
+        reqRR->getReqMsg().readContentToLocal();
+
+        if( reqRR->getReqMsg().getLocalInputStream().peek() == std::char_traits< char >::eof() )
         {
-            pjs::Object jsAssoc;
+            reqRR->getRspMsg().setStatusCode(400);
+            reqRR->getRspMsg().setReason("Bad Request");
+            reqRR->getRspMsg().setContentLength( 0 );
+            return true;
+        }
+    }
 
-            if( sit->getType() != HNMDSA_TYPE_DEFAULT )
-              continue;
+    (this->*op.getHandler())( reqRR, opData );
 
-            jsAssoc.set( "providerCRC32ID", sit->getProviderCRC32ID() );
-              
-            jsDefaultSet.set( sit->getSrvType(), jsAssoc );
-        }        
+    // Deferred handlers post their own response
+    if( op.isDeferred() == true )
+        return false;
+
+    uint statusCode = reqRR->getRspMsg().getStatusCode();
+
+    if( (statusCode == 200) && (op.getContentType().empty() == false) )
+        reqRR->getRspMsg().setContentType( op.getContentType() );
 
-        m_arbiter.reportSrvDirectedMappings( assocList );
+    // Cacheable responses carry an ETag the client can revalidate
+    if( (statusCode == 200) || (statusCode == 304) )
+        reqRR->getRspMsg().addHdrPair( "Cache-Control", (op.isCacheable() == true) ? "no-cache" : "no-store" );
 
-        for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
+    return true;
+}
+
+// POST /hnode2/mgmt/auth
+void
+HNManagementDevice::handleCreateAuthToken( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::cout << "== createAuthToken request ==" << std::endl;
+
+    // Pull the content portion into the local buffer.
+    reqRR->getReqMsg().readContentToLocal();
+
+    std::string body;
+    Poco::StreamCopier::copyToString( reqRR->getReqMsg().getLocalInputStream(), body );
+    std::cout << body << std::endl;
+
+    std::string jwtStr;
+    HNMD_RESULT_T result = generateJWT( "admin", (12*60*60), jwtStr );
+    switch( result )
+    {
+        case HNMD_RESULT_NOT_AUTHORIZED:
+#if 0           
+        reqRR->getRspMsg().configAsInternalServerError();
+        return;
+#endif              
+        break;
+
+        case HNMD_RESULT_SUCCESS:
         {
-            pjs::Object jsAssoc;
+            reqRR->getRspMsg().setStatusCode(200);
+            reqRR->getRspMsg().setReason("OK");
+        
+            std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+            pjs::Object jsRoot;
+
+            jsRoot.set( "username", "admin" );
+            jsRoot.set( "accessToken", jwtStr );
+
+            pjs::Array jsRoles;
+            jsRoles.add("ROLE_ADMIN");
+            jsRoot.set( "roles", jsRoles );
+
+            // Render into a json string.
+            try {
+                pjs::Stringifier::stringify( jsRoot, msg );
+            } catch( ... ) {
+                // Send back not implemented
+                reqRR->getRspMsg().configAsInternalServerError();
+                return;
+            }
 
-            if( sit->getType() != HNMDSA_TYPE_DIRECTED )
-              continue;
+            reqRR->getRspMsg().finalizeLocalContent();
+            return;
+        }
+        break;
 
-            jsAssoc.set( "srvType", sit->getSrvType() );
-            jsAssoc.set( "desirerCRC32ID", sit->getDesirerCRC32ID() );
-            jsAssoc.set( "providerCRC32ID", sit->getProviderCRC32ID() );
-              
-            jsDirectedArray.add( jsAssoc );
-        }        
+        default:
+        break;
+    }
 
-        // Report the provided, desired, default mappings, and directed mappings
-        jsRoot.set( "providerSet", jsProviderSet );
-        jsRoot.set( "mappingSet", jsMappingSet );
-        jsRoot.set( "defaultMappings", jsDefaultSet );
-        jsRoot.set( "directedMappings", jsDirectedArray );
+    // Failure
+    reqRR->getRspMsg().configAsInternalServerError();
+}
 
-        // Render into a json string.
-        try {
-            pjs::Stringifier::stringify( jsRoot, msg );
-        } catch( ... ) {
-            // Send back not implemented
+// GET "/hnode2/mgmt/status"
+void
+HNManagementDevice::handleGetStatus( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::string &buffer = localRenderBuffer();
+    HNMDJsonWriter jw( buffer );
+
+    jw.beginObject();
+    jw.field( "state", "enable" );
+    jw.field( "test2", "00:00:00" );
+    jw.endObject();
+
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    msg.write( buffer.data(), buffer.size() );
+
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+}
+
+void
+HNManagementDevice::handleGetDeviceInventory( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    // Scope lock
+    std::lock_guard<std::mutex> guard( m_inventoryMutex );
+
+    // The inventory rarely changes compared to how often it is polled,
+    // so the rendered body is cached and keyed by the arbiter's inventory
+    // version.  The version only moves for visible record changes.
+    if( m_inventoryJSONVersion != m_arbiter.getInventoryVersion() )
+    {
+        HNMDInventorySnapshotPtr inventory = m_arbiter.getInventorySnapshot();
+
+        // Re-render in place, keeping the buffer's capacity
+        m_inventoryJSON.clear();
+
+        if( renderDeviceInventory( inventory, m_inventoryJSON ) != HNMD_RESULT_SUCCESS )
+        {
+            m_inventoryJSONVersion = 0;
             reqRR->getRspMsg().configAsInternalServerError();
             return;
         }
 
-        reqRR->getRspMsg().finalizeLocalContent();
-        reqRR->getRspMsg().setContentType("application/json");
-        reqRR->getRspMsg().setStatusCode(200);
-        reqRR->getRspMsg().setReason("OK");
-        return;      
+        m_inventoryJSONVersion = inventory->getVersion();
     }
-    else if( "getClusterHealth" == opID )
+
+    std::string etag = "\"inv-" + std::to_string( m_runEpoch ) + "-" + std::to_string( m_inventoryJSONVersion ) + "\"";
+
+    // If the client already has this version, then tell it so.
+    std::string clientETag;
+    if( (reqRR->getReqMsg().getHeader( "If-None-Match", clientETag ) == true) && (clientETag == etag) )
     {
-        std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+        reqRR->getRspMsg().configAsNotModified();
+        reqRR->getRspMsg().addHdrPair( "ETag", etag );
+        return;
+    }
 
-        m_arbiter.generateAllDeviceHealthReportAsJSON( msg );
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    msg.write( m_inventoryJSON.data(), m_inventoryJSON.size() );
 
-        /*
-        pjs::Object jsProviderSet;
-        pjs::Object jsMappingSet;
-        pjs::Object jsDefaultSet;
-        pjs::Array  jsDirectedArray;
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().addHdrPair( "ETag", etag );
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+}
 
-        std::vector< HNMDServiceInfo > srvInfoList;
-        m_arbiter.reportSrvProviderInfoList( srvInfoList );
+void
+HNManagementDevice::handleGetDeviceMgmtStatus( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::string devCRC32ID;
 
-        for( std::vector< HNMDServiceInfo >::iterator sit = srvInfoList.begin(); sit != srvInfoList.end(); sit++ )
-        {
-            pjs::Object jsProvider;
-            pjs::Array  jsProviderArray;
+    if( opData->getParam( "devCRC32ID", devCRC32ID ) == true )
+    {
+        reqRR->getRspMsg().configAsInternalServerError();
+        return; 
+    }
 
-            for( std::vector< HNMDServiceDevRef >::iterator pit = sit->getDeviceListRef().begin(); pit != sit->getDeviceListRef().end(); pit++ )
-            {
-                jsProvider.set( "name", pit->getDevName() );
-                jsProvider.set( "devCRC32ID", pit->getDevCRC32ID() );
-              
-                jsProviderArray.add( jsProvider );
-            }
+    std::cout << "=== Get Device Mgmt Status Request (id: " << devCRC32ID << ") ===" << std::endl;
 
-            jsProviderSet.set( sit->getSrvType(), jsProviderArray );
-        }
+    uint32_t crc32Val = 0;
+    HNMDARecord *device = NULL;
+    HNMDInventorySnapshotPtr inventory = m_arbiter.getInventorySnapshot();
+    if( m_arbiter.parseCRC32IDStr( devCRC32ID, crc32Val ) == HNMDL_RESULT_SUCCESS )
+        device = inventory->findDevice( crc32Val );
+    if( device == NULL )
+    {
+        reqRR->getRspMsg().configAsInternalServerError();
+        return; 
+    }
 
-        m_arbiter.reportSrvMappingInfoList( srvInfoList );
+    std::string &buffer = localRenderBuffer();
+    HNMDJsonWriter jw( buffer );
 
-        for( std::vector< HNMDServiceInfo >::iterator sit = srvInfoList.begin(); sit != srvInfoList.end(); sit++ )
-        {
-            pjs::Object jsProvider;
-            pjs::Array  jsProviderArray;
+    jw.beginObject();
+    jw.field( "name", device->getName() );
+    jw.field( "hnodeID", device->getHNodeIDStr() );
+    jw.field( "deviceType", device->getDeviceType() );
+    jw.field( "deviceVersion", device->getDeviceVersion() );
+    jw.field( "discID", device->getDiscoveryID() );
+    jw.field( "crc32ID", device->getCRC32ID() );
+    jw.field( "mgmtState", device->getManagementStateStr() );
+
+    jw.key( "addresses" );
+    writeAddressListJSON( jw, device->getAddressListRef() );
+
+    jw.endObject();
+
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    msg.write( buffer.data(), buffer.size() );
+
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+}
+
+void
+HNManagementDevice::handlePostDeviceMgmtCommand( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::string devCRC32ID;
+
+    if( opData->getParam( "devCRC32ID", devCRC32ID ) == true )
+    {
+        reqRR->getRspMsg().configAsInternalServerError();
+        return; 
+    }
+
+    std::cout << "=== Post Device Mgmt Command (id: " << devCRC32ID << ") ===" << std::endl;
+
+    uint32_t crc32Val = 0;
+    if( m_arbiter.parseCRC32IDStr( devCRC32ID, crc32Val ) != HNMDL_RESULT_SUCCESS )
+    {
+        reqRR->getRspMsg().configAsInternalServerError();
+        return; 
+    }
+
+    std::istream *bodyStream = &reqRR->getReqMsg().getLocalInputStream();
+
+    std::cout << "stream state: " << bodyStream->rdstate() << std::endl;
+    std::cout << "stream 1char: " << bodyStream->peek() << std::endl;
+
+    // Parse the command request, erroring if it isn't ok
+    if( m_arbiter.setDeviceMgmtCmdFromJSON( crc32Val, bodyStream ) != HNMDL_RESULT_SUCCESS )
+    {
+        reqRR->getRspMsg().configAsInternalServerError();
+        return;
+    }
+
+    // Kick off execution of the new command request
+    if( m_arbiter.startDeviceMgmtCmd( crc32Val ) != HNMDL_RESULT_SUCCESS )
+    {
+        reqRR->getRspMsg().configAsInternalServerError();
+        return; 
+    }
+
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+}
+
+void
+HNManagementDevice::handleGetDeviceServices( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::string &buffer = localRenderBuffer();
+    HNMDJsonWriter jw( buffer );
+
+    std::vector< HNMDServiceInfo > srvInfoList;
+    std::vector< HNMDServiceAssoc > assocList;
+
+    jw.beginObject();
+
+    // Report the provided, desired, default mappings, and directed mappings
+    m_arbiter.reportSrvProviderInfoList( srvInfoList );
+
+    jw.key( "providerSet" );
+    writeServiceInfoListJSON( jw, srvInfoList );
+
+    m_arbiter.reportSrvMappingInfoList( srvInfoList );
+
+    jw.key( "mappingSet" );
+    writeServiceInfoListJSON( jw, srvInfoList );
+
+    m_arbiter.reportSrvDefaultMappings( assocList );
+
+    jw.key( "defaultMappings" );
+    jw.beginObject();
+
+    for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
+    {
+        if( sit->getType() != HNMDSA_TYPE_DEFAULT )
+          continue;
+
+        jw.key( sit->getSrvType() );
+        jw.beginObject();
+        jw.field( "providerCRC32ID", sit->getProviderCRC32ID() );
+        jw.endObject();
+    }        
+
+    jw.endObject();
+
+    m_arbiter.reportSrvDirectedMappings( assocList );
+
+    jw.key( "directedMappings" );
+    jw.beginArray();
+
+    for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
+    {
+        if( sit->getType() != HNMDSA_TYPE_DIRECTED )
+          continue;
+
+        jw.beginObject();
+        jw.field( "srvType", sit->getSrvType() );
+        jw.field( "desirerCRC32ID", sit->getDesirerCRC32ID() );
+        jw.field( "providerCRC32ID", sit->getProviderCRC32ID() );
+        jw.endObject();
+    }        
+
+    jw.endArray();
+
+    jw.endObject();
+
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    msg.write( buffer.data(), buffer.size() );
+
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+}
+
+// GET /hnode2/mgmt/cluster-health/summary
+void
+HNManagementDevice::handleGetClusterHealthSummary( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::ostringstream summary;
+    uint64_t generation;
+
+    m_arbiter.writeHealthSummaryAsJSON( summary, generation );
+
+    std::string etag = "\"summary-" + std::to_string( m_runEpoch ) + "-" + std::to_string( generation ) + "\"";
+
+    // Dashboards poll this often, most polls see no change.
+    std::string clientETag;
+    if( (reqRR->getReqMsg().getHeader( "If-None-Match", clientETag ) == true) && (clientETag == etag) )
+    {
+        reqRR->getRspMsg().configAsNotModified();
+        reqRR->getRspMsg().addHdrPair( "ETag", etag );
+        return;
+    }
+
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    msg << summary.str();
+
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().addHdrPair( "ETag", etag );
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+}
+
+// GET /hnode2/mgmt/cluster-health/history?device=<crc32>&component=<id>&start=<time>&end=<time>
+void
+HNManagementDevice::handleGetClusterHealthHistory( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    uint32_t    crc32ID = 0;
+    std::string compID;
+    time_t      start = 0;
+    time_t      end = time(NULL);
+
+    Poco::URI::QueryParameters params;
+
+    // A bad escape in the query makes the parse throw
+    try
+    {
+        Poco::URI uri( reqRR->getReqMsg().getURI() );
+        params = uri.getQueryParameters();
+    }
+    catch( Poco::Exception &ex )
+    {
+        std::cout << "handleGetClusterHealthHistory - bad query: " << ex.displayText() << std::endl;
+
+        reqRR->getRspMsg().configAsBadRequest();
+        return;
+    }
 
-            for( std::vector< HNMDServiceDevRef >::iterator pit = sit->getDeviceListRef().begin(); pit != sit->getDeviceListRef().end(); pit++ )
+    for( Poco::URI::QueryParameters::iterator it = params.begin(); it != params.end(); it++ )
+    {
+        if( it->first == "device" )
+        {
+            if( m_arbiter.parseCRC32IDStr( it->second, crc32ID ) != HNMDL_RESULT_SUCCESS )
             {
-                jsProvider.set( "name", pit->getDevName() );
-                jsProvider.set( "devCRC32ID", pit->getDevCRC32ID() );
-              
-                jsProviderArray.add( jsProvider );
+                reqRR->getRspMsg().configAsBadRequest();
+                return;
             }
-
-            jsMappingSet.set( sit->getSrvType(), jsProviderArray );
         }
+        else if( it->first == "component" )
+            compID = it->second;
+        else if( it->first == "start" )
+            start = strtol( it->second.c_str(), NULL, 10 );
+        else if( it->first == "end" )
+            end = strtol( it->second.c_str(), NULL, 10 );
+    }
 
-        std::vector< HNMDServiceAssoc > assocList;
-        m_arbiter.reportSrvDefaultMappings( assocList );
+    // Rendered directly from the history buffers into the response
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    m_arbiter.writeHealthHistoryAsJSON( msg, crc32ID, compID, start, end );
 
-        for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
-        {
-            pjs::Object jsAssoc;
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
+}
 
-            if( sit->getType() != HNMDSA_TYPE_DEFAULT )
-              continue;
+void
+HNManagementDevice::handleGetClusterHealth( HNSCGIRR *reqRR, HNOperationData *opData )
+{
+    std::string reportJSON;
+    uint64_t    generation;
 
-            jsAssoc.set( "providerCRC32ID", sit->getProviderCRC32ID() );
-              
-            jsDefaultSet.set( sit->getSrvType(), jsAssoc );
-        }        
+    // The arbiter only re-renders the report when health has changed.
+    m_arbiter.getClusterHealthReport( reportJSON, generation );
 
-        m_arbiter.reportSrvDirectedMappings( assocList );
+    std::string etag = "\"health-" + std::to_string( m_runEpoch ) + "-" + std::to_string( generation ) + "\"";
+
+    // If the client already has this version, then tell it so.
+    std::string clientETag;
+    if( (reqRR->getReqMsg().getHeader( "If-None-Match", clientETag ) == true) && (clientETag == etag) )
+    {
+        reqRR->getRspMsg().configAsNotModified();
+        reqRR->getRspMsg().addHdrPair( "ETag", etag );
+        return;
+    }
 
-        for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
+    std::ostream &msg = reqRR->getRspMsg().useLocalContentSource();
+    msg.write( reportJSON.data(), reportJSON.size() );
+
+    /*
+    pjs::Object jsProviderSet;
+    pjs::Object jsMappingSet;
+    pjs::Object jsDefaultSet;
+    pjs::Array  jsDirectedArray;
+
+    std::vector< HNMDServiceInfo > srvInfoList;
+    m_arbiter.reportSrvProviderInfoList( srvInfoList );
+
+    for( std::vector< HNMDServiceInfo >::iterator sit = srvInfoList.begin(); sit != srvInfoList.end(); sit++ )
+    {
+        pjs::Object jsProvider;
+        pjs::Array  jsProviderArray;
+
+        for( std::vector< HNMDServiceDevRef >::iterator pit = sit->getDeviceListRef().begin(); pit != sit->getDeviceListRef().end(); pit++ )
         {
-            pjs::Object jsAssoc;
+            jsProvider.set( "name", pit->getDevName() );
+            jsProvider.set( "devCRC32ID", pit->getDevCRC32ID() );
 
-            if( sit->getType() != HNMDSA_TYPE_DIRECTED )
-              continue;
+            jsProviderArray.add( jsProvider );
+        }
 
-            jsAssoc.set( "srvType", sit->getSrvType() );
-            jsAssoc.set( "desirerCRC32ID", sit->getDesirerCRC32ID() );
-            jsAssoc.set( "providerCRC32ID", sit->getProviderCRC32ID() );
-              
-            jsDirectedArray.add( jsAssoc );
-        }        
+        jsProviderSet.set( sit->getSrvType(), jsProviderArray );
+    }
 
-        // Report the provided, desired, default mappings, and directed mappings
-        jsRoot.set( "providerSet", jsProviderSet );
-        jsRoot.set( "mappingSet", jsMappingSet );
-        jsRoot.set( "defaultMappings", jsDefaultSet );
-        jsRoot.set( "directedMappings", jsDirectedArray );
-        */
-       
-        // Render into a json string.
-        //try {
-        //    pjs::Stringifier::stringify( jsRoot, msg );
-        //} catch( ... ) {
-            // Send back not implemented
-        //    reqRR->getRspMsg().configAsInternalServerError();
-        //    return;
-        //}
+    m_arbiter.reportSrvMappingInfoList( srvInfoList );
+
+    for( std::vector< HNMDServiceInfo >::iterator sit = srvInfoList.begin(); sit != srvInfoList.end(); sit++ )
+    {
+        pjs::Object jsProvider;
+        pjs::Array  jsProviderArray;
+
+        for( std::vector< HNMDServiceDevRef >::iterator pit = sit->getDeviceListRef().begin(); pit != sit->getDeviceListRef().end(); pit++ )
+        {
+            jsProvider.set( "name", pit->getDevName() );
+            jsProvider.set( "devCRC32ID", pit->getDevCRC32ID() );
+
+            jsProviderArray.add( jsProvider );
+        }
 
-        reqRR->getRspMsg().finalizeLocalContent();
-        reqRR->getRspMsg().setContentType("application/json");
-        reqRR->getRspMsg().setStatusCode(200);
-        reqRR->getRspMsg().setReason("OK");
-        return;      
+        jsMappingSet.set( sit->getSrvType(), jsProviderArray );
     }
 
-    // Send back not implemented
-    reqRR->getRspMsg().configAsNotFound();
-    return;
+    std::vector< HNMDServiceAssoc > assocList;
+    m_arbiter.reportSrvDefaultMappings( assocList );
+
+    for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
+    {
+        pjs::Object jsAssoc;
+
+        if( sit->getType() != HNMDSA_TYPE_DEFAULT )
+          continue;
+
+        jsAssoc.set( "providerCRC32ID", sit->getProviderCRC32ID() );
+
+        jsDefaultSet.set( sit->getSrvType(), jsAssoc );
+    }        
+
+    m_arbiter.reportSrvDirectedMappings( assocList );
+
+    for( std::vector< HNMDServiceAssoc >::iterator sit = assocList.begin(); sit != assocList.end(); sit++ )
+    {
+        pjs::Object jsAssoc;
+
+        if( sit->getType() != HNMDSA_TYPE_DIRECTED )
+          continue;
+
+        jsAssoc.set( "srvType", sit->getSrvType() );
+        jsAssoc.set( "desirerCRC32ID", sit->getDesirerCRC32ID() );
+        jsAssoc.set( "providerCRC32ID", sit->getProviderCRC32ID() );
+
+        jsDirectedArray.add( jsAssoc );
+    }        
+
+    // Report the provided, desired, default mappings, and directed mappings
+    jsRoot.set( "providerSet", jsProviderSet );
+    jsRoot.set( "mappingSet", jsMappingSet );
+    jsRoot.set( "defaultMappings", jsDefaultSet );
+    jsRoot.set( "directedMappings", jsDirectedArray );
+    */
+
+    // Render into a json string.
+    //try {
+    //    pjs::Stringifier::stringify( jsRoot, msg );
+    //} catch( ... ) {
+        // Send back not implemented
+    //    reqRR->getRspMsg().configAsInternalServerError();
+    //    return;
+    //}
+
+    reqRR->getRspMsg().finalizeLocalContent();
+    reqRR->getRspMsg().addHdrPair( "ETag", etag );
+    reqRR->getRspMsg().setStatusCode(200);
+    reqRR->getRspMsg().setReason("OK");
 }
 
 const std::string g_HNode2MgmtRest = R"(
@@ -1526,6 +2497,91 @@ const std::string g_HNode2ProxyMgmtAPI = R"(
             }
           }
         }
+      },
+
+      "/hnode2/mgmt/cluster-health/summary": {
+        "get": {
+          "summary": "Get counts of devices in each health status, in total, per device type and per provided service.",
+          "operationId": "getClusterHealthSummary",
+          "responses": {
+            "200": {
+              "description": "successful operation",
+              "content": {
+                "application/json": {
+                  "schema": {
+                    "type": "object"
+                  }
+                }
+              }
+            },
+            "304": {
+              "description": "Not modified"
+            }
+          }
+        }
+      },
+
+      "/hnode2/mgmt/cluster-health/history": {
+        "get": {
+          "summary": "Get the recorded health status transitions of device components, downsampled for older periods.",
+          "operationId": "getClusterHealthHistory",
+          "responses": {
+            "200": {
+              "description": "successful operation",
+              "content": {
+                "application/json": {
+                  "schema": {
+                    "type": "object"
+                  }
+                }
+              }
+            },
+            "400": {
+              "description": "Invalid device id"
+            }
+          }
+        }
+      },
+
+      "/hnode2/mgmt/events": {
+        "get": {
+          "summary": "Stream device added/removed, management state, ownership and health change events as Server-Sent Events.",
+          "operationId": "getEventStream",
+          "responses": {
+            "200": {
+              "description": "successful operation",
+              "content": {
+                "text/event-stream": {
+                  "schema": {
+                    "type": "string"
+                  }
+                }
+              }
+            }
+          }
+        }
+      },
+
+      "/hnode2/mgmt/cluster-health/changes": {
+        "get": {
+          "summary": "Get device health documents changed since the since token of an earlier response, waiting for a change if there are none.",
+          "operationId": "getClusterHealthChanges",
+          "responses": {
+            "200": {
+              "description": "successful operation",
+              "content": {
+                "application/json": {
+                  "schema": {
+                    "type": "object"
+                  }
+                }
+              }
+            },
+            "400": {
+              "description": "Invalid status value"
+            }
+          }
+        }
       }                                  
   }
 }
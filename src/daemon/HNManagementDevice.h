@@ -3,7 +3,13 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include <set>
+#include <unordered_map>
 
 #include "Poco/Util/ServerApplication.h"
 #include "Poco/Util/OptionSet.h"
@@ -13,15 +19,36 @@
 #include <hnode2/HNAvahiBrowser.h>
 #include <hnode2/HNSigSyncQueue.h>
 
+#include "HNEventReactor.h"
 #include "HNSCGISink.h"
 #include "HNManagedDeviceArbiter.h"
 #include "HNMgmtProxy.h"
+#include "HNMgmtRouteTrie.h"
 
 #define MAXEVENTS  8
 
 #define HNODE_MGMT_DEF_INSTANCE  "default"
 #define HNODE_MGMT_DEVTYPE   "hnode2-management-device"
 
+// Directory for the arbiter's health and string cache file
+#define HNODE_MGMT_CACHE_DIR  "/var/cache/hnode2"
+
+// Window, in milliseconds, over which discovery events are
+// coalesced before being applied to the arbiter.
+#define HNMD_DISCOVERY_BATCH_MSECS  250
+
+// Threads used to run local management request handlers
+#define HNMD_WORKER_THREAD_CNT  2
+
+// Fewest reactor threads.  The arbiter monitor and the proxy
+// sequencer block on device requests, and each holds at most one
+// thread, so this always leaves one for the sink and event loop.
+#define HNMD_REACTOR_MIN_THREADS  3
+
+// Default and maximum hold time, in seconds, for health change long-polls
+#define HNMD_HEALTH_POLL_DEF_TIMEOUT  30
+#define HNMD_HEALTH_POLL_MAX_TIMEOUT  120
+
 typedef enum HNManagementDeviceResultEnum
 {
   HNMD_RESULT_SUCCESS,
@@ -29,7 +56,136 @@ typedef enum HNManagementDeviceResultEnum
   HNMD_RESULT_NOT_AUTHORIZED
 }HNMD_RESULT_T;
 
-class HNManagementDevice : public Poco::Util::ServerApplication, public HNDEPDispatchInf, public HNDEventNotifyInf 
+// Operations served by the management device, resolved
+// from their OpenAPI operationId at registration time.
+typedef enum HNManagementDeviceOpcodeEnum
+{
+    HNMD_OPCODE_NONE,
+    HNMD_OPCODE_CREATE_AUTH_TOKEN,
+    HNMD_OPCODE_GET_STATUS,
+    HNMD_OPCODE_GET_DEVICE_INVENTORY,
+    HNMD_OPCODE_GET_DEVICE_MGMT_STATUS,
+    HNMD_OPCODE_POST_DEVICE_MGMT_COMMAND,
+    HNMD_OPCODE_GET_DEVICE_SERVICES,
+    HNMD_OPCODE_GET_CLUSTER_HEALTH,
+    HNMD_OPCODE_GET_CLUSTER_HEALTH_SUMMARY,
+    HNMD_OPCODE_GET_CLUSTER_HEALTH_HISTORY,
+    HNMD_OPCODE_GET_CLUSTER_HEALTH_CHANGES,
+    HNMD_OPCODE_GET_EVENT_STREAM,
+    HNMD_OPCODE_POST_HEALTH_EVENT,
+    HNMD_OPCODE_POST_LOG_EVENT,
+    HNMD_OPCODE_COUNT
+}HNMD_OPCODE_T;
+
+// Operation handler flags
+#define HNMD_OPF_BODY_REQUIRED  0x01   // Request content is read before the handler, and must not be empty
+#define HNMD_OPF_CACHEABLE      0x02   // Response carries an ETag and may be revalidated
+#define HNMD_OPF_DEFERRED       0x04   // Handler posts its own response
+
+class HNManagementDevice;
+
+typedef void (HNManagementDevice::*HNMDOpHandlerFunc)( HNSCGIRR *reqRR, HNOperationData *opData );
+
+// An entry in the local operation dispatch table
+class HNMDOpHandler
+{
+    public:
+        HNMDOpHandler();
+        HNMDOpHandler( HNMD_OPCODE_T opcode, std::string opID, HNMDOpHandlerFunc handler, uint flags, std::string contentType );
+       ~HNMDOpHandler();
+
+        HNMD_OPCODE_T getOpcode();
+        std::string getOpID();
+
+        HNMDOpHandlerFunc getHandler();
+
+        bool isBodyRequired();
+        bool isCacheable();
+        bool isDeferred();
+
+        std::string getContentType();
+
+    private:
+        HNMD_OPCODE_T     m_opcode;
+        std::string       m_opID;
+        HNMDOpHandlerFunc m_handler;
+        uint              m_flags;
+        std::string       m_contentType;
+};
+
+// A local request waiting for a worker thread
+class HNMDWorkItem
+{
+    public:
+        HNMDWorkItem( HNSCGIRR *reqRR, HNOperationData *opData, HNMD_OPCODE_T opcode );
+       ~HNMDWorkItem();
+
+        HNSCGIRR* getRR();
+        HNOperationData* getOpData();
+        HNMD_OPCODE_T getOpcode();
+
+    private:
+        HNSCGIRR        *m_reqRR;
+        HNOperationData *m_opData;
+        HNMD_OPCODE_T    m_opcode;
+};
+
+// Runs local request handlers off of the main event loop,
+// completed responses are posted to the response queue.
+class HNMDWorkerPool
+{
+    public:
+        HNMDWorkerPool();
+       ~HNMDWorkerPool();
+
+        void setParent( HNManagementDevice *parent );
+        void setResponseQueue( HNSigSyncQueue *responseQueue );
+
+        void start( uint threadCnt );
+        void shutdown();
+
+        // Takes ownership of opData
+        void queueRequest( HNSCGIRR *reqRR, HNOperationData *opData, HNMD_OPCODE_T opcode );
+
+        void runWorkerLoop();
+
+    private:
+        HNManagementDevice *m_parent;
+        HNSigSyncQueue     *m_responseQueue;
+
+        // The thread helpers
+        std::vector< void* > m_thelpList;
+
+        // Guards m_workQueue and m_runWorkers
+        std::mutex m_queueMutex;
+        std::condition_variable m_queueCV;
+
+        std::deque< HNMDWorkItem > m_workQueue;
+
+        bool m_runWorkers;
+};
+
+// A cluster health change request being held until
+// a change occurs or its deadline passes.
+class HNMDPendingHealthPoll
+{
+    public:
+        HNMDPendingHealthPoll( HNSCGIRR *reqRR, uint64_t epoch, uint64_t since, time_t deadline );
+       ~HNMDPendingHealthPoll();
+
+        HNSCGIRR* getRR();
+        uint64_t getEpoch();
+        uint64_t getSince();
+        time_t getDeadline();
+
+    private:
+        HNSCGIRR *m_reqRR;
+        uint64_t  m_epoch;
+        uint64_t  m_since;
+        time_t    m_deadline;
+};
+
+class HNManagementDevice : public Poco::Util::ServerApplication, public HNDEPDispatchInf, public HNDEventNotifyInf, public HNEventHandler
 {
     private:
         bool _helpRequested   = false;
@@ -38,6 +194,16 @@ class HNManagementDevice : public Poco::Util::ServerApplication, public HNDEPDis
 
         std::string _instance; 
 
+        bool _healthPollMaxPresent    = false;
+        bool _healthPollBudgetPresent = false;
+
+        uint _healthPollMax    = 0;
+        uint _healthPollBudget = 0;
+
+        bool _reactorThreadsPresent = false;
+
+        uint _reactorThreads = 0;
+
         std::string m_instanceName;
 
         int epollFD;
@@ -45,6 +211,21 @@ class HNManagementDevice : public Poco::Util::ServerApplication, public HNDEPDis
         struct epoll_event event;
         struct epoll_event *events;
 
+        // Event loop sources
+        HNAvahiBrowser *m_avBrowser = NULL;
+
+        int m_discoverFD = -1;
+        int m_scgiQFD    = -1;
+        int m_proxyQFD   = -1;
+        int m_arbiterQFD = -1;
+
+        // Set when the components share the reactor's threads
+        // instead of each running their own.  The timer wakes the
+        // event loop for its next deadline.
+        bool           m_useReactor  = false;
+        HNEventReactor m_reactor;
+        int            m_loopTimerFD = -1;
+
         HNodeDevice m_hnodeDev;
 
         HNManagedDeviceArbiter m_arbiter;
@@ -55,20 +236,99 @@ class HNManagementDevice : public Poco::Util::ServerApplication, public HNDEPDis
 
         HNSigSyncQueue         m_proxyResponseQueue;
 
+        HNSigSyncQueue         m_arbiterEventQueue;
+
+        // Discovery adds and removes waiting to be applied, coalesced
+        // by discovery id with the latest event winning, and when the
+        // batch is due.  Event loop thread only.
+        std::map< std::string, HNMDARecord > m_discoveryBatch;
+        std::set< std::string > m_discoveryRemoveSet;
+        uint64_t m_discoveryBatchDeadline = 0;
+
+        // Health change requests waiting for a change.  The sink
+        // thread drops entries whose client has gone away.
+        std::mutex m_pendingPollMutex;
+        std::list< HNMDPendingHealthPoll > m_pendingHealthPolls;
+
         std::vector< HNRestPath > m_proxyPathList;
 
+        // Opcode for each entry of m_proxyPathList
+        std::vector< HNMD_OPCODE_T > m_proxyOpcodeList;
+
+        // Compiled from m_proxyPathList, leaf routes index into it.
+        HNMgmtRouteTrie m_routeTrie;
+
+        // Indexed by opcode
+        std::vector< HNMDOpHandler > m_opTable;
+
+        std::unordered_map< std::string, HNMD_OPCODE_T > m_opcodeMap;
+
+        HNMDWorkerPool m_workerPool;
+
+        // Cached device-inventory response body, and the
+        // arbiter inventory version it was rendered from.
+        // Guarded by m_inventoryMutex, workers share it.
+        std::mutex  m_inventoryMutex;
+        uint64_t    m_inventoryJSONVersion = 0;
+        std::string m_inventoryJSON;
+
+        // Inventory and health versions restart with the daemon,
+        // so their ETags also carry when this run started.
+        time_t      m_runEpoch = 0;
+
         bool quit;
 
+    friend class HNMDWorkerPool;
+
         void displayHelp();
 
         HNMD_RESULT_T addSocketToEPoll( int sfd );
         HNMD_RESULT_T removeSocketFromEPoll( int sfd );
 
+        void handleEvent( int fd, uint32_t events );
+
+        // Work that comes due with time rather than an event
+        void checkDeadlines();
+
+        // Milliseconds until the next deadline, -1 if there is none
+        int getNextDeadlineMS();
+
         HNRestPath* addProxyPath( std::string dispatchID, std::string operationID, HNRestDispatchInterface *dispatchInf );
         void registerProxyEndpointsFromOpenAPI( std::string openAPIJson );
-        HNProxyTicket* checkForProxyRequest( HNSCGIRR *reqRR );
-        HNOperationData* mapProxyRequest( HNSCGIRR *reqRR );
-        void handleLocalSCGIRequest( HNSCGIRR *reqRR, HNOperationData *opData );
+        HNProxyTicket* checkForProxyRequest( HNSCGIRR *reqRR, HNMgmtRouteMatch &route );
+        HNOperationData* mapProxyRequest( HNSCGIRR *reqRR, HNMgmtRouteMatch &route );
+
+        void initOpHandlerTable();
+        void registerOpHandler( HNMD_OPCODE_T opcode, std::string opID, HNMDOpHandlerFunc handler, uint flags, std::string contentType );
+        HNMD_OPCODE_T lookupOpcode( std::string opID );
+
+        // Returns true if the response is ready to be posted.  Called
+        // from the worker threads, except for deferred operations.
+        bool handleLocalSCGIRequest( HNSCGIRR *reqRR, HNOperationData *opData, HNMD_OPCODE_T opcode );
+
+        void handleCreateAuthToken( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handleGetStatus( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handleGetDeviceInventory( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handleGetDeviceMgmtStatus( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handlePostDeviceMgmtCommand( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handleGetDeviceServices( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handleGetClusterHealth( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handleGetClusterHealthSummary( HNSCGIRR *reqRR, HNOperationData *opData );
+        void handleGetClusterHealthHistory( HNSCGIRR *reqRR, HNOperationData *opData );
+
+        HNMD_RESULT_T renderDeviceInventory( HNMDInventorySnapshotPtr inventory, std::string &buffer );
+
+        void handleEventStreamRequest( HNSCGIRR *reqRR, HNOperationData *opData );
+        void publishChangeEvent( HNMDChangeEvent *event );
+
+        void queueDiscoveryEvent( HNAvahiBrowserEvent *event );
+        void checkDiscoveryBatch( uint64_t now );
+        bool isDiscoveryBatchPending();
+
+        void handleHealthChangesRequest( HNSCGIRR *reqRR, HNOperationData *opData );
+        bool fillHealthChangesResponse( HNSCGIRR *reqRR, uint64_t epoch, uint64_t since, bool force );
+        void checkPendingHealthPolls();
+        static bool pendingHealthPollClosed( HNSCGIRR *reqRR, void *objAddr );
 
         bool configExists();
         HNMD_RESULT_T initConfig();
@@ -84,6 +344,9 @@ class HNManagementDevice : public Poco::Util::ServerApplication, public HNDEPDis
 
         virtual void hndnConfigChange( HNodeDevice *parent );
 
+        // Reactor event for the event loop
+        virtual void handleReactorEvent( int fd, uint32_t events );
+
         void defineOptions( Poco::Util::OptionSet& options );
         void handleOption( const std::string& name, const std::string& value );
         int main( const std::vector<std::string>& args );
@@ -4,8 +4,10 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
 #include <sys/un.h>
 #include <sys/socket.h>
+#include <sys/eventfd.h>
 
 #include <syslog.h>
 
@@ -14,6 +16,7 @@
 
 #include "Poco/Thread.h"
 #include "Poco/Runnable.h"
+#include "Poco/Exception.h"
 #include <Poco/StreamCopier.h>
 #include "Poco/Net/HTTPClientSession.h"
 #include "Poco/Net/HTTPRequest.h"
@@ -157,6 +160,12 @@ HNProxyPocoHelper::waitForResponse( HNProxyTicket *reqTicket )
 HNProxyTicket::HNProxyTicket( HNSCGIRR *parentRR )
 {
     m_parentRR = parentRR;
+
+    m_crc32Val = 0;
+    m_port     = 0;
+
+    m_success  = false;
+    m_rttMS    = 0;
 }
 
 HNProxyTicket::~HNProxyTicket()
@@ -170,6 +179,12 @@ HNProxyTicket::setCRC32ID( std::string id )
     m_crc32ID = id;
 }
 
+void
+HNProxyTicket::setCRC32Val( uint32_t value )
+{
+    m_crc32Val = value;
+}
+
 void 
 HNProxyTicket::setAddress( std::string address )
 {
@@ -204,6 +219,12 @@ HNProxyTicket::getCRC32ID()
     return m_crc32ID;
 }
 
+uint32_t
+HNProxyTicket::getCRC32Val()
+{
+    return m_crc32Val;
+}
+
 std::string
 HNProxyTicket::getAddress()
 {
@@ -234,6 +255,25 @@ HNProxyTicket::getRR()
     return m_parentRR;
 }
 
+void
+HNProxyTicket::setResult( bool success, uint rttMS )
+{
+    m_success = success;
+    m_rttMS   = rttMS;
+}
+
+bool
+HNProxyTicket::isSuccess()
+{
+    return m_success;
+}
+
+uint
+HNProxyTicket::getRTT()
+{
+    return m_rttMS;
+}
+
 // Helper class for running HNSCGISink  
 // proxy loop as an independent thread
 class HNProxySequencerRunner : public Poco::Runnable
@@ -269,7 +309,15 @@ class HNProxySequencerRunner : public Poco::Runnable
 
 HNProxySequencer::HNProxySequencer()
 {
-
+    m_thelp = NULL;
+    m_runMonitor = false;
+    m_reactor = NULL;
+    m_epollFD = -1;
+    m_acceptFD = -1;
+    m_requestQFD = -1;
+    m_shutdownFD = -1;
+    m_events = NULL;
+    m_responseQueue = NULL;
 }
 
 HNProxySequencer::~HNProxySequencer()
@@ -296,6 +344,9 @@ HNProxySequencer::start()
 
     std::cout << "HNProxySequencer::start()" << std::endl;
 
+    // Signals the loop to exit
+    m_shutdownFD = eventfd( 0, EFD_NONBLOCK );
+
     // Allocate the thread helper
     m_thelp = new HNProxySequencerRunner( this );
     if( !m_thelp )
@@ -326,24 +377,18 @@ HNProxySequencer::runProxySequencerLoop()
     // Buffer where events are returned 
     m_events = (struct epoll_event *) calloc( MAXEVENTS, sizeof m_event );
 
-    // Initialize the proxyResponseQueue
-    // and add it to the epoll loop
-    m_requestQueue.init();
-    int requestQFD = m_requestQueue.getEventFD();
-    addSocketToEPoll( requestQFD );
+    initEventSources();
 
-    // The listen loop 
+    addSocketToEPoll( m_shutdownFD );
+
+    // The listen loop, nothing here is time driven
     while( m_runMonitor == true )
     {
         int n;
         int i;
-        struct tm newtime;
-        time_t ltime;
 
         // Check for events
-        n = epoll_wait( m_epollFD, m_events, MAXEVENTS, 2000 );
-
-        std::cout << "HNProxySequencer::monitor wakeup" << std::endl;
+        n = epoll_wait( m_epollFD, m_events, MAXEVENTS, -1 );
 
         // EPoll error
         if( n < 0 )
@@ -357,31 +402,57 @@ HNProxySequencer::runProxySequencerLoop()
             return;
         }
  
-        // If it was a timeout then continue to next loop
-        // skip socket related checks.
-        if( n == 0 )
-            continue;
-
-        // Socket event
+        // Socket event, a shutdown is seen through m_runMonitor
         for( i = 0; i < n; i++ )
-	    {
-            if( requestQFD == m_events[i].data.fd )
-            {
-                while( m_requestQueue.getPostedCnt() )
-                {
-                    HNProxyTicket *request = (HNProxyTicket *) m_requestQueue.aquireRecord();
-
-                    std::cout << "HNProxySequencer::Received proxy request" << std::endl;
-
-                    executeProxyRequest( request );
-                }
-            }
-        }
+            handleEvent( m_events[i].data.fd, m_events[i].events );
     }
 
     std::cout << "HNProxySequencer::monitor exit" << std::endl;
 }
 
+void
+HNProxySequencer::startOnReactor( HNEventReactor *reactor )
+{
+    std::cout << "HNProxySequencer::startOnReactor()" << std::endl;
+
+    m_reactor = reactor;
+
+    initEventSources();
+}
+
+HNPS_RESULT_T
+HNProxySequencer::initEventSources()
+{
+    // Initialize the request queue
+    // and add it to the epoll loop
+    m_requestQueue.init();
+    m_requestQFD = m_requestQueue.getEventFD();
+
+    return addSocketToEPoll( m_requestQFD );
+}
+
+void
+HNProxySequencer::handleReactorEvent( int fd, uint32_t events )
+{
+    handleEvent( fd, events );
+}
+
+void
+HNProxySequencer::handleEvent( int fd, uint32_t events )
+{
+    if( m_requestQFD != fd )
+        return;
+
+    while( m_requestQueue.getPostedCnt() )
+    {
+        HNProxyTicket *request = (HNProxyTicket *) m_requestQueue.aquireRecord();
+
+        std::cout << "HNProxySequencer::Received proxy request" << std::endl;
+
+        executeProxyRequest( request );
+    }
+}
+
 void
 HNProxySequencer::shutdown()
 {
@@ -396,12 +467,21 @@ HNProxySequencer::shutdown()
 
     delete ( (HNProxySequencerRunner*) m_thelp );
     m_thelp = NULL;
+
+    close( m_shutdownFD );
+    m_shutdownFD = -1;
 }
 
 void 
 HNProxySequencer::killProxySequencerLoop()
 {
+    uint64_t value = 1;
+
     m_runMonitor = false;    
+
+    // Wake the loop so it sees the flag
+    if( write( m_shutdownFD, &value, sizeof(value) ) != sizeof(value) )
+        syslog( LOG_ERR, "HNProxySequencer - Failed to signal shutdown: %s", strerror(errno) );
 }
 
 HNPS_RESULT_T
@@ -409,6 +489,10 @@ HNProxySequencer::addSocketToEPoll( int sfd )
 {
     int flags, s;
 
+    // Hosted on a shared reactor
+    if( m_reactor != NULL )
+        return (m_reactor->addFD( sfd, this ) == HNER_RESULT_SUCCESS) ? HNPS_RESULT_SUCCESS : HNPS_RESULT_FAILURE;
+
     flags = fcntl( sfd, F_GETFL, 0 );
     if( flags == -1 )
     {
@@ -440,6 +524,9 @@ HNProxySequencer::removeSocketFromEPoll( int sfd )
 {
     int s;
 
+    if( m_reactor != NULL )
+        return (m_reactor->removeFD( sfd ) == HNER_RESULT_SUCCESS) ? HNPS_RESULT_SUCCESS : HNPS_RESULT_FAILURE;
+
     s = epoll_ctl( m_epollFD, EPOLL_CTL_DEL, sfd, NULL );
     if( s == -1 )
     {
@@ -460,28 +547,46 @@ HNProxySequencer::executeProxyRequest( HNProxyTicket *reqTicket )
     std::cout << "Allocated new HNProxyPocoHelper: " << ph << std::endl;
     reqTicket->getRR()->addShutdownCall( HNProxyPocoHelperDeleteFunction, ph );
 
-    ph->init( reqTicket );
+    if( m_responseQueue == NULL )
+        return HNPS_RESULT_FAILURE;
 
-    result = ph->initiateRequest( reqTicket );
-    while( result == HNSS_RESULT_MSG_CONTENT )
+    struct timespec startTS;
+    clock_gettime( CLOCK_MONOTONIC, &startTS );
+
+    // Failures still go back to the parent, which answers the
+    // client and marks the device address as failing.
+    try
     {
-        result = reqMsg.xferContentChunk( 4096 );
-    }
+        ph->init( reqTicket );
 
-    if( result != HNSS_RESULT_MSG_COMPLETE )
+        result = ph->initiateRequest( reqTicket );
+        while( result == HNSS_RESULT_MSG_CONTENT )
+        {
+            result = reqMsg.xferContentChunk( 4096 );
+        }
+
+        if( result == HNSS_RESULT_MSG_COMPLETE )
+            result = ph->waitForResponse( reqTicket );
+        else
+            result = HNSS_RESULT_FAILURE;
+    }
+    catch( Poco::Exception &ex )
     {
-        return HNPS_RESULT_FAILURE;
+        std::cout << "Proxy request failed - address: " << reqTicket->getAddress() << "  error: " << ex.displayText() << std::endl;
+        result = HNSS_RESULT_FAILURE;
     }
 
-    result = ph->waitForResponse( reqTicket );
-
     if( (result != HNSS_RESULT_MSG_COMPLETE) && (result != HNSS_RESULT_MSG_CONTENT) )
     {
+        reqTicket->setResult( false, 0 );
+        m_responseQueue->postRecord( reqTicket );
         return HNPS_RESULT_FAILURE;
     }
 
-    if( m_responseQueue == NULL )
-        return HNPS_RESULT_FAILURE;
+    struct timespec endTS;
+    clock_gettime( CLOCK_MONOTONIC, &endTS );
+
+    reqTicket->setResult( true, ((endTS.tv_sec - startTS.tv_sec) * 1000) + ((endTS.tv_nsec - startTS.tv_nsec) / 1000000) );
 
     m_responseQueue->postRecord( reqTicket );
 
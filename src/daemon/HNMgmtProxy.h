@@ -25,6 +25,7 @@
 #include <hnode2/HNSigSyncQueue.h>
 
 #include "HNSCGISink.h"
+#include "HNEventReactor.h"
 
 //namespace pjs = Poco::JSON;
 //namespace pdy = Poco::Dynamic;
@@ -44,6 +45,7 @@ class HNProxyTicket
        ~HNProxyTicket();
 
         void setCRC32ID( std::string id );
+        void setCRC32Val( uint32_t value );
         void setAddress( std::string addr );
         void setPort( uint16_t port );
         void setQueryStr( std::string query );
@@ -51,6 +53,7 @@ class HNProxyTicket
         void buildProxyPath( std::vector< std::string > &segments );
 
         std::string getCRC32ID();
+        uint32_t getCRC32Val();
         std::string getAddress();
         uint16_t getPort();
         std::string getProxyPath();
@@ -59,18 +62,28 @@ class HNProxyTicket
 
         HNSCGIRR* getRR();
 
+        // Outcome of contacting the device, and the time
+        // until its response headers arrived.
+        void setResult( bool success, uint rttMS );
+        bool isSuccess();
+        uint getRTT();
+
     private:
         HNSCGIRR    *m_parentRR;
 
         std::string  m_crc32ID;
+        uint32_t     m_crc32Val;
         std::string  m_address;
         uint16_t     m_port;
         std::string  m_queryStr;
         std::string  m_proxyPathStr;
+
+        bool         m_success;
+        uint         m_rttMS;
 };
 
 // Perform the proxy request operations
-class HNProxySequencer
+class HNProxySequencer : public HNEventHandler
 {
     public:
         HNProxySequencer();
@@ -80,6 +93,7 @@ class HNProxySequencer
         HNSigSyncQueue* getRequestQueue();
 
         void start();
+        void startOnReactor( HNEventReactor *reactor );
         void runProxySequencerLoop();
         void shutdown();
         void killProxySequencerLoop();
@@ -89,6 +103,8 @@ class HNProxySequencer
 
         HNPS_RESULT_T executeProxyRequest( HNProxyTicket *request );
 
+        virtual void handleReactorEvent( int fd, uint32_t events );
+
     private:
             // The thread helper
         void *m_thelp;
@@ -96,8 +112,15 @@ class HNProxySequencer
         // Should the monitor still be running.
         bool m_runMonitor;
 
+        // Set when hosted on a shared reactor instead of our own thread
+        HNEventReactor *m_reactor;
+
         int m_epollFD;
         int m_acceptFD;
+        int m_requestQFD;
+
+        // Written to end our own loop, so it can wait without a timeout
+        int m_shutdownFD;
     
         struct epoll_event m_event;
         struct epoll_event *m_events;
@@ -105,6 +128,9 @@ class HNProxySequencer
         HNSigSyncQueue  m_requestQueue;
 
         HNSigSyncQueue *m_responseQueue;
+
+        HNPS_RESULT_T initEventSources();
+        void handleEvent( int fd, uint32_t events );
 };
 
 #endif // __HN_MGMT_PROXY_H__
@@ -0,0 +1,324 @@
+#include <ctype.h>
+
+#include <iostream>
+
+#include "HNMgmtRouteTrie.h"
+
+static int
+hexNibble( char c )
+{
+    if( (c >= '0') && (c <= '9') )
+        return c - '0';
+    if( (c >= 'a') && (c <= 'f') )
+        return c - 'a' + 10;
+    if( (c >= 'A') && (c <= 'F') )
+        return c - 'A' + 10;
+    return -1;
+}
+
+static std::string
+upperMethod( const std::string &method )
+{
+    std::string rtnStr( method );
+
+    for( std::string::iterator it = rtnStr.begin(); it != rtnStr.end(); it++ )
+        *it = toupper( *it );
+
+    return rtnStr;
+}
+
+HNMgmtRouteMatch::HNMgmtRouteMatch()
+{
+    m_kind = HNMRT_KIND_NONE;
+    m_routeIndex  = 0;
+    m_prefixDepth = 0;
+}
+
+HNMgmtRouteMatch::~HNMgmtRouteMatch()
+{
+
+}
+
+void
+HNMgmtRouteMatch::clear()
+{
+    m_kind = HNMRT_KIND_NONE;
+    m_opID.clear();
+    m_routeIndex  = 0;
+    m_prefixDepth = 0;
+
+    m_segments.clear();
+    m_rawQuery.clear();
+    m_captures.clear();
+    m_params.clear();
+}
+
+HNMRT_KIND_T
+HNMgmtRouteMatch::getKind()
+{
+    return m_kind;
+}
+
+std::string
+HNMgmtRouteMatch::getOpID()
+{
+    return m_opID;
+}
+
+uint
+HNMgmtRouteMatch::getRouteIndex()
+{
+    return m_routeIndex;
+}
+
+bool
+HNMgmtRouteMatch::getParam( std::string name, std::string &value )
+{
+    std::map< std::string, std::string >::iterator it = m_params.find( name );
+
+    if( it == m_params.end() )
+        return false;
+
+    value = it->second;
+    return true;
+}
+
+std::vector< std::string >&
+HNMgmtRouteMatch::getSegmentsRef()
+{
+    return m_segments;
+}
+
+void
+HNMgmtRouteMatch::getRemainder( std::vector< std::string > &segments )
+{
+    segments.clear();
+
+    if( m_prefixDepth >= m_segments.size() )
+        return;
+
+    segments.assign( m_segments.begin() + m_prefixDepth, m_segments.end() );
+}
+
+std::string
+HNMgmtRouteMatch::getRawQuery()
+{
+    return m_rawQuery;
+}
+
+HNMRTRoute::HNMRTRoute()
+{
+    m_routeIndex = 0;
+}
+
+HNMRTRoute::~HNMRTRoute()
+{
+
+}
+
+HNMRTNode::HNMRTNode()
+{
+    m_paramChild = NULL;
+    m_hasPrefix  = false;
+}
+
+HNMRTNode::~HNMRTNode()
+{
+    for( std::map< std::string, HNMRTNode* >::iterator it = m_literalMap.begin(); it != m_literalMap.end(); it++ )
+        delete it->second;
+
+    if( m_paramChild != NULL )
+        delete m_paramChild;
+}
+
+HNMgmtRouteTrie::HNMgmtRouteTrie()
+{
+
+}
+
+HNMgmtRouteTrie::~HNMgmtRouteTrie()
+{
+
+}
+
+HNMRTNode*
+HNMgmtRouteTrie::buildPath( std::string pathTemplate, std::vector< std::string > &paramNames )
+{
+    std::vector< std::string > segments;
+    std::string query;
+    HNMRTNode *node = &m_root;
+
+    splitRawURI( pathTemplate, segments, query );
+
+    for( std::vector< std::string >::iterator sit = segments.begin(); sit != segments.end(); sit++ )
+    {
+        // Check if this is a parameter or a regular path element.
+        if( (sit->size() >= 2) && (sit->front() == '{') && (sit->back() == '}') )
+        {
+            paramNames.push_back( std::string( (sit->begin() + 1), (sit->end() - 1) ) );
+
+            if( node->m_paramChild == NULL )
+                node->m_paramChild = new HNMRTNode;
+
+            node = node->m_paramChild;
+            continue;
+        }
+
+        std::map< std::string, HNMRTNode* >::iterator it = node->m_literalMap.find( *sit );
+
+        if( it == node->m_literalMap.end() )
+            it = node->m_literalMap.insert( std::pair< std::string, HNMRTNode* >( *sit, new HNMRTNode ) ).first;
+
+        node = it->second;
+    }
+
+    return node;
+}
+
+void
+HNMgmtRouteTrie::addRoute( std::string method, std::string pathTemplate, std::string opID, uint routeIndex )
+{
+    HNMRTRoute route;
+
+    HNMRTNode *node = buildPath( pathTemplate, route.m_paramNames );
+
+    route.m_opID = opID;
+    route.m_routeIndex = routeIndex;
+
+    std::string methodKey = upperMethod( method );
+
+    if( node->m_methodMap.find( methodKey ) != node->m_methodMap.end() )
+        std::cout << "WARNING: Duplicate route - " << methodKey << " " << pathTemplate << std::endl;
+
+    node->m_methodMap[ methodKey ] = route;
+}
+
+void
+HNMgmtRouteTrie::addPrefixRoute( std::string pathTemplate, std::string opID )
+{
+    HNMRTRoute route;
+
+    HNMRTNode *node = buildPath( pathTemplate, route.m_paramNames );
+
+    route.m_opID = opID;
+
+    node->m_hasPrefix   = true;
+    node->m_prefixRoute = route;
+}
+
+void
+HNMgmtRouteTrie::splitRawURI( const std::string &rawURI, std::vector< std::string > &segments, std::string &rawQuery )
+{
+    std::string segment;
+    std::string::size_type i = 0;
+
+    // Walk the path a byte at a time, decoding escapes and
+    // splitting on '/'.  Empty segments are skipped.
+    for( ; i < rawURI.size(); i++ )
+    {
+        char c = rawURI[i];
+
+        if( (c == '?') || (c == '#') )
+            break;
+
+        if( c == '/' )
+        {
+            if( segment.empty() == false )
+            {
+                segments.push_back( segment );
+                segment.clear();
+            }
+            continue;
+        }
+
+        if( (c == '%') && ((i + 2) < rawURI.size()) )
+        {
+            int hi = hexNibble( rawURI[i+1] );
+            int lo = hexNibble( rawURI[i+2] );
+
+            if( (hi >= 0) && (lo >= 0) )
+            {
+                segment += (char) ((hi << 4) | lo);
+                i += 2;
+                continue;
+            }
+        }
+
+        segment += c;
+    }
+
+    if( segment.empty() == false )
+        segments.push_back( segment );
+
+    // Keep the query encoded, up to any fragment
+    if( (i < rawURI.size()) && (rawURI[i] == '?') )
+    {
+        std::string::size_type end = rawURI.find( '#', i + 1 );
+        rawQuery = rawURI.substr( i + 1, (end == std::string::npos) ? std::string::npos : (end - i - 1) );
+    }
+}
+
+void
+HNMgmtRouteTrie::fillResult( HNMRTRoute &route, HNMRT_KIND_T kind, HNMgmtRouteMatch &result )
+{
+    result.m_kind = kind;
+    result.m_opID = route.m_opID;
+    result.m_routeIndex = route.m_routeIndex;
+
+    for( uint i = 0; (i < route.m_paramNames.size()) && (i < result.m_captures.size()); i++ )
+        result.m_params[ route.m_paramNames[i] ] = result.m_captures[i];
+}
+
+bool
+HNMgmtRouteTrie::matchNode( HNMRTNode *node, const std::string &method, uint depth, HNMgmtRouteMatch &result )
+{
+    if( depth == result.m_segments.size() )
+    {
+        std::map< std::string, HNMRTRoute >::iterator it = node->m_methodMap.find( method );
+
+        if( it != node->m_methodMap.end() )
+        {
+            fillResult( it->second, HNMRT_KIND_LOCAL, result );
+            return true;
+        }
+    }
+    else
+    {
+        const std::string &segment = result.m_segments[ depth ];
+
+        std::map< std::string, HNMRTNode* >::iterator it = node->m_literalMap.find( segment );
+
+        if( (it != node->m_literalMap.end()) && (matchNode( it->second, method, depth + 1, result ) == true) )
+            return true;
+
+        if( node->m_paramChild != NULL )
+        {
+            result.m_captures.push_back( segment );
+
+            if( matchNode( node->m_paramChild, method, depth + 1, result ) == true )
+                return true;
+
+            result.m_captures.pop_back();
+        }
+    }
+
+    // Nothing longer matched, fall back to a prefix rooted here
+    if( node->m_hasPrefix == true )
+    {
+        result.m_prefixDepth = depth;
+        fillResult( node->m_prefixRoute, HNMRT_KIND_PREFIX, result );
+        return true;
+    }
+
+    return false;
+}
+
+bool
+HNMgmtRouteTrie::match( const std::string &method, const std::string &rawURI, HNMgmtRouteMatch &result )
+{
+    result.clear();
+
+    splitRawURI( rawURI, result.m_segments, result.m_rawQuery );
+
+    return matchNode( &m_root, upperMethod( method ), 0, result );
+}
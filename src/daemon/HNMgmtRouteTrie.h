@@ -0,0 +1,127 @@
+#ifndef __HN_MGMT_ROUTE_TRIE_H__
+#define __HN_MGMT_ROUTE_TRIE_H__
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+typedef enum HNMgmtRouteKindEnum
+{
+    HNMRT_KIND_NONE,
+    HNMRT_KIND_LOCAL,     // A registered method + path
+    HNMRT_KIND_PREFIX     // A prefix route, matches any remainder and method
+}HNMRT_KIND_T;
+
+// The outcome of matching a request against the trie
+class HNMgmtRouteMatch
+{
+    public:
+        HNMgmtRouteMatch();
+       ~HNMgmtRouteMatch();
+
+        void clear();
+
+        HNMRT_KIND_T getKind();
+        std::string getOpID();
+
+        // Index the route was registered with
+        uint getRouteIndex();
+
+        // Returns true if the named parameter was captured
+        bool getParam( std::string name, std::string &value );
+
+        // All decoded path segments of the request
+        std::vector< std::string >& getSegmentsRef();
+
+        // Segments past the end of a prefix route
+        void getRemainder( std::vector< std::string > &segments );
+
+        std::string getRawQuery();
+
+    private:
+        HNMRT_KIND_T m_kind;
+        std::string  m_opID;
+        uint         m_routeIndex;
+        uint         m_prefixDepth;
+
+        std::vector< std::string > m_segments;
+        std::string m_rawQuery;
+
+        std::vector< std::string > m_captures;
+        std::map< std::string, std::string > m_params;
+
+    friend class HNMgmtRouteTrie;
+};
+
+// A route ending at a trie node
+class HNMRTRoute
+{
+    public:
+        HNMRTRoute();
+       ~HNMRTRoute();
+
+    private:
+        std::string m_opID;
+        uint        m_routeIndex;
+
+        // Parameter names in path order, captures are positional
+        std::vector< std::string > m_paramNames;
+
+    friend class HNMgmtRouteTrie;
+};
+
+class HNMRTNode
+{
+    public:
+        HNMRTNode();
+       ~HNMRTNode();
+
+    private:
+        // Literal path segments
+        std::map< std::string, HNMRTNode* > m_literalMap;
+
+        // Any single segment, tried after the literals
+        HNMRTNode *m_paramChild;
+
+        // Upper case method to the route ending here
+        std::map< std::string, HNMRTRoute > m_methodMap;
+
+        // Prefix route rooted at this node, if any
+        bool       m_hasPrefix;
+        HNMRTRoute m_prefixRoute;
+
+    friend class HNMgmtRouteTrie;
+};
+
+// Segment trie of the management REST paths.  Built once at
+// startup, then matched against each request by walking the
+// raw URI bytes.  Literal segments take precedence over
+// parameters, and the longest registered path wins over a
+// prefix route.
+class HNMgmtRouteTrie
+{
+    public:
+        HNMgmtRouteTrie();
+       ~HNMgmtRouteTrie();
+
+        // Path templates are of the form /a/b/{param}/c
+        void addRoute( std::string method, std::string pathTemplate, std::string opID, uint routeIndex );
+        void addPrefixRoute( std::string pathTemplate, std::string opID );
+
+        bool match( const std::string &method, const std::string &rawURI, HNMgmtRouteMatch &result );
+
+    private:
+        HNMRTNode m_root;
+
+        HNMRTNode* buildPath( std::string pathTemplate, std::vector< std::string > &paramNames );
+
+        bool matchNode( HNMRTNode *node, const std::string &method, uint depth, HNMgmtRouteMatch &result );
+
+        void fillResult( HNMRTRoute &route, HNMRT_KIND_T kind, HNMgmtRouteMatch &result );
+
+        static void splitRawURI( const std::string &rawURI, std::vector< std::string > &segments, std::string &rawQuery );
+};
+
+#endif // __HN_MGMT_ROUTE_TRIE_H__
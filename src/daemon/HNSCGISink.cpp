@@ -7,6 +7,7 @@
 #include <sys/un.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
 #include <grp.h>
 
 #include <syslog.h>
@@ -84,6 +85,11 @@ HNSCGIMsg::addSCGIRequestHeader( std::string name, std::string value )
 
             return;
         }
+        else if( Poco::icompare( name, "HTTP_IF_NONE_MATCH") == 0 )
+        {
+            addHdrPair( "If-None-Match", value );
+            return;
+        }
         else if( Poco::icompare( name, "REQUEST_URI") == 0 )
         {
             setURI( value );
@@ -129,6 +135,18 @@ HNSCGIMsg::hasHeader( std::string name )
     return true;
 }
 
+bool 
+HNSCGIMsg::getHeader( std::string name, std::string &value )
+{
+    std::map< std::string, std::string >::iterator it = m_paramMap.find( name ); 
+
+    if( it == m_paramMap.end() )
+        return false;
+
+    value = it->second;
+    return true;
+}
+
 const std::string& 
 HNSCGIMsg::getURI() const
 {
@@ -203,6 +221,16 @@ HNSCGIMsg::setContentType( std::string typeStr )
     m_paramMap.insert( std::pair<std::string, std::string>("Content-Type", typeStr) );
 }
 
+void 
+HNSCGIMsg::configAsBadRequest()
+{
+    clearHeaders();
+
+    setStatusCode( 400 );
+    setReason("Bad Request");
+    setContentLength( 0 );
+}
+
 void 
 HNSCGIMsg::configAsNotImplemented()
 {
@@ -233,6 +261,26 @@ HNSCGIMsg::configAsInternalServerError()
     setContentLength( 0 );
 }
 
+void 
+HNSCGIMsg::configAsBadGateway()
+{
+    clearHeaders();
+
+    setStatusCode( 502 );
+    setReason("Bad Gateway");
+    setContentLength( 0 );
+}
+
+void 
+HNSCGIMsg::configAsNotModified()
+{
+    clearHeaders();
+
+    setStatusCode( 304 );
+    setReason("Not Modified");
+    setContentLength( 0 );
+}
+
 uint 
 HNSCGIMsg::getStatusCode()
 {
@@ -442,6 +490,14 @@ HNSCGIRR::HNSCGIRR( uint fd, HNSCGISink *parent )
     m_parent  = parent;
     m_rxState = HNSCGI_SS_IDLE;
 
+    m_streaming = false;
+
+    m_pending = false;
+    m_closed  = false;
+
+    m_closeFunc = NULL;
+    m_closeObj  = NULL;
+
     m_request.setContentSource( this );
     m_response.setContentSink( this );
 }
@@ -473,6 +529,58 @@ HNSCGIRR::getRspMsg()
     return m_response;
 }
 
+void
+HNSCGIRR::setStreaming( bool value )
+{
+    m_streaming = value;
+}
+
+bool
+HNSCGIRR::isStreaming()
+{
+    return m_streaming;
+}
+
+void
+HNSCGIRR::setPending( bool value )
+{
+    m_pending = value;
+}
+
+bool
+HNSCGIRR::isPending()
+{
+    return m_pending;
+}
+
+void
+HNSCGIRR::setClosed( bool value )
+{
+    m_closed = value;
+}
+
+bool
+HNSCGIRR::isClosed()
+{
+    return m_closed;
+}
+
+void
+HNSCGIRR::setCloseCall( CLOSE_CALL_FNPTR_T funcPtr, void *objAddr )
+{
+    m_closeFunc = funcPtr;
+    m_closeObj  = objAddr;
+}
+
+bool
+HNSCGIRR::notifyClose()
+{
+    if( m_closeFunc == NULL )
+        return false;
+
+    return m_closeFunc( this, m_closeObj );
+}
+
 void
 HNSCGIRR::setRxParseState( HNSC_SS_T newState )
 {
@@ -831,6 +939,22 @@ HNSCGIRR::addShutdownCall( SHUTDOWN_CALL_FNPTR_T funcPtr, void *objAddr )
     m_shutdownCallList.push_back( std::pair< SHUTDOWN_CALL_FNPTR_T, void* >( funcPtr, objAddr ) );
 }
 
+HNSCGIStreamEvent::HNSCGIStreamEvent( std::string data )
+{
+    m_data = data;
+}
+
+HNSCGIStreamEvent::~HNSCGIStreamEvent()
+{
+
+}
+
+const std::string&
+HNSCGIStreamEvent::getData()
+{
+    return m_data;
+}
+
 // Helper class for running HNSCGISink  
 // proxy loop as an independent thread
 class HNSCGIRunner : public Poco::Runnable
@@ -865,10 +989,18 @@ class HNSCGIRunner : public Poco::Runnable
 
 HNSCGISink::HNSCGISink()
 {
+    m_reactor = NULL;
+    m_epollFD = -1;
+    m_acceptFD = -1;
+    m_proxyQFD = -1;
+    m_streamQFD = -1;
+    m_keepaliveFD = -1;
+    m_shutdownFD = -1;
     m_parentRequestQueue = NULL;
     m_instanceName = "default";
     m_runMonitor = false;
     m_thelp = NULL;
+    m_lastStreamWrite = 0;
 }
 
 HNSCGISink::~HNSCGISink()
@@ -888,6 +1020,12 @@ HNSCGISink::getProxyResponseQueue()
     return &m_proxyResponseQueue;
 }
 
+HNSigSyncQueue* 
+HNSCGISink::getStreamEventQueue()
+{
+    return &m_streamEventQueue;
+}
+
 void 
 HNSCGISink::debugPrint()
 {
@@ -903,6 +1041,9 @@ HNSCGISink::start( std::string instance )
 
     m_instanceName = instance;
 
+    // Signals the loop to exit
+    m_shutdownFD = eventfd( 0, EFD_NONBLOCK );
+
     // Allocate the thread helper
     m_thelp = new HNSCGIRunner( this );
     if( !m_thelp )
@@ -917,6 +1058,41 @@ HNSCGISink::start( std::string instance )
     ( (HNSCGIRunner*) m_thelp )->startThread();
 }
 
+void
+HNSCGISink::startOnReactor( std::string instance, HNEventReactor *reactor )
+{
+    std::cout << "HNSCGISink::startOnReactor()" << std::endl;
+
+    m_instanceName = instance;
+    m_reactor = reactor;
+
+    // Streams are kept alive from a timer instead of the loop timeout
+    m_keepaliveFD = HNEventReactor::createTimer();
+    m_reactor->addFD( m_keepaliveFD, this );
+
+    initEventSources();
+}
+
+HNSS_RESULT_T
+HNSCGISink::initEventSources()
+{
+    // Open Unix named socket for requests
+    openSCGISocket();
+
+    // Initialize the proxyResponseQueue
+    // and add it to the epoll loop
+    m_proxyResponseQueue.init();
+    m_proxyQFD = m_proxyResponseQueue.getEventFD();
+    addSocketToEPoll( m_proxyQFD );
+
+    // Events to fan out to streaming responses
+    m_streamEventQueue.init();
+    m_streamQFD = m_streamEventQueue.getEventFD();
+    addSocketToEPoll( m_streamQFD );
+
+    return HNSS_RESULT_SUCCESS;
+}
+
 void 
 HNSCGISink::runSCGILoop()
 {
@@ -933,27 +1109,19 @@ HNSCGISink::runSCGILoop()
     // Buffer where events are returned 
     m_events = (struct epoll_event *) calloc( MAXEVENTS, sizeof m_event );
 
-    // Open Unix named socket for requests
-    openSCGISocket();
+    initEventSources();
 
-    // Initialize the proxyResponseQueue
-    // and add it to the epoll loop
-    m_proxyResponseQueue.init();
-    int proxyQFD = m_proxyResponseQueue.getEventFD();
-    addSocketToEPoll( proxyQFD );
+    addSocketToEPoll( m_shutdownFD );
 
     // The listen loop 
     while( m_runMonitor == true )
     {
         int n;
         int i;
-        struct tm newtime;
-        time_t ltime;
-
-        // Check for events
-        n = epoll_wait( m_epollFD, m_events, MAXEVENTS, 2000 );
 
-        std::cout << "HNSCGISink::monitor wakeup" << std::endl;
+        // Check for events, only waking on our own
+        // for a stream keepalive.
+        n = epoll_wait( m_epollFD, m_events, MAXEVENTS, getKeepaliveWaitMS() );
 
         // EPoll error
         if( n < 0 )
@@ -966,6 +1134,9 @@ HNSCGISink::runSCGILoop()
             //log.error( "ERROR: Failure report by epoll event loop: %s", strerror( errno ) );
             return;
         }
+
+        // Keep idle streams from being timed out by the front end server
+        checkStreamKeepalive();
  
         // If it was a timeout then continue to next loop
         // skip socket related checks.
@@ -974,64 +1145,150 @@ HNSCGISink::runSCGILoop()
 
         // Socket event
         for( i = 0; i < n; i++ )
-	    {
-            if( m_acceptFD == m_events[i].data.fd )
-	        {
-                // New client connections
-	            if( (m_events[i].events & EPOLLERR) || (m_events[i].events & EPOLLHUP) || (!(m_events[i].events & EPOLLIN)) )
-	            {
-                    /* An error has occured on this fd, or the socket is not ready for reading (why were we notified then?) */
-                    syslog( LOG_ERR, "accept socket closed - restarting\n" );
-                    close (m_events[i].data.fd);
-	                continue;
-	            }
-
-                processNewClientConnections();
+        {
+            // Shutdown, m_runMonitor ends the loop
+            if( m_events[i].data.fd == m_shutdownFD )
                 continue;
-            }
-            else if( proxyQFD == m_events[i].data.fd )
+
+            handleEvent( m_events[i].data.fd, m_events[i].events );
+        }
+    }
+
+    std::cout << "HNSCGISink::monitor exit" << std::endl;
+}
+
+void
+HNSCGISink::handleReactorEvent( int fd, uint32_t events )
+{
+    if( fd == m_keepaliveFD )
+    {
+        HNEventReactor::clearTimer( m_keepaliveFD );
+        checkStreamKeepalive();
+    }
+    else
+        handleEvent( fd, events );
+
+    // Only tick while there are streams to keep alive
+    int waitMS = getKeepaliveWaitMS();
+
+    if( waitMS < 0 )
+        HNEventReactor::disarmTimer( m_keepaliveFD );
+    else
+        HNEventReactor::armTimer( m_keepaliveFD, waitMS );
+}
+
+// Milliseconds until idle streams need a keepalive,
+// -1 if there are no streams.
+int
+HNSCGISink::getKeepaliveWaitMS()
+{
+    if( m_streamSet.empty() == true )
+        return -1;
+
+    time_t remaining = HNSCGI_STREAM_KEEPALIVE_SECS - (time(NULL) - m_lastStreamWrite);
+    if( remaining < 0 )
+        remaining = 0;
+
+    return remaining * 1000;
+}
+
+void
+HNSCGISink::checkStreamKeepalive()
+{
+    if( (m_streamSet.empty() == false) && ((time(NULL) - m_lastStreamWrite) >= HNSCGI_STREAM_KEEPALIVE_SECS) )
+        writeToStreams( ": keepalive\n\n" );
+}
+
+void
+HNSCGISink::handleEvent( int fd, uint32_t events )
+{
+    if( m_acceptFD == fd )
+    {
+        // New client connections
+        if( (events & EPOLLERR) || (events & EPOLLHUP) || (!(events & EPOLLIN)) )
+        {
+            /* An error has occured on this fd, or the socket is not ready for reading (why were we notified then?) */
+            syslog( LOG_ERR, "accept socket closed - restarting\n" );
+            close( fd );
+            return;
+        }
+
+        processNewClientConnections();
+    }
+    else if( m_proxyQFD == fd )
+    {
+        while( m_proxyResponseQueue.getPostedCnt() )
+        {
+            HNSCGIRR *response = (HNSCGIRR *) m_proxyResponseQueue.aquireRecord();
+
+            response->setPending( false );
+
+            // The client left while the request was out, finish
+            // the close that was held for it.
+            if( response->isClosed() == true )
             {
-                while( m_proxyResponseQueue.getPostedCnt() )
-                {
-                    HNSCGIRR *response = (HNSCGIRR *) m_proxyResponseQueue.aquireRecord();
-
-                    std::map< int, HNSCGIRR* >::iterator it = m_rrMap.find( response->getSCGIFD() );
-                    if( it == m_rrMap.end() )
-                    {
-                        syslog( LOG_ERR, "ERROR: Could not find client record - sfd: %d", response->getSCGIFD() );
-                        //return HNSS_RESULT_FAILURE;
-                    }
-    
-                    std::cout << "HNSCGISink::Received proxy response" << std::endl;
+                close( response->getSCGIFD() );
 
-                    HNSS_RESULT_T status = response->getRspMsg().sendSCGIResponseHeaders();
+                std::cout << "Delete HNSCGIRR: " << response << std::endl;
+                delete response;
+                continue;
+            }
 
-                    while( status == HNSS_RESULT_MSG_CONTENT )
-                    {
-                        status = response->getRspMsg().xferContentChunk( 4096 );
-                    }
+            std::map< int, HNSCGIRR* >::iterator it = m_rrMap.find( response->getSCGIFD() );
+            if( it == m_rrMap.end() )
+            {
+                syslog( LOG_ERR, "ERROR: Could not find client record - sfd: %d", response->getSCGIFD() );
+                //return HNSS_RESULT_FAILURE;
+            }
 
-                    closeClientConnection( response->getSCGIFD() );
-                }
-            }           
-            else
+            std::cout << "HNSCGISink::Received proxy response" << std::endl;
+
+            if( response->isStreaming() == true )
             {
-                // Client request
-	            if( (m_events[i].events & EPOLLERR) || (m_events[i].events & EPOLLHUP) || (!(m_events[i].events & EPOLLIN)) )
-	            {
-                    // An error has occured on this fd, or the socket is not ready for reading (why were we notified then?)
-                    closeClientConnection( m_events[i].data.fd );
+                startStreamingResponse( response );
+                continue;
+            }
 
-	                continue;
-	            }
+            HNSS_RESULT_T status = response->getRspMsg().sendSCGIResponseHeaders();
 
-                // Handle a request from a client.
-                processClientRequest( m_events[i].data.fd );
+            while( status == HNSS_RESULT_MSG_CONTENT )
+            {
+                status = response->getRspMsg().xferContentChunk( 4096 );
             }
+
+            closeClientConnection( response->getSCGIFD() );
         }
     }
+    else if( m_streamQFD == fd )
+    {
+        while( m_streamEventQueue.getPostedCnt() )
+        {
+            HNSCGIStreamEvent *event = (HNSCGIStreamEvent *) m_streamEventQueue.aquireRecord();
 
-    std::cout << "HNSCGISink::monitor exit" << std::endl;
+            writeToStreams( event->getData() );
+
+            delete event;
+        }
+    }
+    else if( m_streamSet.find( fd ) != m_streamSet.end() )
+    {
+        // Streaming clients don't send anything after the
+        // request, so any activity means the client went away.
+        closeClientConnection( fd );
+    }
+    else
+    {
+        // Client request
+        if( (events & EPOLLERR) || (events & EPOLLHUP) || (!(events & EPOLLIN)) )
+        {
+            // An error has occured on this fd, or the socket is not ready for reading (why were we notified then?)
+            closeClientConnection( fd );
+            return;
+        }
+
+        // Handle a request from a client.
+        processClientRequest( fd );
+    }
 }
 
 void
@@ -1048,12 +1305,21 @@ HNSCGISink::shutdown()
 
     delete ( (HNSCGIRunner*) m_thelp );
     m_thelp = NULL;
+
+    close( m_shutdownFD );
+    m_shutdownFD = -1;
 }
 
 void 
 HNSCGISink::killSCGILoop()
 {
+    uint64_t value = 1;
+
     m_runMonitor = false;    
+
+    // Wake the loop so it sees the flag
+    if( write( m_shutdownFD, &value, sizeof(value) ) != sizeof(value) )
+        syslog( LOG_ERR, "HNSCGISink - Failed to signal shutdown: %s", strerror(errno) );
 }
 
 HNSS_RESULT_T
@@ -1061,6 +1327,10 @@ HNSCGISink::addSocketToEPoll( int sfd )
 {
     int flags, s;
 
+    // Hosted on a shared reactor
+    if( m_reactor != NULL )
+        return (m_reactor->addFD( sfd, this ) == HNER_RESULT_SUCCESS) ? HNSS_RESULT_SUCCESS : HNSS_RESULT_FAILURE;
+
     flags = fcntl( sfd, F_GETFL, 0 );
     if( flags == -1 )
     {
@@ -1092,6 +1362,9 @@ HNSCGISink::removeSocketFromEPoll( int sfd )
 {
     int s;
 
+    if( m_reactor != NULL )
+        return (m_reactor->removeFD( sfd ) == HNER_RESULT_SUCCESS) ? HNSS_RESULT_SUCCESS : HNSS_RESULT_FAILURE;
+
     s = epoll_ctl( m_epollFD, EPOLL_CTL_DEL, sfd, NULL );
     if( s == -1 )
     {
@@ -1219,19 +1492,72 @@ HNSCGISink::closeClientConnection( int clientFD )
 
     removeSocketFromEPoll( clientFD );
 
-    close( clientFD );
-
-    printf( "Closed client - sfd: %d\n", clientFD );
+    m_streamSet.erase( clientFD );
 
     HNSCGIRR *client = cit->second;
     m_rrMap.erase( cit );
 
+    // A request still out with the parent is deleted when it
+    // comes back, unless the parent lets go of it now.  The
+    // descriptor stays open until then, so it can't be reused.
+    if( (client->isPending() == true) && (client->notifyClose() == false) )
+    {
+        client->setClosed( true );
+        printf( "Closed client, request outstanding - sfd: %d\n", clientFD );
+        return HNSS_RESULT_SUCCESS;
+    }
+
+    close( clientFD );
+
+    printf( "Closed client - sfd: %d\n", clientFD );
+
     std::cout << "Delete HNSCGIRR: " << client << std::endl;
     delete client;
     
     return HNSS_RESULT_SUCCESS;
 }
 
+void
+HNSCGISink::startStreamingResponse( HNSCGIRR *response )
+{
+    // Only the headers go out now, the connection
+    // then stays open to receive events.
+    if( response->getRspMsg().sendSCGIResponseHeaders() != HNSS_RESULT_MSG_CONTENT )
+    {
+        closeClientConnection( response->getSCGIFD() );
+        return;
+    }
+
+    m_streamSet.insert( response->getSCGIFD() );
+
+    std::cout << "HNSCGISink::Started stream - sfd: " << response->getSCGIFD() << "  streams: " << m_streamSet.size() << std::endl;
+}
+
+void
+HNSCGISink::writeToStreams( const std::string &data )
+{
+    std::vector< int > dropList;
+
+    m_lastStreamWrite = time(NULL);
+
+    for( std::set< int >::iterator it = m_streamSet.begin(); it != m_streamSet.end(); it++ )
+    {
+        // The sockets are non-blocking, a subscriber that can't take the
+        // whole event is too far behind to keep, so drop it rather than
+        // buffer on its behalf.
+        ssize_t bytesSent = send( *it, data.data(), data.size(), MSG_NOSIGNAL );
+
+        if( (bytesSent < 0) || ((size_t) bytesSent != data.size()) )
+            dropList.push_back( *it );
+    }
+
+    for( std::vector< int >::iterator dit = dropList.begin(); dit != dropList.end(); dit++ )
+    {
+        syslog( LOG_ERR, "Dropping stream client - sfd: %d", *dit );
+        closeClientConnection( *dit );
+    }
+}
+
 HNSS_RESULT_T
 HNSCGISink::processClientRequest( int cfd )
 {
@@ -1276,5 +1602,7 @@ HNSCGISink::queueProxyRequest( HNSCGIRR *reqPtr )
     if( m_parentRequestQueue == NULL )
         return;
 
+    reqPtr->setPending( true );
+
     m_parentRequestQueue->postRecord( reqPtr );
 }
@@ -7,6 +7,7 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <list>
 #include <fstream>
 #include <sstream>
@@ -14,11 +15,17 @@
 #include <hnode2/HNSigSyncQueue.h>
 #include <hnode2/HNodeID.h>
 
+#include "HNEventReactor.h"
+
 //#include "HNProxyReqRsp.h"
 
+// Seconds of quiet on a streaming response before a keepalive comment is sent
+#define HNSCGI_STREAM_KEEPALIVE_SECS  15
+
 // Forward declaration
 class HNSCGIRunner;
 class HNSCGISink;
+class HNSCGIRR;
 
 typedef enum HNSCGISinkResultEnum
 {
@@ -67,6 +74,11 @@ class HNPRRContentSink
 // after completion of the request-response operations.
 typedef void (*SHUTDOWN_CALL_FNPTR_T)( void *objAddr );
 
+// Signature for the function told when the client goes away while
+// the parent still has the request.  Returns true if the parent has
+// let go of the request, so it can be deleted right away.
+typedef bool (*CLOSE_CALL_FNPTR_T)( HNSCGIRR *reqRR, void *objAddr );
+
 class HNSCGIMsg : public HNPRRContentSource, public HNPRRContentSink
 {
     private:
@@ -110,9 +122,12 @@ class HNSCGIMsg : public HNPRRContentSource, public HNPRRContentSink
 
         void setContentType( std::string typeStr );
 
+        void configAsBadRequest();
         void configAsNotImplemented();
         void configAsNotFound();
         void configAsInternalServerError();
+        void configAsBadGateway();
+        void configAsNotModified();
 
         uint getStatusCode();
         std::string getReason();
@@ -126,6 +141,7 @@ class HNSCGIMsg : public HNPRRContentSource, public HNPRRContentSink
         HNSS_RESULT_T sendSCGIResponseHeaders();
 
         bool hasHeader( std::string name );
+        bool getHeader( std::string name, std::string &value );
 
         const std::string& getURI() const;
         const std::string& getMethod() const;
@@ -172,6 +188,16 @@ class HNSCGIRR : public HNPRRContentSource, public HNPRRContentSink
 
         std::vector< std::pair< SHUTDOWN_CALL_FNPTR_T, void* > > m_shutdownCallList;
 
+        bool m_streaming;
+
+        // Set while the request is out with the parent, and when the
+        // client went away in the meantime.  Sink thread only.
+        bool m_pending;
+        bool m_closed;
+
+        CLOSE_CALL_FNPTR_T m_closeFunc;
+        void              *m_closeObj;
+
         void setRxParseState( HNSC_SS_T newState );
         HNSS_RESULT_T readRequestHeaders();
         
@@ -197,11 +223,41 @@ class HNSCGIRR : public HNPRRContentSource, public HNPRRContentSink
         HNSCGIMsg& getReqMsg();
         HNSCGIMsg& getRspMsg();
 
+        // A streaming response keeps the connection open after
+        // the headers are sent, for Server-Sent Events.
+        void setStreaming( bool value );
+        bool isStreaming();
+
+        void setPending( bool value );
+        bool isPending();
+
+        void setClosed( bool value );
+        bool isClosed();
+
+        // Set by a parent that holds on to requests, called from the
+        // sink thread if the client closes the connection first.
+        void setCloseCall( CLOSE_CALL_FNPTR_T funcPtr, void *objAddr );
+        bool notifyClose();
+
         virtual std::istream* getSourceStreamRef();
         virtual std::ostream* getSinkStreamRef();
 };
 
-class HNSCGISink
+// A pre-formatted chunk of data to be written
+// to every open streaming response.
+class HNSCGIStreamEvent
+{
+    public:
+        HNSCGIStreamEvent( std::string data );
+       ~HNSCGIStreamEvent();
+
+        const std::string& getData();
+
+    private:
+        std::string m_data;
+};
+
+class HNSCGISink : public HNEventHandler
 {
 
     private:
@@ -212,6 +268,10 @@ class HNSCGISink
         
         // A map of client connections
         std::map< int, HNSCGIRR* > m_rrMap;
+
+        // Client connections holding open streaming responses
+        std::set< int > m_streamSet;
+        time_t          m_lastStreamWrite;
         
         // The thread helper
         void *m_thelp;
@@ -219,24 +279,45 @@ class HNSCGISink
         // Should the monitor still be running.
         bool m_runMonitor;
 
+        // Set when hosted on a shared reactor instead of our own thread
+        HNEventReactor *m_reactor;
+
         int m_epollFD;
         int m_acceptFD;
+        int m_proxyQFD;
+        int m_streamQFD;
+
+        // Reactor timer for stream keepalives
+        int m_keepaliveFD;
+
+        // Written to end our own loop, so it can wait without a timeout
+        int m_shutdownFD;
     
         struct epoll_event m_event;
         struct epoll_event *m_events;
 
         HNSigSyncQueue  m_proxyResponseQueue;
 
+        HNSigSyncQueue  m_streamEventQueue;
+
         HNSigSyncQueue  *m_parentRequestQueue;
 
         HNSS_RESULT_T openSCGISocket();
 
+        HNSS_RESULT_T initEventSources();
+        void handleEvent( int fd, uint32_t events );
+        void checkStreamKeepalive();
+        int getKeepaliveWaitMS();
+
         HNSS_RESULT_T addSocketToEPoll( int sfd );
         HNSS_RESULT_T removeSocketFromEPoll( int sfd );
         HNSS_RESULT_T processNewClientConnections();
         HNSS_RESULT_T closeClientConnection( int clientFD );
         HNSS_RESULT_T processClientRequest( int cfd );
 
+        void startStreamingResponse( HNSCGIRR *response );
+        void writeToStreams( const std::string &data );
+
     protected:
         void runSCGILoop();
         void killSCGILoop();
@@ -248,10 +329,14 @@ class HNSCGISink
         void setParentRequestQueue( HNSigSyncQueue *parentRequestQueue );
 
         HNSigSyncQueue* getProxyResponseQueue();
+        HNSigSyncQueue* getStreamEventQueue();
 
         void start( std::string instance );
+        void startOnReactor( std::string instance, HNEventReactor *reactor );
         void shutdown();
 
+        virtual void handleReactorEvent( int fd, uint32_t events );
+
         void debugPrint();
 
         void queueProxyRequest( HNSCGIRR *reqPtr );